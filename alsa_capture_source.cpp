@@ -0,0 +1,354 @@
+#include "alsa_capture_source.h"
+#include <iostream>
+#include <stdexcept>
+#include <algorithm>
+#include <cstring>
+#include <cerrno>
+#include <unistd.h>
+
+// How long a read waits for a period before giving up, so a wedged device
+// can't hold the capture thread forever
+static const int kPollTimeoutMs = 1000;
+
+// snd_pcm_resume() returns -EAGAIN until the device has woken up; retry for
+// up to a second before falling back to a prepare
+static const int kResumeAttempts = 10;
+static const useconds_t kResumeRetryUs = 100000;
+
+AlsaCaptureSource::AlsaCaptureSource(const std::string& device, int sample_rate, int channels,
+                                     int period_ms, int periods)
+    : device(device), capture_handle(nullptr), sample_rate(sample_rate), channels(channels),
+      period_ms(period_ms), periods(periods), period_frames(0), buffer_frames(0),
+      mmap_access(false), lost_frames(0), lost_after_read(0), xrun_count(0) {
+    if (period_ms <= 0 || periods < 2) {
+        throw std::invalid_argument("Invalid ALSA period configuration");
+    }
+    if (!initializeALSA()) {
+        closeALSA();
+        throw std::runtime_error("Failed to initialize ALSA audio capture");
+    }
+}
+
+AlsaCaptureSource::~AlsaCaptureSource() {
+    closeALSA();
+}
+
+bool AlsaCaptureSource::initializeALSA() {
+    int err;
+    
+    // Open PCM device for recording
+    if ((err = snd_pcm_open(&capture_handle, device.c_str(), SND_PCM_STREAM_CAPTURE, 0)) < 0) {
+        std::cerr << "Cannot open audio device: " << snd_strerror(err) << std::endl;
+        return false;
+    }
+    
+    // Allocate hardware parameters object
+    snd_pcm_hw_params_t *hw_params;
+    snd_pcm_hw_params_alloca(&hw_params);
+    
+    // Fill it with default values
+    if ((err = snd_pcm_hw_params_any(capture_handle, hw_params)) < 0) {
+        std::cerr << "Cannot configure this PCM device: " << snd_strerror(err) << std::endl;
+        return false;
+    }
+    
+    // Set the desired hardware parameters
+    
+    // Interleaved mode, read in place from the DMA buffer where the driver
+    // allows it
+    mmap_access = snd_pcm_hw_params_set_access(capture_handle, hw_params,
+                                               SND_PCM_ACCESS_MMAP_INTERLEAVED) >= 0;
+    if (!mmap_access) {
+        std::cerr << "Device has no mmap capture, falling back to read()" << std::endl;
+        if ((err = snd_pcm_hw_params_set_access(capture_handle, hw_params, SND_PCM_ACCESS_RW_INTERLEAVED)) < 0) {
+            std::cerr << "Cannot set access type: " << snd_strerror(err) << std::endl;
+            return false;
+        }
+    }
+    
+    // Signed 16-bit little-endian format
+    if ((err = snd_pcm_hw_params_set_format(capture_handle, hw_params, SND_PCM_FORMAT_S16_LE)) < 0) {
+        std::cerr << "Cannot set sample format: " << snd_strerror(err) << std::endl;
+        return false;
+    }
+    
+    // Set channels
+    if ((err = snd_pcm_hw_params_set_channels(capture_handle, hw_params, channels)) < 0) {
+        std::cerr << "Cannot set channel count: " << snd_strerror(err) << std::endl;
+        return false;
+    }
+    
+    // Take a rate the hardware runs at natively rather than one alsa-lib's
+    // plug layer would resample to; conversion is the pipeline's job, and it
+    // can change rate there without touching the device
+    if ((err = snd_pcm_hw_params_set_rate_resample(capture_handle, hw_params, 0)) < 0) {
+        std::cerr << "Cannot disable ALSA resampling: " << snd_strerror(err) << std::endl;
+    }
+    
+    // Set sample rate
+    unsigned int actual_rate = sample_rate;
+    if ((err = snd_pcm_hw_params_set_rate_near(capture_handle, hw_params, &actual_rate, 0)) < 0) {
+        std::cerr << "Cannot set sample rate: " << snd_strerror(err) << std::endl;
+        return false;
+    }
+    
+    if (actual_rate != (unsigned int)sample_rate) {
+        std::cout << "Capturing at the device's native rate of " << actual_rate
+                  << " Hz instead of " << sample_rate << " Hz" << std::endl;
+        sample_rate = actual_rate;
+    }
+    
+    // The period sets how often the capture thread wakes; the buffer how
+    // long it may be late before samples are lost
+    period_frames = static_cast<snd_pcm_uframes_t>(sample_rate) * period_ms / 1000;
+    if ((err = snd_pcm_hw_params_set_period_size_near(capture_handle, hw_params, &period_frames, 0)) < 0) {
+        std::cerr << "Cannot set period size: " << snd_strerror(err) << std::endl;
+        return false;
+    }
+    buffer_frames = period_frames * periods;
+    if ((err = snd_pcm_hw_params_set_buffer_size_near(capture_handle, hw_params, &buffer_frames)) < 0) {
+        std::cerr << "Cannot set buffer size: " << snd_strerror(err) << std::endl;
+        return false;
+    }
+    
+    // Apply the hardware configuration
+    if ((err = snd_pcm_hw_params(capture_handle, hw_params)) < 0) {
+        std::cerr << "Cannot set parameters: " << snd_strerror(err) << std::endl;
+        return false;
+    }
+    snd_pcm_hw_params_get_period_size(hw_params, &period_frames, 0);
+    snd_pcm_hw_params_get_buffer_size(hw_params, &buffer_frames);
+    
+    // Wake from poll() only once a whole period is ready, and stop the
+    // stream as soon as the buffer overflows so the loss can be measured
+    snd_pcm_sw_params_t *sw_params;
+    snd_pcm_sw_params_alloca(&sw_params);
+    if ((err = snd_pcm_sw_params_current(capture_handle, sw_params)) < 0 ||
+        (err = snd_pcm_sw_params_set_avail_min(capture_handle, sw_params, period_frames)) < 0 ||
+        (err = snd_pcm_sw_params_set_stop_threshold(capture_handle, sw_params, buffer_frames)) < 0) {
+        std::cerr << "Cannot set software parameters: " << snd_strerror(err) << std::endl;
+        return false;
+    }
+    // Monotonic status timestamps, to time how long an overrun lasted. Not
+    // every driver offers them; trigger timestamps are still recorded.
+    snd_pcm_sw_params_set_tstamp_mode(capture_handle, sw_params, SND_PCM_TSTAMP_ENABLE);
+    snd_pcm_sw_params_set_tstamp_type(capture_handle, sw_params, SND_PCM_TSTAMP_TYPE_MONOTONIC);
+    if ((err = snd_pcm_sw_params(capture_handle, sw_params)) < 0) {
+        std::cerr << "Cannot set software parameters: " << snd_strerror(err) << std::endl;
+        return false;
+    }
+    
+    int fd_count = snd_pcm_poll_descriptors_count(capture_handle);
+    if (fd_count <= 0) {
+        std::cerr << "Cannot get poll descriptors for the audio device" << std::endl;
+        return false;
+    }
+    poll_fds.resize(fd_count);
+    if ((err = snd_pcm_poll_descriptors(capture_handle, poll_fds.data(), fd_count)) < 0) {
+        std::cerr << "Cannot get poll descriptors: " << snd_strerror(err) << std::endl;
+        return false;
+    }
+    
+    // Prepare the PCM device for use
+    if ((err = snd_pcm_prepare(capture_handle)) < 0) {
+        std::cerr << "Cannot prepare audio interface: " << snd_strerror(err) << std::endl;
+        return false;
+    }
+    
+    std::cout << "Audio capture: " << period_frames << " frame periods, "
+              << buffer_frames << " frame buffer" << (mmap_access ? ", mmap" : "") << std::endl;
+    return true;
+}
+
+void AlsaCaptureSource::closeALSA() {
+    if (capture_handle) {
+        snd_pcm_close(capture_handle);
+        capture_handle = nullptr;
+    }
+    poll_fds.clear();
+}
+
+static int64_t nanosBetween(const snd_htimestamp_t& from, const snd_htimestamp_t& to) {
+    return (static_cast<int64_t>(to.tv_sec) - from.tv_sec) * 1000000000LL +
+           (static_cast<int64_t>(to.tv_nsec) - from.tv_nsec);
+}
+
+void AlsaCaptureSource::recover(int err) {
+    if ((err == -EPIPE || err == -ESTRPIPE) && restartAfterXrun()) {
+        return;
+    }
+    std::cerr << "Error reading from PCM device: " << snd_strerror(err) << std::endl;
+    snd_pcm_recover(capture_handle, err, 0);
+}
+
+void AlsaCaptureSource::recoverMidRead(int err, size_t returned, uint64_t dropped) {
+    uint64_t reported = lost_frames;
+    uint64_t restarts = xrun_count;
+    recover(err);
+    // A restart from an overrun counts every unread frame; any other
+    // recovery would lose `dropped` without a trace
+    if (xrun_count == restarts) {
+        lost_frames += dropped;
+    }
+    // takeLostFrames() puts a gap before the frames read() returned, but
+    // this one follows them
+    if (returned > 0) {
+        lost_after_read += lost_frames - reported;
+        lost_frames = reported;
+    }
+}
+
+bool AlsaCaptureSource::restartAfterXrun() {
+    snd_pcm_status_t *status;
+    snd_pcm_status_alloca(&status);
+    if (snd_pcm_status(capture_handle, status) < 0) {
+        return false;
+    }
+    snd_pcm_state_t state = snd_pcm_status_get_state(status);
+    if (state != SND_PCM_STATE_XRUN && state != SND_PCM_STATE_SUSPENDED) {
+        return false;
+    }
+
+    // Everything captured past the last frame we read is gone: the driver
+    // counts it in avail, and the trigger timestamp is when it stopped
+    snd_pcm_uframes_t unread = snd_pcm_status_get_avail(status);
+    snd_htimestamp_t stopped;
+    snd_pcm_status_get_trigger_htstamp(status, &stopped);
+
+    // A resumed stream carries on from where it was suspended, keeping the
+    // frames still in the buffer; drivers that can't resume are prepared
+    // and restarted like after an overrun, which drops them
+    int err = -ENOSYS;
+    if (state == SND_PCM_STATE_SUSPENDED) {
+        for (int i = 0; i < kResumeAttempts && (err = snd_pcm_resume(capture_handle)) == -EAGAIN; i++) {
+            usleep(kResumeRetryUs);
+        }
+    }
+    bool resumed = err == 0;
+    if (!resumed && ((err = snd_pcm_prepare(capture_handle)) < 0 ||
+                     (err = snd_pcm_start(capture_handle)) < 0)) {
+        std::cerr << "Cannot restart audio capture after overrun: " << snd_strerror(err) << std::endl;
+        return false;
+    }
+    if ((err = snd_pcm_status(capture_handle, status)) < 0) {
+        std::cerr << "Cannot read audio capture status: " << snd_strerror(err) << std::endl;
+        return false;
+    }
+    snd_htimestamp_t started;
+    snd_pcm_status_get_trigger_htstamp(status, &started);
+
+    int64_t stopped_ns = std::max<int64_t>(0, nanosBetween(stopped, started));
+    uint64_t lost = (resumed ? 0 : unread) +
+                    static_cast<uint64_t>((stopped_ns * sample_rate + 500000000LL) / 1000000000LL);
+    lost_frames += lost;
+    xrun_count++;
+    std::cerr << "Audio capture " << (state == SND_PCM_STATE_XRUN ? "overrun" : "suspend")
+              << ": " << lost << " frames lost" << std::endl;
+    return true;
+}
+
+uint64_t AlsaCaptureSource::takeLostFrames() {
+    uint64_t lost = lost_frames;
+    lost_frames = 0;
+    return lost;
+}
+
+bool AlsaCaptureSource::waitForPeriod() {
+    while (true) {
+        int ready = poll(poll_fds.data(), poll_fds.size(), kPollTimeoutMs);
+        if (ready < 0 && errno == EINTR) {
+            continue;
+        }
+        if (ready <= 0) {
+            std::cerr << "Audio device " << (ready == 0 ? "stalled" : "poll failed") << std::endl;
+            return false;
+        }
+        unsigned short revents = 0;
+        snd_pcm_poll_descriptors_revents(capture_handle, poll_fds.data(), poll_fds.size(), &revents);
+        // On POLLERR the stream has stopped; avail_update() reports why
+        if (revents & (POLLIN | POLLERR)) {
+            return true;
+        }
+    }
+}
+
+size_t AlsaCaptureSource::read(int16_t* dest, size_t frames) {
+    if (!mmap_access) {
+        snd_pcm_sframes_t got = snd_pcm_readi(capture_handle, dest, frames);
+        if (got < 0) {
+            recover(got);
+            return 0;
+        }
+        return static_cast<size_t>(got);
+    }
+
+    // A gap found after the frames the last read returned comes before these
+    lost_frames += lost_after_read;
+    lost_after_read = 0;
+
+    // Capture doesn't start on its own without a read() call
+    if (snd_pcm_state(capture_handle) == SND_PCM_STATE_PREPARED) {
+        int err = snd_pcm_start(capture_handle);
+        if (err < 0) {
+            recover(err);
+            return 0;
+        }
+    }
+
+    snd_pcm_uframes_t wanted = std::min<snd_pcm_uframes_t>(frames, period_frames);
+    snd_pcm_sframes_t avail;
+    while ((avail = snd_pcm_avail_update(capture_handle)) >= 0 &&
+           static_cast<snd_pcm_uframes_t>(avail) < wanted) {
+        if (!waitForPeriod()) {
+            return 0;
+        }
+    }
+    if (avail < 0) {
+        recover(avail);
+        return 0;
+    }
+
+    // Copy out of the DMA area in at most two pieces around its wrap point
+    size_t copied = 0;
+    while (copied < frames && avail > 0) {
+        const snd_pcm_channel_area_t* areas;
+        snd_pcm_uframes_t offset;
+        snd_pcm_uframes_t count = frames - copied;
+        int err = snd_pcm_mmap_begin(capture_handle, &areas, &offset, &count);
+        if (err < 0) {
+            recoverMidRead(err, copied, 0);
+            return copied;
+        }
+        if (count == 0) {
+            break;
+        }
+
+        // Interleaved, so channel 0's area covers every channel
+        const char* base = static_cast<const char*>(areas[0].addr);
+        const int16_t* src = reinterpret_cast<const int16_t*>(
+            base + (areas[0].first + offset * areas[0].step) / 8);
+        std::memcpy(dest + copied * channels, src, count * channels * sizeof(int16_t));
+
+        snd_pcm_sframes_t committed = snd_pcm_mmap_commit(capture_handle, offset, count);
+        if (committed < 0 || static_cast<snd_pcm_uframes_t>(committed) != count) {
+            // The driver overran the area while we copied it; keep what it
+            // let us commit
+            snd_pcm_uframes_t kept = committed > 0 ? static_cast<snd_pcm_uframes_t>(committed) : 0;
+            copied += kept;
+            recoverMidRead(committed < 0 ? static_cast<int>(committed) : -EPIPE, copied,
+                           count - kept);
+            return copied;
+        }
+        copied += count;
+        avail -= count;
+    }
+    return copied;
+}
+
+void AlsaCaptureSource::discard() {
+    if (capture_handle) {
+        snd_pcm_drop(capture_handle);
+        snd_pcm_prepare(capture_handle);
+    }
+}
+
@@ -0,0 +1,70 @@
+#ifndef ALSA_CAPTURE_SOURCE_H
+#define ALSA_CAPTURE_SOURCE_H
+
+#include <string>
+#include <vector>
+#include <poll.h>
+#include <alsa/asoundlib.h>
+#include "capture_source.h"
+
+// Interleaved S16 capture from an ALSA PCM device. Frames are copied
+// straight out of the driver's mmap'ed DMA buffer into the caller's memory
+// (AudioCapture's ring), and reads sleep in poll() until a whole period is
+// ready, so the thread wakes once per period. Devices without mmap support
+// fall back to snd_pcm_readi().
+//
+// The device is opened once, at the hardware rate nearest the one asked for
+// with alsa-lib's resampling turned off; rate changes after that are made in
+// software by AudioCapture.
+//
+// An overrun is recovered in place (prepare and restart, never a reopen) and
+// the frames it cost are worked out from the driver's status: the frames
+// captured but never read, plus the time the stream stood still at the
+// sample rate. A suspended device is resumed where the driver allows it,
+// which keeps the frames still buffered. takeLostFrames() reports the
+// losses, each before the frames that follow it.
+class AlsaCaptureSource : public CaptureSource {
+public:
+    // The device may settle on a rate, period and buffer near the requested
+    // ones; the getters report what it chose
+    AlsaCaptureSource(const std::string& device = "hw:1,0", int sample_rate = 44100,
+                      int channels = 1, int period_ms = 20, int periods = 4);
+    ~AlsaCaptureSource();
+
+    int getSampleRate() const { return sample_rate; }
+    int getChannels() const { return channels; }
+    size_t getPeriodFrames() const { return period_frames; }
+    size_t getBufferFrames() const { return buffer_frames; }
+    bool isMmap() const { return mmap_access; }
+
+    size_t read(int16_t* dest, size_t frames);
+    uint64_t takeLostFrames();
+    void discard();
+
+    // Overruns recovered so far
+    uint64_t getXrunCount() const { return xrun_count; }
+
+private:
+    std::string device;
+    snd_pcm_t* capture_handle;
+    int sample_rate;
+    int channels;
+    int period_ms;
+    int periods;
+    snd_pcm_uframes_t period_frames;
+    snd_pcm_uframes_t buffer_frames;
+    bool mmap_access;
+    std::vector<struct pollfd> poll_fds;
+    uint64_t lost_frames;         // Not yet taken by takeLostFrames()
+    uint64_t lost_after_read;     // Lost after the frames the last read() returned
+    uint64_t xrun_count;
+
+    bool initializeALSA();
+    void closeALSA();
+    bool waitForPeriod();
+    void recover(int err);
+    void recoverMidRead(int err, size_t returned, uint64_t dropped);
+    bool restartAfterXrun();
+};
+
+#endif // ALSA_CAPTURE_SOURCE_H
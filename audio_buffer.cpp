@@ -0,0 +1,200 @@
+#include "audio_buffer.h"
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+AudioBuffer::AudioBuffer(AudioBuffer&& other) noexcept
+    : sampleRate(other.sampleRate), channels(other.channels),
+      startFrame(other.startFrame), timestampUs(other.timestampUs),
+      discontinuity(other.discontinuity), block(other.block), offset(other.offset), length(other.length) {
+    other.block = nullptr;
+    other.offset = 0;
+    other.length = 0;
+}
+
+AudioBuffer& AudioBuffer::operator=(AudioBuffer&& other) noexcept {
+    if (this != &other) {
+        reset();
+        copyFormatFrom(other);
+        block = other.block;
+        offset = other.offset;
+        length = other.length;
+        other.block = nullptr;
+        other.offset = 0;
+        other.length = 0;
+    }
+    return *this;
+}
+
+void AudioBuffer::resize(size_t samples) {
+    length = std::min(samples, capacity());
+}
+
+size_t AudioBuffer::append(const int16_t* src, size_t samples) {
+    size_t count = std::min(samples, capacity() - length);
+    if (count > 0) {
+        std::memcpy(data() + length, src, count * sizeof(int16_t));
+        length += count;
+    }
+    return count;
+}
+
+AudioBuffer AudioBuffer::share() const {
+    return slice(0, length);
+}
+
+AudioBuffer AudioBuffer::slice(size_t sample_offset, size_t sample_count) const {
+    AudioBuffer view;
+    view.copyFormatFrom(*this);
+    if (block == nullptr) {
+        return view;
+    }
+
+    sample_offset = std::min(sample_offset, length);
+    block->refs.fetch_add(1, std::memory_order_relaxed);
+    view.block = block;
+    view.offset = offset + sample_offset;
+    view.length = std::min(sample_count, length - sample_offset);
+    if (sample_offset > 0) {
+        view.discontinuity = false;  // Only the start of the original follows a gap
+    }
+    if (channels > 0) {
+        view.startFrame += sample_offset / channels;
+        view.timestampUs += sampleRate > 0
+            ? static_cast<int64_t>((sample_offset / channels) * 1000000ULL / sampleRate)
+            : 0;
+    }
+    return view;
+}
+
+void AudioBuffer::copyFormatFrom(const AudioBuffer& other) {
+    sampleRate = other.sampleRate;
+    channels = other.channels;
+    startFrame = other.startFrame;
+    timestampUs = other.timestampUs;
+    discontinuity = other.discontinuity;
+}
+
+void AudioBuffer::reset() {
+    if (block != nullptr) {
+        if (block->refs.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            block->pool->release(block);
+        }
+        block = nullptr;
+    }
+    offset = 0;
+    length = 0;
+}
+
+AudioBlockPool::AudioBlockPool(std::initializer_list<SizeClass> classes) : exhausted(0) {
+    std::vector<SizeClass> sorted(classes);
+    std::sort(sorted.begin(), sorted.end(), [](const SizeClass& a, const SizeClass& b) {
+        return a.block_samples < b.block_samples;
+    });
+
+    for (const SizeClass& size_class : sorted) {
+        if (size_class.block_count == 0 || size_class.block_samples == 0) {
+            continue;
+        }
+
+        std::unique_ptr<Slab> slab(new Slab());
+        slab->block_samples = size_class.block_samples;
+        slab->block_count = size_class.block_count;
+        // Value-initialise so every page is faulted in now rather than on the
+        // capture path
+        slab->storage.reset(new int16_t[size_class.block_count * size_class.block_samples]());
+        slab->blocks.reset(new AudioBlock[size_class.block_count]);
+        slab->free_head = 0;
+        slab->free_count = 0;
+
+        for (size_t i = 0; i < size_class.block_count; i++) {
+            AudioBlock& block = slab->blocks[i];
+            block.data = slab->storage.get() + i * size_class.block_samples;
+            block.capacity = size_class.block_samples;
+            block.refs = 0;
+            block.next_free = 0;
+            block.index = static_cast<uint32_t>(i);
+            block.slab = static_cast<uint32_t>(slabs.size());
+            block.pool = this;
+        }
+        for (size_t i = size_class.block_count; i > 0; i--) {
+            push(*slab, &slab->blocks[i - 1]);
+        }
+
+        slabs.push_back(std::move(slab));
+    }
+
+    if (slabs.empty()) {
+        throw std::invalid_argument("AudioBlockPool needs at least one non-empty size class");
+    }
+}
+
+AudioBlockPool::~AudioBlockPool() {
+}
+
+AudioBuffer AudioBlockPool::acquire(size_t samples) {
+    AudioBuffer buffer;
+    for (auto& slab : slabs) {
+        if (slab->block_samples < samples) {
+            continue;
+        }
+        AudioBlock* block = pop(*slab);
+        if (block != nullptr) {
+            block->refs.store(1, std::memory_order_relaxed);
+            buffer.block = block;
+            buffer.length = samples;
+            return buffer;
+        }
+    }
+    exhausted.fetch_add(1, std::memory_order_relaxed);
+    return buffer;
+}
+
+size_t AudioBlockPool::freeBlocks() const {
+    size_t total = 0;
+    for (const auto& slab : slabs) {
+        total += slab->free_count.load(std::memory_order_relaxed);
+    }
+    return total;
+}
+
+size_t AudioBlockPool::maxBlockSamples() const {
+    return slabs.back()->block_samples;
+}
+
+AudioBlock* AudioBlockPool::pop(Slab& slab) {
+    uint64_t head = slab.free_head.load(std::memory_order_acquire);
+    while (true) {
+        uint32_t link = static_cast<uint32_t>(head);
+        if (link == 0) {
+            return nullptr;
+        }
+        AudioBlock* block = &slab.blocks[link - 1];
+        uint32_t next = block->next_free.load(std::memory_order_relaxed);
+        uint64_t new_head = ((head >> 32) + 1) << 32 | next;
+        if (slab.free_head.compare_exchange_weak(head, new_head,
+                                                 std::memory_order_acq_rel,
+                                                 std::memory_order_acquire)) {
+            slab.free_count.fetch_sub(1, std::memory_order_relaxed);
+            return block;
+        }
+    }
+}
+
+void AudioBlockPool::push(Slab& slab, AudioBlock* block) {
+    uint64_t head = slab.free_head.load(std::memory_order_relaxed);
+    while (true) {
+        block->next_free.store(static_cast<uint32_t>(head), std::memory_order_relaxed);
+        uint64_t new_head = ((head >> 32) + 1) << 32 | (block->index + 1);
+        if (slab.free_head.compare_exchange_weak(head, new_head,
+                                                 std::memory_order_release,
+                                                 std::memory_order_relaxed)) {
+            slab.free_count.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+    }
+}
+
+void AudioBlockPool::release(AudioBlock* block) {
+    push(*slabs[block->slab], block);
+}
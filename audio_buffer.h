@@ -0,0 +1,134 @@
+#ifndef AUDIO_BUFFER_H
+#define AUDIO_BUFFER_H
+
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+#include <initializer_list>
+
+class AudioBlockPool;
+
+// Fixed-size block of samples handed out by an AudioBlockPool
+struct AudioBlock {
+    int16_t* data;
+    size_t capacity;
+    std::atomic<int> refs;
+    std::atomic<uint32_t> next_free;  // Free list link (index + 1, 0 = end)
+    uint32_t index;   // Position within its slab
+    uint32_t slab;
+    AudioBlockPool* pool;
+};
+
+// Move-only, ref-counted view over a pooled block of interleaved samples.
+// Copies are explicit through share()/slice(), which add a reference to the
+// same block instead of duplicating samples. The block goes back to its pool
+// when the last view is destroyed.
+class AudioBuffer {
+public:
+    AudioBuffer() {}
+    ~AudioBuffer() { reset(); }
+
+    AudioBuffer(AudioBuffer&& other) noexcept;
+    AudioBuffer& operator=(AudioBuffer&& other) noexcept;
+    AudioBuffer(const AudioBuffer&) = delete;
+    AudioBuffer& operator=(const AudioBuffer&) = delete;
+
+    bool valid() const { return block != nullptr; }
+    bool empty() const { return length == 0; }
+
+    // Samples are interleaved; size() counts samples, frames() counts frames
+    int16_t* data() { return block ? block->data + offset : nullptr; }
+    const int16_t* data() const { return block ? block->data + offset : nullptr; }
+    size_t size() const { return length; }
+    size_t frames() const { return channels ? length / channels : 0; }
+    size_t capacity() const { return block ? block->capacity - offset : 0; }
+
+    // Sizes are clamped to capacity(); append() returns the samples copied
+    void resize(size_t samples);
+    size_t append(const int16_t* src, size_t samples);
+
+    // Additional views of the same samples. Only write through data() while
+    // holding the sole reference (see isShared()).
+    AudioBuffer share() const;
+    AudioBuffer slice(size_t sample_offset, size_t sample_count) const;
+    bool isShared() const { return block && block->refs.load(std::memory_order_acquire) > 1; }
+
+    // Copies sample rate, channel count and stream position (including the
+    // discontinuity flag), not samples
+    void copyFormatFrom(const AudioBuffer& other);
+
+    void reset();  // Drops this view's reference
+
+    // Set by whoever fills the buffer; 0 until then, never a guessed rate
+    size_t sampleRate = 0;
+    size_t channels = 1;
+
+    // Position of the first frame in the capture stream (frames since streaming
+    // started, including any frames lost to overruns) and the matching
+    // monotonic time in microseconds derived from the sample clock
+    uint64_t startFrame = 0;
+    int64_t timestampUs = 0;
+
+    // Frames were lost just before this buffer, so its first sample does not
+    // follow on from the previous buffer of the stream. Stages that carry
+    // state across buffers start over instead of joining the two.
+    bool discontinuity = false;
+
+private:
+    friend class AudioBlockPool;
+
+    AudioBlock* block = nullptr;
+    size_t offset = 0;
+    size_t length = 0;
+};
+
+// Slab allocator for AudioBuffers. All sample memory is allocated and touched
+// up front; acquire() and release are lock-free and never hit the heap.
+// Every AudioBuffer must be released before its pool is destroyed.
+class AudioBlockPool {
+public:
+    struct SizeClass {
+        size_t block_count;
+        size_t block_samples;
+    };
+
+    AudioBlockPool(std::initializer_list<SizeClass> classes);
+    ~AudioBlockPool();
+
+    AudioBlockPool(const AudioBlockPool&) = delete;
+    AudioBlockPool& operator=(const AudioBlockPool&) = delete;
+
+    // Returns a buffer of `samples` samples from the smallest size class that
+    // fits, falling back to larger classes. Returns an invalid buffer when the
+    // pool is exhausted.
+    AudioBuffer acquire(size_t samples);
+
+    size_t freeBlocks() const;
+    size_t maxBlockSamples() const;
+    uint64_t getExhaustedCount() const { return exhausted; }
+
+private:
+    friend class AudioBuffer;
+
+    struct Slab {
+        size_t block_samples;
+        std::unique_ptr<int16_t[]> storage;
+        std::unique_ptr<AudioBlock[]> blocks;
+        size_t block_count;
+        // Tagged free list head: high 32 bits are an ABA counter, low 32 bits
+        // hold the block index + 1 (0 means empty)
+        std::atomic<uint64_t> free_head;
+        std::atomic<size_t> free_count;
+    };
+
+    std::vector<std::unique_ptr<Slab>> slabs;  // Sorted by block size
+    std::atomic<uint64_t> exhausted;
+
+    AudioBlock* pop(Slab& slab);
+    void push(Slab& slab, AudioBlock* block);
+    void release(AudioBlock* block);
+};
+
+#endif // AUDIO_BUFFER_H
@@ -3,136 +3,349 @@
 #include <stdexcept>
 #include <thread>
 #include <chrono>
+#include <algorithm>
+#include <cstring>
+#include "dsp_kernels.h"
+#include "tracer.h"
 
-AudioCapture::AudioCapture(int sample_rate, int channels) 
-    : sample_rate(sample_rate), channels(channels), gain(1.0), capture_handle(nullptr) {
-    if (!initializeALSA()) {
-        throw std::runtime_error("Failed to initialize ALSA audio capture");
+static int64_t monotonicMicros() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+AudioCapture::AudioCapture(AudioBlockPool& pool, std::unique_ptr<CaptureSource> capture_source) 
+    : pool(pool), source(std::move(capture_source)), sample_rate(0), channels(0), gain(1.0),
+      streaming(false), source_finished(false), stream_start_us(0), overrun_frames(0),
+      overrun_count(0), source_lost_frames(0), source_gap_count(0), dropped_frames(0), gap_head(0),
+      gap_tail(0), pending_lost(0), lost_before_read(0), lost_reported(0), window_dropped(false) {
+    if (!source) {
+        throw std::invalid_argument("Audio capture needs a source");
     }
+    sample_rate = source->getSampleRate();
+    channels = source->getChannels();
+    converter.reset(new FormatConverter(pool, sample_rate, channels, sample_rate));
 }
 
 AudioCapture::~AudioCapture() {
-    closeALSA();
+    stopStreaming();
 }
 
-bool AudioCapture::initializeALSA() {
-    int err;
-    
-    // Open PCM device for recording
-    if ((err = snd_pcm_open(&capture_handle, "hw:1,0", SND_PCM_STREAM_CAPTURE, 0)) < 0) {
-        std::cerr << "Cannot open audio device: " << snd_strerror(err) << std::endl;
-        return false;
+AudioBuffer AudioCapture::captureAudio(int duration_ms) {
+    // In streaming mode the capture thread owns the device, so pull the
+    // window out of the ring instead
+    if (streaming) {
+        AudioBuffer result;
+        readWindow(result, (static_cast<size_t>(getSampleRate()) * duration_ms) / 1000);
+        return result;
     }
     
-    // Allocate hardware parameters object
-    snd_pcm_hw_params_t *hw_params;
-    snd_pcm_hw_params_alloca(&hw_params);
+    int frames_to_capture = (sample_rate * duration_ms) / 1000;
     
-    // Fill it with default values
-    if ((err = snd_pcm_hw_params_any(capture_handle, hw_params)) < 0) {
-        std::cerr << "Cannot configure this PCM device: " << snd_strerror(err) << std::endl;
-        return false;
+    AudioBuffer result = pool.acquire(frames_to_capture * channels);
+    if (!result.valid()) {
+        std::cerr << "No free audio buffer for " << frames_to_capture << " frames" << std::endl;
+        return result;
     }
     
-    // Set the desired hardware parameters
-    
-    // Interleaved mode
-    if ((err = snd_pcm_hw_params_set_access(capture_handle, hw_params, SND_PCM_ACCESS_RW_INTERLEAVED)) < 0) {
-        std::cerr << "Cannot set access type: " << snd_strerror(err) << std::endl;
-        return false;
+    // Read the specified number of frames. Failed reads are retried after
+    // the source recovers; frames lost meanwhile can't be put back, so the
+    // buffer is cut at the gap rather than joined across it.
+    const int kMaxFailedReads = 3;
+    size_t got = 0;
+    int failed_reads = 0;
+    while (got < static_cast<size_t>(frames_to_capture) && !source->isFinished()) {
+        size_t count = source->read(result.data() + got * channels, frames_to_capture - got);
+        uint64_t lost = source->takeLostFrames();
+        if (lost > 0) {
+            source_lost_frames += lost;
+            source_gap_count++;
+            if (got > 0) {
+                source_lost_frames += count;  // These follow the gap too
+                break;
+            }
+            result.discontinuity = true;
+        }
+        if (count == 0) {
+            if (++failed_reads >= kMaxFailedReads) {
+                break;
+            }
+            continue;
+        }
+        got += count;
     }
+    if (got != static_cast<size_t>(frames_to_capture) && !source->isFinished()) {
+        std::cerr << "Warning: read " << got << " frames instead of " << frames_to_capture << std::endl;
+    }
+    // Never pad with silence the caller can't tell from real audio
+    result.resize(got * channels);
     
-    // Signed 16-bit little-endian format
-    if ((err = snd_pcm_hw_params_set_format(capture_handle, hw_params, SND_PCM_FORMAT_S16_LE)) < 0) {
-        std::cerr << "Cannot set sample format: " << snd_strerror(err) << std::endl;
-        return false;
+    // Apply gain if needed
+    applyGain(result.data(), result.data(), result.size(), gain.load(std::memory_order_relaxed));
+    
+    result.sampleRate = sample_rate;
+    result.channels = channels;
+    
+    // Blocking captures aren't one stream; each starts the filter afresh
+    converter->reset();
+    return converter->process(std::move(result));
+}
+
+void AudioCapture::setGain(float new_gain) {
+    gain.store(new_gain, std::memory_order_relaxed);
+}
+
+void AudioCapture::applyGain(const int16_t* src, int16_t* dst, size_t count, float gain) {
+    if (gain == 1.0f) {
+        if (src != dst) {
+            std::memcpy(dst, src, count * sizeof(int16_t));
+        }
+        return;
+    }
+    applyGainS16(src, dst, count, gain);
+}
+
+void AudioCapture::setSampleRate(int new_rate) {
+    if (new_rate != converter->getOutputRate()) {
+        converter->setOutputRate(new_rate);
+    }
+}
+
+bool AudioCapture::startStreaming(int ring_ms, int period_ms) {
+    if (streaming) {
+        return true;
     }
     
-    // Set channels
-    if ((err = snd_pcm_hw_params_set_channels(capture_handle, hw_params, channels)) < 0) {
-        std::cerr << "Cannot set channel count: " << snd_strerror(err) << std::endl;
+    size_t ring_frames = (static_cast<size_t>(sample_rate) * ring_ms) / 1000;
+    size_t period_frames = (static_cast<size_t>(sample_rate) * period_ms) / 1000;
+    if (period_frames == 0 || ring_frames < 2 * period_frames) {
+        std::cerr << "Invalid streaming configuration: ring " << ring_ms
+                  << " ms, period " << period_ms << " ms" << std::endl;
         return false;
     }
     
-    // Set sample rate
-    unsigned int actual_rate = sample_rate;
-    if ((err = snd_pcm_hw_params_set_rate_near(capture_handle, hw_params, &actual_rate, 0)) < 0) {
-        std::cerr << "Cannot set sample rate: " << snd_strerror(err) << std::endl;
-        return false;
+    ring.reset(new AudioRingBuffer(ring_frames, channels));
+    period_buffer.assign(period_frames * channels, 0);
+    overrun_frames = 0;
+    overrun_count = 0;
+    gap_head = 0;
+    gap_tail = 0;
+    pending_lost = 0;
+    lost_before_read = 0;
+    lost_reported = 0;
+    window_dropped = false;
+    source_finished = false;
+    converter->reset();
+    
+    stream_start_us = monotonicMicros();
+    streaming = true;
+    capture_thread = std::thread(&AudioCapture::captureLoop, this);
+    return true;
+}
+
+void AudioCapture::stopStreaming() {
+    if (!streaming) {
+        return;
     }
     
-    if (actual_rate != (unsigned int)sample_rate) {
-        std::cout << "Warning: actual sample rate (" << actual_rate 
-                  << ") differs from requested rate (" << sample_rate << ")" << std::endl;
-        sample_rate = actual_rate;
+    streaming = false;
+    {
+        std::lock_guard<std::mutex> lock(data_mutex);
     }
+    data_ready.notify_all();
+    space_ready.notify_all();
     
-    // Apply the hardware configuration
-    if ((err = snd_pcm_hw_params(capture_handle, hw_params)) < 0) {
-        std::cerr << "Cannot set parameters: " << snd_strerror(err) << std::endl;
-        return false;
+    if (capture_thread.joinable()) {
+        capture_thread.join();
     }
     
-    // Prepare the PCM device for use
-    if ((err = snd_pcm_prepare(capture_handle)) < 0) {
-        std::cerr << "Cannot prepare audio interface: " << snd_strerror(err) << std::endl;
+    // Discard whatever is left in the hardware buffer so a later blocking
+    // captureAudio() starts from fresh samples
+    source->discard();
+}
+
+void AudioCapture::captureLoop() {
+    Tracer::setThreadName("capture");
+    const size_t period_frames = period_buffer.size() / channels;
+    uint64_t lost_total = 0;
+    bool ring_overrun = false;
+    
+    const bool live = source->isLive();
+    
+    while (streaming) {
+        // A recording can wait for the consumer instead of losing frames,
+        // which keeps replays deterministic
+        if (!live) {
+            std::unique_lock<std::mutex> lock(data_mutex);
+            space_ready.wait(lock, [&] { return !streaming || ring->space() >= period_frames; });
+        }
+        
+        // With room for a period the source writes straight into the ring,
+        // so each frame is copied once on its way in. Otherwise the frames
+        // still have to be taken from the device, and are dropped.
+        int16_t* dest = period_buffer.data();
+        size_t wanted = period_frames;
+        bool fits = ring->space() >= period_frames;
+        if (fits) {
+            wanted = ring->reserve(period_frames, dest);
+        }
+        
+        size_t frames;
+        {
+            TRACE_SCOPE("capture.read");
+            frames = source->read(dest, wanted);
+        }
+        
+        // Whatever the device lost comes before the frames just read
+        uint64_t source_lost = source->takeLostFrames();
+        if (source_lost > 0) {
+            source_lost_frames += source_lost;
+            source_gap_count++;
+            pending_lost += source_lost;
+            lost_total += source_lost;
+        }
+        
+        if (frames == 0) {
+            if (source->isFinished()) {
+                // Wake the consumer so it can drain the ring and stop
+                {
+                    std::lock_guard<std::mutex> lock(data_mutex);
+                    source_finished = true;
+                }
+                data_ready.notify_all();
+                return;
+            }
+            continue;
+        }
+        
+        // A pending gap must be published before the frames that follow it,
+        // otherwise the consumer would timestamp them too early
+        if (fits && pending_lost > 0) {
+            fits = publishGap(ring->writePosition(), lost_total);
+        }
+        
+        if (fits) {
+            pending_lost = 0;
+            ring_overrun = false;
+            ring->commit(frames);
+            {
+                std::lock_guard<std::mutex> lock(data_mutex);
+            }
+            data_ready.notify_all();
+        } else {
+            if (!ring_overrun) {
+                overrun_count++;
+                ring_overrun = true;
+            }
+            pending_lost += frames;
+            lost_total += frames;
+            overrun_frames += frames;
+        }
+    }
+}
+
+bool AudioCapture::publishGap(uint64_t ring_pos, uint64_t lost_total) {
+    uint64_t head = gap_head.load(std::memory_order_relaxed);
+    if (head - gap_tail.load(std::memory_order_acquire) >= kMaxGaps) {
         return false;
     }
-    
+    gaps[head % kMaxGaps] = Gap{ring_pos, lost_total};
+    gap_head.store(head + 1, std::memory_order_release);
     return true;
 }
 
-void AudioCapture::closeALSA() {
-    if (capture_handle) {
-        snd_pcm_close(capture_handle);
-        capture_handle = nullptr;
+uint64_t AudioCapture::consumeGaps(uint64_t ring_pos) {
+    uint64_t tail = gap_tail.load(std::memory_order_relaxed);
+    uint64_t head = gap_head.load(std::memory_order_acquire);
+    while (tail < head && gaps[tail % kMaxGaps].ring_pos <= ring_pos) {
+        lost_before_read = gaps[tail % kMaxGaps].lost_total;
+        tail++;
     }
+    gap_tail.store(tail, std::memory_order_release);
+    return tail < head ? gaps[tail % kMaxGaps].ring_pos : UINT64_MAX;
 }
 
-AudioBuffer AudioCapture::captureAudio(int duration_ms) {
-    int err;
-    int frames_to_capture = (sample_rate * duration_ms) / 1000;
-    std::vector<int16_t> buffer(frames_to_capture * channels);
-    
-    // Read the specified number of frames
-    if ((err = snd_pcm_readi(capture_handle, buffer.data(), frames_to_capture)) != frames_to_capture) {
-        if (err < 0) {
-            std::cerr << "Error reading from PCM device: " << snd_strerror(err) << std::endl;
-            // Try to recover
-            snd_pcm_recover(capture_handle, err, 0);
-        } else {
-            std::cerr << "Warning: read " << err << " frames instead of " << frames_to_capture << std::endl;
+bool AudioCapture::isFinished() const {
+    return source_finished && (!ring || ring->available() == 0);
+}
+
+bool AudioCapture::readWindow(AudioBuffer& out, size_t output_frames, int timeout_ms) {
+    if (!ring || output_frames == 0) {
+        return false;
+    }
+    
+    // Device frames needed for the window, rounded up
+    int output_rate = converter->getOutputRate();
+    size_t frames = (output_frames * sample_rate + output_rate - 1) / output_rate;
+    if (frames > ring->capacity()) {
+        std::cerr << "Requested window of " << frames << " frames exceeds ring capacity of "
+                  << ring->capacity() << std::endl;
+        return false;
+    }
+    
+    {
+        std::unique_lock<std::mutex> lock(data_mutex);
+        auto ready = [&] { return !streaming || source_finished || ring->available() >= frames; };
+        if (timeout_ms < 0) {
+            data_ready.wait(lock, ready);
+        } else if (!data_ready.wait_for(lock, std::chrono::milliseconds(timeout_ms), ready)) {
+            return false;
         }
     }
     
-    // Apply gain if needed
-    if (gain != 1.0f) {
-        for (auto& sample : buffer) {
-            float value = sample * gain;
-            // Clamp to int16_t range
-            if (value > 32767.0f) value = 32767.0f;
-            if (value < -32768.0f) value = -32768.0f;
-            sample = static_cast<int16_t>(value);
+    if (ring->available() < frames) {
+        if (!source_finished || ring->available() == 0) {
+            return false;  // Streaming stopped before the window filled
         }
+        frames = ring->available();
     }
     
-    AudioBuffer result(buffer);
-    result.sampleRate = sample_rate;
-    result.channels = channels;
-    return result;
-}
-
-void AudioCapture::setGain(float new_gain) {
-    gain = new_gain;
-}
-
-void AudioCapture::setSampleRate(int new_rate) {
-    if (new_rate != sample_rate) {
-        sample_rate = new_rate;
-        // Reinitialize ALSA with new sample rate
-        closeALSA();
-        if (!initializeALSA()) {
-            throw std::runtime_error("Failed to reinitialize ALSA with new sample rate");
+    // A window never spans a gap, so its samples are contiguous in time and
+    // only its start can follow lost frames
+    uint64_t ring_pos = ring->readPosition();
+    uint64_t next_gap = consumeGaps(ring_pos);
+    if (next_gap < ring_pos + frames) {
+        frames = static_cast<size_t>(next_gap - ring_pos);
+    }
+    
+    // Drop our reference to the previous window first so its block can be
+    // reused right away
+    out.reset();
+    out = pool.acquire(frames * channels);
+    if (!out.valid()) {
+        return false;
+    }
+    
+    // Apply gain while copying out of the ring so each sample is touched once
+    const float window_gain = gain.load(std::memory_order_relaxed);
+    const int16_t* first;
+    const int16_t* second;
+    size_t first_frames, second_frames;
+    ring->peek(frames, first, first_frames, second, second_frames);
+    applyGain(first, out.data(), first_frames * channels, window_gain);
+    applyGain(second, out.data() + first_frames * channels, second_frames * channels, window_gain);
+    ring->skip(frames);
+    if (!source->isLive()) {
+        {
+            std::lock_guard<std::mutex> lock(data_mutex);
         }
+        space_ready.notify_one();
+    }
+    
+    out.sampleRate = sample_rate;
+    out.channels = channels;
+    out.startFrame = ring_pos + lost_before_read;
+    out.discontinuity = lost_before_read != lost_reported || window_dropped;
+    lost_reported = lost_before_read;
+    out.timestampUs = stream_start_us +
+        static_cast<int64_t>((out.startFrame * 1000000ULL) / sample_rate);
+    
+    TRACE_SCOPE("capture.convert");
+    out = converter->process(std::move(out));
+    // The frames have already left the ring, so a failed conversion loses
+    // them; the next window then follows a gap like any other
+    window_dropped = !out.valid();
+    if (window_dropped) {
+        dropped_frames += frames;
     }
+    return out.valid();
 } 
\ No newline at end of file
@@ -3,36 +3,114 @@
 
 #include <vector>
 #include <cstdint>
-#include <alsa/asoundlib.h>
-
-// Simple audio buffer class
-class AudioBuffer {
-public:
-    AudioBuffer() {}
-    AudioBuffer(const std::vector<int16_t>& data) : samples(data) {}
-    
-    std::vector<int16_t> samples;
-    size_t sampleRate = 44100;
-    size_t channels = 1;
-};
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <memory>
+#include "audio_buffer.h"
+#include "audio_ring_buffer.h"
+#include "capture_source.h"
+#include "format_converter.h"
 
+// Captured audio is handed out as mono at getSampleRate(). The source keeps
+// its native format; a software conversion stage turns that into the output
+// rate on the consumer's side of the ring.
 class AudioCapture {
 public:
-    AudioCapture(int sample_rate = 44100, int channels = 1);
+    // Captured buffers are drawn from `pool`, which must outlive this object.
+    // Frames come from `source`, e.g. an AlsaCaptureSource or a
+    // ReplayCaptureSource. Output starts at the source's own rate.
+    AudioCapture(AudioBlockPool& pool, std::unique_ptr<CaptureSource> source);
     ~AudioCapture();
-    
+
     AudioBuffer captureAudio(int duration_ms = 1000);
     void setGain(float gain);
+
+    // Changes the output rate without stopping capture or touching the
+    // device. Safe to call from any thread; the switch happens between two
+    // windows with no audio dropped. Throws std::invalid_argument for a rate
+    // the converter can't reach from the device rate.
     void setSampleRate(int sample_rate);
-    
+    int getSampleRate() const { return converter->getOutputRate(); }
+
+    // Format the source delivers
+    int getDeviceSampleRate() const { return sample_rate; }
+    int getDeviceChannels() const { return channels; }
+
+    // Streaming mode: a dedicated thread reads the device period by period
+    // into a lock-free ring, and consumers pull windows of any length
+    bool startStreaming(int ring_ms = 4000, int period_ms = 20);
+    void stopStreaming();
+    bool isStreaming() const { return streaming; }
+
+    // Blocks until enough audio for `frames` output frames is available and
+    // replaces `out` with a pooled buffer holding it. Returns false if
+    // streaming stopped, the timeout (if >= 0) expired first or the pool had
+    // no free block. When converting, a window may be a frame or so off
+    // `frames`; once a finite source has ended, the last one may be shorter.
+    bool readWindow(AudioBuffer& out, size_t frames, int timeout_ms = -1);
+
+    // The source ended and every frame it produced has been read
+    bool isFinished() const;
+
+    // Frames the capture thread had to discard because the ring was full
+    uint64_t getOverrunFrames() const { return overrun_frames; }
+    uint64_t getOverrunCount() const { return overrun_count; }
+
+    // Frames the source itself lost, e.g. to device overruns
+    uint64_t getSourceLostFrames() const { return source_lost_frames; }
+    uint64_t getSourceGapCount() const { return source_gap_count; }
+
+    // Frames taken from the ring for a window that then failed to convert,
+    // e.g. because the pool had no free block
+    uint64_t getDroppedFrames() const { return dropped_frames; }
+
 private:
-    snd_pcm_t *capture_handle;
-    int sample_rate;
+    AudioBlockPool& pool;
+    std::unique_ptr<CaptureSource> source;
+    int sample_rate;    // Of the source
     int channels;
-    float gain;
-    
-    bool initializeALSA();
-    void closeALSA();
+    std::atomic<float> gain;  // Set from any thread, loaded once per window
+    std::unique_ptr<FormatConverter> converter;
+
+    // Streaming state
+    std::unique_ptr<AudioRingBuffer> ring;
+    std::vector<int16_t> period_buffer;
+    std::thread capture_thread;
+    std::atomic<bool> streaming;
+    std::atomic<bool> source_finished;
+    std::mutex data_mutex;
+    std::condition_variable data_ready;
+    std::condition_variable space_ready;  // Non-live sources wait on readWindow()
+    int64_t stream_start_us;
+    std::atomic<uint64_t> overrun_frames;
+    std::atomic<uint64_t> overrun_count;
+    std::atomic<uint64_t> source_lost_frames;
+    std::atomic<uint64_t> source_gap_count;
+    std::atomic<uint64_t> dropped_frames;
+
+    // Overruns remove frames from the ring's timeline. Each gap is published
+    // as (ring position, total frames lost so far) so the consumer can map ring
+    // positions back to sample-accurate stream positions.
+    struct Gap {
+        uint64_t ring_pos;
+        uint64_t lost_total;
+    };
+    static const size_t kMaxGaps = 64;
+    Gap gaps[kMaxGaps];
+    std::atomic<uint64_t> gap_head;   // Written by the capture thread
+    std::atomic<uint64_t> gap_tail;   // Written by the consumer
+    uint64_t pending_lost;            // Capture thread only
+    uint64_t lost_before_read;        // Consumer only
+    uint64_t lost_reported;           // Consumer only: lost_before_read as of the last window
+    bool window_dropped;              // Consumer only: the last window never reached the caller
+
+    void captureLoop();
+    bool publishGap(uint64_t ring_pos, uint64_t lost_total);
+    // Applies the gaps up to `ring_pos`; returns where the next one starts
+    uint64_t consumeGaps(uint64_t ring_pos);
+    static void applyGain(const int16_t* src, int16_t* dst, size_t count, float gain);
 };
 
-#endif // AUDIO_CAPTURE_H 
\ No newline at end of file
+#endif // AUDIO_CAPTURE_H
\ No newline at end of file
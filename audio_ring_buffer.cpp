@@ -0,0 +1,115 @@
+#include "audio_ring_buffer.h"
+#include <algorithm>
+#include <cstring>
+
+static size_t roundUpToPowerOfTwo(size_t value) {
+    size_t result = 1;
+    while (result < value) {
+        result <<= 1;
+    }
+    return result;
+}
+
+AudioRingBuffer::AudioRingBuffer(size_t requested_frames, int channels)
+    : capacity_frames(roundUpToPowerOfTwo(std::max<size_t>(requested_frames, 2))),
+      mask(0), channels(channels), write_pos(0), read_pos(0) {
+    mask = capacity_frames - 1;
+    storage.resize(capacity_frames * channels);
+}
+
+size_t AudioRingBuffer::write(const int16_t* data, size_t frames) {
+    const uint64_t w = write_pos.load(std::memory_order_relaxed);
+    const uint64_t r = read_pos.load(std::memory_order_acquire);
+
+    size_t free_frames = capacity_frames - static_cast<size_t>(w - r);
+    size_t to_write = std::min(frames, free_frames);
+    if (to_write == 0) {
+        return 0;
+    }
+
+    // Copy in at most two pieces around the wrap point
+    size_t start = static_cast<size_t>(w) & mask;
+    size_t first = std::min(to_write, capacity_frames - start);
+    std::memcpy(&storage[start * channels], data, first * channels * sizeof(int16_t));
+    if (to_write > first) {
+        std::memcpy(&storage[0], data + first * channels,
+                    (to_write - first) * channels * sizeof(int16_t));
+    }
+
+    write_pos.store(w + to_write, std::memory_order_release);
+    return to_write;
+}
+
+size_t AudioRingBuffer::reserve(size_t frames, int16_t*& dest) {
+    const uint64_t w = write_pos.load(std::memory_order_relaxed);
+    const uint64_t r = read_pos.load(std::memory_order_acquire);
+
+    size_t free_frames = capacity_frames - static_cast<size_t>(w - r);
+    size_t start = static_cast<size_t>(w) & mask;
+    dest = &storage[start * channels];
+    return std::min(std::min(frames, free_frames), capacity_frames - start);
+}
+
+void AudioRingBuffer::commit(size_t frames) {
+    const uint64_t w = write_pos.load(std::memory_order_relaxed);
+    write_pos.store(w + frames, std::memory_order_release);
+}
+
+size_t AudioRingBuffer::read(int16_t* dest, size_t frames) {
+    const uint64_t r = read_pos.load(std::memory_order_relaxed);
+    const uint64_t w = write_pos.load(std::memory_order_acquire);
+
+    size_t to_read = std::min(frames, static_cast<size_t>(w - r));
+    if (to_read == 0) {
+        return 0;
+    }
+
+    size_t start = static_cast<size_t>(r) & mask;
+    size_t first = std::min(to_read, capacity_frames - start);
+    std::memcpy(dest, &storage[start * channels], first * channels * sizeof(int16_t));
+    if (to_read > first) {
+        std::memcpy(dest + first * channels, &storage[0],
+                    (to_read - first) * channels * sizeof(int16_t));
+    }
+
+    read_pos.store(r + to_read, std::memory_order_release);
+    return to_read;
+}
+
+size_t AudioRingBuffer::skip(size_t frames) {
+    const uint64_t r = read_pos.load(std::memory_order_relaxed);
+    const uint64_t w = write_pos.load(std::memory_order_acquire);
+
+    size_t to_skip = std::min(frames, static_cast<size_t>(w - r));
+    read_pos.store(r + to_skip, std::memory_order_release);
+    return to_skip;
+}
+
+size_t AudioRingBuffer::peek(size_t frames, const int16_t*& first, size_t& first_frames,
+                             const int16_t*& second, size_t& second_frames) const {
+    const uint64_t r = read_pos.load(std::memory_order_relaxed);
+    const uint64_t w = write_pos.load(std::memory_order_acquire);
+
+    size_t to_read = std::min(frames, static_cast<size_t>(w - r));
+    size_t start = static_cast<size_t>(r) & mask;
+    first_frames = std::min(to_read, capacity_frames - start);
+    second_frames = to_read - first_frames;
+    first = &storage[start * channels];
+    second = &storage[0];
+    return to_read;
+}
+
+size_t AudioRingBuffer::available() const {
+    const uint64_t r = read_pos.load(std::memory_order_acquire);
+    const uint64_t w = write_pos.load(std::memory_order_acquire);
+    return static_cast<size_t>(w - r);
+}
+
+size_t AudioRingBuffer::space() const {
+    return capacity_frames - available();
+}
+
+void AudioRingBuffer::reset() {
+    write_pos.store(0, std::memory_order_relaxed);
+    read_pos.store(0, std::memory_order_relaxed);
+}
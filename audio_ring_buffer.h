@@ -0,0 +1,57 @@
+#ifndef AUDIO_RING_BUFFER_H
+#define AUDIO_RING_BUFFER_H
+
+#include <vector>
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+
+// Lock-free single-producer/single-consumer ring of interleaved int16 frames.
+// One thread may call write(), one other thread may call read()/skip().
+// Positions are free-running frame counters, so they double as a sample clock.
+class AudioRingBuffer {
+public:
+    AudioRingBuffer(size_t capacity_frames, int channels = 1);
+
+    // Producer side: copies up to `frames` frames, returns the number written
+    size_t write(const int16_t* data, size_t frames);
+
+    // Producer side, zero-copy: exposes up to `frames` free frames as one
+    // contiguous span (cut short at the wrap point) for the caller to fill.
+    // Returns the frames exposed; commit() then publishes those filled.
+    size_t reserve(size_t frames, int16_t*& dest);
+    void commit(size_t frames);
+
+    // Consumer side: copies up to `frames` frames, returns the number read
+    size_t read(int16_t* dest, size_t frames);
+    size_t skip(size_t frames);
+
+    // Consumer side, zero-copy: exposes the next frames as up to two
+    // contiguous spans (the second is empty unless the data wraps). Returns
+    // the total frames exposed; call skip() once they have been consumed.
+    size_t peek(size_t frames, const int16_t*& first, size_t& first_frames,
+                const int16_t*& second, size_t& second_frames) const;
+
+    size_t available() const;   // Frames ready to be read
+    size_t space() const;       // Frames that can be written without overrun
+    size_t capacity() const { return capacity_frames; }
+    int getChannels() const { return channels; }
+
+    uint64_t readPosition() const { return read_pos.load(std::memory_order_acquire); }
+    uint64_t writePosition() const { return write_pos.load(std::memory_order_acquire); }
+
+    void reset();  // Only safe while neither side is active
+
+private:
+    std::vector<int16_t> storage;
+    size_t capacity_frames;   // Power of two
+    size_t mask;
+    int channels;
+
+    // Keep the two indices on separate cache lines so the producer and
+    // consumer don't bounce the same line between cores
+    alignas(64) std::atomic<uint64_t> write_pos;
+    alignas(64) std::atomic<uint64_t> read_pos;
+};
+
+#endif // AUDIO_RING_BUFFER_H
@@ -0,0 +1,44 @@
+#ifndef BENCH_COMMON_H
+#define BENCH_COMMON_H
+
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <string>
+#include <chrono>
+#include <algorithm>
+
+// Timing and reporting shared by the stage benchmarks
+
+typedef std::chrono::steady_clock Clock;
+
+inline double elapsedMs(Clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+// Every call's duration for one stage
+struct StageTimes {
+    std::string name;
+    std::vector<double> ms;
+};
+
+// Prints one line of latency percentiles; sorts `stage.ms`
+inline void reportStage(StageTimes& stage) {
+    std::cout << "  " << std::left << std::setw(11) << stage.name << std::right;
+    if (stage.ms.empty()) {
+        std::cout << " no samples" << std::endl;
+        return;
+    }
+    std::sort(stage.ms.begin(), stage.ms.end());
+    auto percentile = [&](double p) {
+        return stage.ms[std::min(stage.ms.size() - 1, static_cast<size_t>(p * stage.ms.size()))];
+    };
+    std::cout << std::fixed << std::setprecision(3)
+              << " p50 " << std::setw(9) << percentile(0.50)
+              << "  p90 " << std::setw(9) << percentile(0.90)
+              << "  p99 " << std::setw(9) << percentile(0.99)
+              << "  max " << std::setw(9) << stage.ms.back()
+              << " ms  (" << stage.ms.size() << " calls)" << std::endl;
+}
+
+#endif // BENCH_COMMON_H
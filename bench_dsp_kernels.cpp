@@ -0,0 +1,91 @@
+// Micro-benchmark for the sample kernels in dsp_kernels.cpp
+//
+// Build:  cmake -S . -B build && cmake --build build --target bench_dsp_kernels
+// Usage:  ./bench_dsp_kernels [samples_per_block] [iterations]
+
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <chrono>
+#include <random>
+#include <string>
+#include <functional>
+#include <cstdlib>
+#include "dsp_kernels.h"
+
+static volatile float g_sink;
+
+static void report(const std::string& name, size_t samples, size_t iterations,
+                   const std::function<void()>& kernel) {
+    // Warm caches and branch predictors before timing
+    for (int i = 0; i < 10; i++) {
+        kernel();
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < iterations; i++) {
+        kernel();
+    }
+    auto end = std::chrono::steady_clock::now();
+
+    double seconds = std::chrono::duration<double>(end - start).count();
+    double rate = (double)samples * iterations / seconds;
+    std::cout << std::left << std::setw(28) << name << std::right << std::fixed
+              << std::setprecision(1) << std::setw(10) << rate / 1e6 << " Msamples/s"
+              << std::setw(10) << rate / 44100.0 << "x realtime @44.1k" << std::endl;
+}
+
+int main(int argc, char** argv) {
+    size_t samples = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 4410;
+    size_t iterations = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 20000;
+
+    std::mt19937 rng(1234);
+    std::uniform_int_distribution<int> dist(-32768, 32767);
+    std::vector<int16_t> s16(samples), s16_out(samples);
+    std::vector<float> f32(samples);
+    for (auto& sample : s16) {
+        sample = static_cast<int16_t>(dist(rng));
+    }
+
+    std::cout << "DSP kernel backend: " << dspKernelBackend() << ", " << samples
+              << " samples x " << iterations << " iterations" << std::endl;
+
+    // The loops the kernels replaced, for comparison
+    report("baseline gain (scalar)", samples, iterations, [&] {
+        for (size_t i = 0; i < samples; i++) {
+            float value = s16[i] * 1.5f;
+            if (value > 32767.0f) value = 32767.0f;
+            if (value < -32768.0f) value = -32768.0f;
+            s16_out[i] = static_cast<int16_t>(value);
+        }
+        g_sink = s16_out[samples / 2];
+    });
+    report("baseline s16->f32 (scalar)", samples, iterations, [&] {
+        for (size_t i = 0; i < samples; i++) {
+            f32[i] = float(s16[i]) / 32768.0f;
+        }
+        g_sink = f32[samples / 2];
+    });
+
+    report("applyGainS16", samples, iterations, [&] {
+        applyGainS16(s16.data(), s16_out.data(), samples, 1.5f);
+        g_sink = s16_out[samples / 2];
+    });
+    report("convertS16ToF32", samples, iterations, [&] {
+        convertS16ToF32(s16.data(), f32.data(), samples);
+        g_sink = f32[samples / 2];
+    });
+    report("gainConvertS16ToF32", samples, iterations, [&] {
+        gainConvertS16ToF32(s16.data(), f32.data(), samples, 1.5f);
+        g_sink = f32[samples / 2];
+    });
+    report("convertF32ToS16", samples, iterations, [&] {
+        convertF32ToS16(f32.data(), s16_out.data(), samples);
+        g_sink = s16_out[samples / 2];
+    });
+    report("dotProductF32", samples, iterations, [&] {
+        g_sink = dotProductF32(f32.data(), f32.data(), samples);
+    });
+
+    return 0;
+}
@@ -0,0 +1,138 @@
+// Acoustic keyword spotting benchmark: replayed capture -> noise reduction ->
+// features -> KeywordSpotter, with the same 50 ms windows as the device loop
+//
+// Build:  cmake -S . -B build && cmake --build build --target bench_keyword_spotter
+// Usage:  ./bench_keyword_spotter <templates.bin> <recording.wav>... [--realtime] [--mel-bands 80]
+//
+// Templates come from the main program's --enroll; --mel-bands must match the
+// model they were enrolled with (128 for large-v3). Every detection is
+// listed with its position in the recording. Its latency is the audio the
+// spotter had to hear past the end of the word (the rest of that window plus
+// the hop it waits) plus the time spent processing the window, i.e. how
+// long after the word ends the device would alert.
+
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <string>
+#include <chrono>
+#include <algorithm>
+#include <memory>
+#include <cstdlib>
+#include "audio_capture.h"
+#include "replay_capture_source.h"
+#include "noise_reduction.h"
+#include "feature_extractor.h"
+#include "keyword_spotter.h"
+#include "bench_common.h"
+
+int main(int argc, char** argv) {
+    std::string templates_path;
+    std::vector<std::string> files;
+    ReplayCaptureSource::Pacing pacing = ReplayCaptureSource::FAST;
+    int mel_bands = 80;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--realtime") {
+            pacing = ReplayCaptureSource::REALTIME;
+        } else if (arg == "--mel-bands" && i + 1 < argc) {
+            mel_bands = std::atoi(argv[++i]);
+        } else if (templates_path.empty()) {
+            templates_path = arg;
+        } else {
+            files.push_back(arg);
+        }
+    }
+    if (files.empty()) {
+        std::cerr << "Usage: " << argv[0]
+                  << " <templates.bin> <recording.wav>... [--realtime] [--mel-bands 80]" << std::endl;
+        return 1;
+    }
+
+    AudioBlockPool pool({{32, 16384}});
+    FeatureExtractor features(16000, mel_bands);
+    KeywordSpotter spotter(features);
+    if (!spotter.loadTemplates(templates_path)) {
+        return 1;
+    }
+
+    StageTimes denoise{"denoise", {}}, analyse{"features", {}}, spot{"spotter", {}},
+               latency{"latency", {}};
+    double audio_seconds = 0;
+    size_t detection_count = 0;
+    auto total_start = Clock::now();
+
+    for (const std::string& path : files) {
+        std::unique_ptr<ReplayCaptureSource> replay(new ReplayCaptureSource(path, pacing));
+        audio_seconds += static_cast<double>(replay->getTotalFrames()) / replay->getSampleRate();
+
+        // Captured at 16 kHz by the converter, as on the device
+        AudioCapture audio(pool, std::move(replay));
+        audio.setSampleRate(16000);
+        NoiseReduction noise;
+        noise.enableAdaptiveMode(true);
+        features.reset();
+        spotter.reset();
+
+        const size_t window_frames = 16000 / 20;  // 50 ms
+        AudioBuffer buffer;
+        std::vector<KeywordSpotter::Detection> detections;
+        int64_t stream_start_us = -1;
+        if (!audio.startStreaming()) {
+            return 1;
+        }
+        while (audio.readWindow(buffer, window_frames)) {
+            if (buffer.empty()) {
+                continue;
+            }
+            if (stream_start_us < 0) {
+                stream_start_us = buffer.timestampUs;
+            }
+            int64_t window_end_us = buffer.timestampUs +
+                static_cast<int64_t>(buffer.frames() * 1000000 / buffer.sampleRate);
+            auto window_start = Clock::now();
+
+            auto start = Clock::now();
+            buffer = noise.processAudio(std::move(buffer));
+            denoise.ms.push_back(elapsedMs(start));
+
+            start = Clock::now();
+            features.process(buffer);
+            analyse.ms.push_back(elapsedMs(start));
+
+            start = Clock::now();
+            detections.clear();
+            spotter.process(detections);
+            spot.ms.push_back(elapsedMs(start));
+
+            double processing_ms = elapsedMs(window_start);
+            for (const KeywordSpotter::Detection& detection : detections) {
+                double ms = (window_end_us - detection.endUs) / 1000.0 + processing_ms;
+                latency.ms.push_back(ms);
+                detection_count++;
+                std::cout << path << ": \"" << detection.keyword << "\" at "
+                          << std::fixed << std::setprecision(2)
+                          << (detection.startUs - stream_start_us) / 1e6 << "-"
+                          << (detection.endUs - stream_start_us) / 1e6 << " s, distance "
+                          << detection.distance << ", latency " << std::setprecision(1)
+                          << ms << " ms" << std::endl;
+            }
+        }
+        audio.stopStreaming();
+    }
+
+    double total_s = elapsedMs(total_start) / 1000.0;
+
+    std::cout << std::endl << "Keyword spotting over " << files.size() << " files, "
+              << std::fixed << std::setprecision(1) << audio_seconds << " s of audio ("
+              << (pacing == ReplayCaptureSource::REALTIME ? "real-time" : "fast") << " replay), "
+              << spotter.getTemplateCount() << " templates, " << detection_count << " detections"
+              << std::endl;
+    for (StageTimes* stage : {&denoise, &analyse, &spot, &latency}) {
+        reportStage(*stage);
+    }
+    std::cout << std::setprecision(3)
+              << "  RTF        " << (audio_seconds > 0 ? total_s / audio_seconds : 0.0)
+              << " (" << total_s << " s wall)" << std::endl;
+    return 0;
+}
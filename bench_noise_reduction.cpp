@@ -0,0 +1,104 @@
+// Real-time factor benchmark for the streaming NoiseReduction engine
+//
+// Build:  cmake -S . -B build && cmake --build build --target bench_noise_reduction
+// Usage:  ./bench_noise_reduction [seconds_of_audio]
+//
+// Runs single-threaded, so the reported real-time factor is per core. Heap
+// allocations are counted while streaming to confirm the steady state
+// allocates nothing.
+
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <chrono>
+#include <random>
+#include <atomic>
+#include <cmath>
+#include <cstdlib>
+#include <new>
+#include "noise_reduction.h"
+
+static std::atomic<size_t> g_allocations(0);
+
+void* operator new(size_t size) {
+    g_allocations++;
+    void* ptr = std::malloc(size);
+    if (!ptr) {
+        throw std::bad_alloc();
+    }
+    return ptr;
+}
+
+void operator delete(void* ptr) noexcept {
+    std::free(ptr);
+}
+
+void operator delete(void* ptr, size_t) noexcept {
+    std::free(ptr);
+}
+
+int main(int argc, char** argv) {
+    const int sample_rate = 16000;
+    int seconds = argc > 1 ? std::atoi(argv[1]) : 60;
+    size_t total = static_cast<size_t>(seconds) * sample_rate;
+
+    // A few harmonics with a slow syllable-rate envelope over white noise
+    std::mt19937 rng(42);
+    std::normal_distribution<float> noise(0.0f, 1500.0f);
+    std::vector<int16_t> signal(total);
+    for (size_t i = 0; i < total; i++) {
+        double t = static_cast<double>(i) / sample_rate;
+        double envelope = 0.5 + 0.5 * std::sin(2.0 * 3.14159265 * 4.0 * t);
+        double voice = 0;
+        for (int h = 1; h <= 5; h++) {
+            voice += std::sin(2.0 * 3.14159265 * 150.0 * h * t) / h;
+        }
+        double value = 4000.0 * envelope * voice + noise(rng);
+        signal[i] = static_cast<int16_t>(std::max(-32768.0, std::min(32767.0, value)));
+    }
+
+    AudioBlockPool pool({{4, 16000}, {1, 16000 * 2}});
+
+    // Noise-only profile
+    AudioBuffer profile = pool.acquire(sample_rate * 2);
+    for (size_t i = 0; i < profile.size(); i++) {
+        profile.data()[i] = static_cast<int16_t>(noise(rng));
+    }
+    profile.sampleRate = sample_rate;
+
+    std::cout << "Noise reduction: " << seconds << " s of 16 kHz audio, single thread" << std::endl;
+
+    for (int adaptive = 0; adaptive <= 1; adaptive++)
+    for (size_t chunk : {160, 1000, 1600, 16000}) {
+        NoiseReduction nr;
+        nr.setNoiseProfile(profile);
+        nr.enableAdaptiveMode(adaptive != 0);
+
+        // Warm up so any lazily sized state is in place before measuring
+        AudioBuffer warm = pool.acquire(chunk);
+        warm.sampleRate = sample_rate;
+        warm = nr.processAudio(std::move(warm));
+        warm.reset();
+
+        size_t allocations_before = g_allocations;
+        auto start = std::chrono::steady_clock::now();
+
+        for (size_t offset = 0; offset + chunk <= total; offset += chunk) {
+            AudioBuffer buffer = pool.acquire(chunk);
+            std::copy(signal.begin() + offset, signal.begin() + offset + chunk, buffer.data());
+            buffer.sampleRate = sample_rate;
+            buffer = nr.processAudio(std::move(buffer));
+        }
+
+        auto end = std::chrono::steady_clock::now();
+        size_t allocations = g_allocations - allocations_before;
+
+        double elapsed = std::chrono::duration<double>(end - start).count();
+        std::cout << (adaptive ? "  adaptive" : "  static  ") << " chunk " << std::setw(5) << chunk << " samples: "
+                  << std::fixed << std::setprecision(4) << "RTF " << elapsed / seconds
+                  << " (" << std::setprecision(1) << seconds / elapsed << "x realtime), "
+                  << allocations << " heap allocations" << std::endl;
+    }
+
+    return 0;
+}
@@ -0,0 +1,339 @@
+// End-to-end benchmark of the device's audio thread over a corpus of
+// recordings: replayed capture (converted to 16 kHz) -> noise reduction ->
+// features -> acoustic keyword spotting -> voice activity -> streaming
+// Whisper on the worker pool -> text keyword detection
+//
+// Build:  cmake -S . -B build && cmake --build build --target bench_pipeline
+// Usage:  ./bench_pipeline <corpus_dir> [--realtime] [--keywords help,emergency,alert]
+//                          [--templates keyword_templates.bin]
+//
+// The corpus is a directory of 16-bit PCM .wav files, each with a .txt
+// reference transcript of the same name. The stages are built and wired as
+// in audioProcessingThread() in main.cpp. Files are replayed as fast as the
+// pipeline takes them unless --realtime is given, so runs are repeatable:
+// the replay waits for the pipeline instead of dropping frames, and the
+// worker pool blocks instead of merging jobs. --realtime keeps the device's
+// COALESCE backpressure; the merges are reported. Reports per-stage latency
+// percentiles (queue and transcribe are per worker job), the real-time
+// factor, peak RSS, word error rate, and keyword hits of the transcript
+// and, given enrolled templates, of the acoustic spotter.
+
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include <string>
+#include <chrono>
+#include <algorithm>
+#include <memory>
+#include <cctype>
+#include <mutex>
+#include <dirent.h>
+#include <sys/resource.h>
+#include "audio_capture.h"
+#include "replay_capture_source.h"
+#include "noise_reduction.h"
+#include "feature_extractor.h"
+#include "keyword_spotter.h"
+#include "voice_activity_detector.h"
+#include "speech_to_text.h"
+#include "streaming_transcriber.h"
+#include "transcription_worker_pool.h"
+#include "keyword_detector.h"
+#include "bench_common.h"
+
+// Lower case words of letters, digits and apostrophes
+static std::vector<std::string> normalizeWords(const std::string& text) {
+    std::vector<std::string> words;
+    std::string word;
+    for (char c : text) {
+        unsigned char u = static_cast<unsigned char>(c);
+        if (std::isalnum(u) || c == '\'') {
+            word += static_cast<char>(std::tolower(u));
+        } else if (!word.empty()) {
+            words.push_back(word);
+            word.clear();
+        }
+    }
+    if (!word.empty()) {
+        words.push_back(word);
+    }
+    return words;
+}
+
+// Word-level Levenshtein distance: substitutions + deletions + insertions
+static size_t wordErrors(const std::vector<std::string>& ref, const std::vector<std::string>& hyp) {
+    std::vector<size_t> row(hyp.size() + 1), prev(hyp.size() + 1);
+    for (size_t j = 0; j <= hyp.size(); j++) {
+        prev[j] = j;
+    }
+    for (size_t i = 1; i <= ref.size(); i++) {
+        row[0] = i;
+        for (size_t j = 1; j <= hyp.size(); j++) {
+            size_t cost = ref[i - 1] == hyp[j - 1] ? 0 : 1;
+            row[j] = std::min(std::min(prev[j] + 1, row[j - 1] + 1), prev[j - 1] + cost);
+        }
+        prev.swap(row);
+    }
+    return prev[hyp.size()];
+}
+
+static std::vector<size_t> keywordCounts(KeywordDetector& detector, const std::string& text) {
+    std::vector<KeywordDetector::Match> matches;
+    detector.reset();
+    detector.feed(text, matches);
+    std::vector<size_t> counts(detector.getKeywordCount(), 0);
+    for (const KeywordDetector::Match& match : matches) {
+        counts[match.keyword]++;
+    }
+    return counts;
+}
+
+static void scoreKeywords(const std::vector<size_t>& found, const std::vector<size_t>& expected,
+                          size_t& hits, size_t& misses, size_t& false_hits) {
+    for (size_t k = 0; k < found.size(); k++) {
+        hits += std::min(found[k], expected[k]);
+        misses += expected[k] - std::min(found[k], expected[k]);
+        false_hits += found[k] - std::min(found[k], expected[k]);
+    }
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        std::cerr << "Usage: " << argv[0] << " <corpus_dir> [--realtime] [--keywords a,b,c]"
+                  << " [--templates keyword_templates.bin]" << std::endl;
+        return 1;
+    }
+    std::string corpus = argv[1];
+    ReplayCaptureSource::Pacing pacing = ReplayCaptureSource::FAST;
+    std::vector<std::string> keywords = {"emergency", "help", "alert"};
+    std::string templates_path;
+    for (int i = 2; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--realtime") {
+            pacing = ReplayCaptureSource::REALTIME;
+        } else if (arg == "--keywords" && i + 1 < argc) {
+            keywords.clear();
+            std::stringstream list(argv[++i]);
+            std::string keyword;
+            while (std::getline(list, keyword, ',')) {
+                if (!keyword.empty()) {
+                    keywords.push_back(keyword);
+                }
+            }
+        } else if (arg == "--templates" && i + 1 < argc) {
+            templates_path = argv[++i];
+        }
+    }
+
+    // Sorted so every run visits the corpus in the same order
+    std::vector<std::string> files;
+    if (DIR* dir = opendir(corpus.c_str())) {
+        while (dirent* entry = readdir(dir)) {
+            std::string name = entry->d_name;
+            if (name.size() > 4 && name.compare(name.size() - 4, 4, ".wav") == 0) {
+                files.push_back(corpus + "/" + name);
+            }
+        }
+        closedir(dir);
+    }
+    std::sort(files.begin(), files.end());
+    if (files.empty()) {
+        std::cerr << "No .wav files in " << corpus << std::endl;
+        return 1;
+    }
+
+    // Same stages and settings as the device
+    AudioBlockPool pool({{32, 16384}});
+    SpeechToText stt("whisper");
+    FeatureExtractor features(16000, stt.getMelBands(), 3000);
+    VoiceActivityDetector vad(pool, features);
+    StreamingTranscriber transcriber(stt, 500, 5000, 200);
+    transcriber.setFeatureSource(&features);
+    // A fast replay outruns Whisper, and what a COALESCE pool merges would
+    // then depend on thread timing; blocking keeps the runs repeatable
+    TranscriptionWorkerPool workers(stt, pool, 1, 8,
+                                    pacing == ReplayCaptureSource::REALTIME
+                                        ? TranscriptionWorkerPool::COALESCE
+                                        : TranscriptionWorkerPool::BLOCK);
+    KeywordSpotter spotter(features);
+    bool acoustic = !templates_path.empty() && spotter.loadTemplates(templates_path);
+    KeywordDetector detector(keywords);
+
+    StageTimes capture{"capture", {}}, denoise{"denoise", {}}, analyse{"features", {}},
+               spot{"spotter", {}}, gate{"vad", {}}, submit{"submit", {}},
+               queue{"queue", {}}, transcribe{"transcribe", {}}, text_spot{"keywords", {}};
+    double audio_seconds = 0;
+    size_t ref_words = 0, word_errors = 0;
+    size_t keyword_hits = 0, keyword_misses = 0, keyword_false = 0;
+    size_t acoustic_hits = 0, acoustic_misses = 0, acoustic_false = 0;
+
+    // Filled on the worker thread
+    std::mutex result_mutex;
+    std::string hypothesis;
+    KeywordDetector stream_detector(keywords);
+    std::vector<KeywordDetector::Match> matches;
+    auto on_result = [&](const TranscriptionWorkerPool::Result& result) {
+        std::lock_guard<std::mutex> lock(result_mutex);
+        if (result.dropped) {
+            return;
+        }
+        queue.ms.push_back(result.queue_ms);
+        transcribe.ms.push_back(result.inference_ms);
+        for (const std::string* text : {&result.cut_text, &result.text}) {
+            if (text->empty()) {
+                continue;
+            }
+            auto start = Clock::now();
+            matches.clear();
+            stream_detector.feed(*text, matches);
+            text_spot.ms.push_back(elapsedMs(start));
+            hypothesis += *text;
+            hypothesis += ' ';
+        }
+    };
+
+    auto total_start = Clock::now();
+
+    for (const std::string& path : files) {
+        std::string stem = path.substr(0, path.size() - 4);
+        std::ifstream ref_file(stem + ".txt");
+        if (!ref_file) {
+            std::cerr << "Skipping " << path << ": no reference transcript" << std::endl;
+            continue;
+        }
+        std::string reference((std::istreambuf_iterator<char>(ref_file)), std::istreambuf_iterator<char>());
+
+        std::unique_ptr<ReplayCaptureSource> replay(new ReplayCaptureSource(path, pacing));
+        audio_seconds += static_cast<double>(replay->getTotalFrames()) / replay->getSampleRate();
+
+        // The recording keeps its own rate; capture converts to 16 kHz
+        AudioCapture audio(pool, std::move(replay));
+        audio.setSampleRate(16000);
+        NoiseReduction noise;
+        noise.enableAdaptiveMode(true);
+        features.reset();
+        vad.reset();
+        transcriber.reset();
+        spotter.reset();
+        {
+            std::lock_guard<std::mutex> lock(result_mutex);
+            hypothesis.clear();
+            stream_detector.reset();
+        }
+
+        // Same 50 ms windows as the device loop
+        const size_t window_frames = audio.getSampleRate() / 20;
+        AudioBuffer buffer;
+        std::vector<KeywordSpotter::Detection> detections;
+        std::vector<size_t> heard(keywords.size(), 0);
+        if (!audio.startStreaming()) {
+            return 1;
+        }
+        while (true) {
+            auto start = Clock::now();
+            bool captured = audio.readWindow(buffer, window_frames, 500);
+            capture.ms.push_back(elapsedMs(start));
+            if (!captured) {
+                if (audio.isFinished()) {
+                    break;
+                }
+                continue;
+            }
+            if (buffer.empty()) {
+                continue;
+            }
+
+            start = Clock::now();
+            buffer = noise.processAudio(std::move(buffer));
+            denoise.ms.push_back(elapsedMs(start));
+
+            start = Clock::now();
+            features.process(buffer);
+            analyse.ms.push_back(elapsedMs(start));
+
+            start = Clock::now();
+            detections.clear();
+            spotter.process(detections);
+            spot.ms.push_back(elapsedMs(start));
+            for (const KeywordSpotter::Detection& detection : detections) {
+                auto it = std::find(keywords.begin(), keywords.end(), detection.keyword);
+                if (it != keywords.end()) {
+                    heard[it - keywords.begin()]++;
+                }
+            }
+
+            start = Clock::now();
+            VoiceActivityDetector::Result speech = vad.process(std::move(buffer));
+            gate.ms.push_back(elapsedMs(start));
+
+            if (!speech.speech.empty() || speech.segment_end) {
+                start = Clock::now();
+                workers.submitStream(transcriber, std::move(speech.speech), speech.segment_end,
+                                     on_result);
+                submit.ms.push_back(elapsedMs(start));
+            }
+        }
+        audio.stopStreaming();
+
+        // Flush the last words before scoring the file
+        workers.submitStream(transcriber, AudioBuffer(), true, on_result);
+        workers.waitIdle();
+
+        std::string text;
+        {
+            std::lock_guard<std::mutex> lock(result_mutex);
+            text = hypothesis;
+        }
+        std::vector<size_t> expected = keywordCounts(detector, reference);
+        scoreKeywords(keywordCounts(detector, text), expected,
+                      keyword_hits, keyword_misses, keyword_false);
+        if (acoustic) {
+            scoreKeywords(heard, expected, acoustic_hits, acoustic_misses, acoustic_false);
+        }
+
+        std::vector<std::string> ref = normalizeWords(reference);
+        size_t errors = wordErrors(ref, normalizeWords(text));
+        ref_words += ref.size();
+        word_errors += errors;
+        std::cout << path << ": " << errors << " errors / " << ref.size() << " words" << std::endl;
+    }
+
+    double total_s = elapsedMs(total_start) / 1000.0;
+    rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+
+    std::cout << std::endl << "Pipeline over " << files.size() << " files, "
+              << std::fixed << std::setprecision(1) << audio_seconds << " s of audio ("
+              << (pacing == ReplayCaptureSource::REALTIME ? "real-time" : "fast") << " replay)"
+              << std::endl;
+    for (StageTimes* stage : {&capture, &denoise, &analyse, &spot, &gate, &submit, &queue,
+                              &transcribe, &text_spot}) {
+        reportStage(*stage);
+    }
+    std::cout << std::setprecision(3)
+              << "  RTF        " << (audio_seconds > 0 ? total_s / audio_seconds : 0.0)
+              << " (" << total_s << " s wall)" << std::endl
+              << "  Peak RSS   " << usage.ru_maxrss / 1024.0 << " MiB" << std::endl
+              << "  WER        " << (ref_words ? 100.0 * word_errors / ref_words : 0.0)
+              << "% (" << word_errors << " / " << ref_words << " words)" << std::endl
+              << "  Keywords   " << keyword_hits << " hit, " << keyword_misses << " missed, "
+              << keyword_false << " false" << std::endl;
+    if (acoustic) {
+        std::cout << "  Acoustic   " << acoustic_hits << " hit, " << acoustic_misses << " missed, "
+                  << acoustic_false << " false" << std::endl;
+    }
+    const VoiceActivityDetector::Stats& vad_stats = vad.getStats();
+    const StreamingTranscriber::Stats& stt_stats = transcriber.getStats();
+    TranscriptionWorkerPool::Stats pool_stats = workers.getStats();
+    std::cout << "  Workers    " << pool_stats.submitted << " jobs, " << pool_stats.coalesced
+              << " coalesced, " << pool_stats.dropped << " dropped, " << pool_stats.blocked
+              << " blocked" << std::endl;
+    if (vad_stats.processed_samples > 0) {
+        std::cout << "  Speech     " << 100.0 * vad_stats.forwarded_samples / vad_stats.processed_samples
+                  << "% forwarded, " << stt_stats.decodes << " decodes (" << stt_stats.mel_decodes
+                  << " from shared mel)" << std::endl;
+    }
+    return 0;
+}
@@ -0,0 +1,38 @@
+#ifndef CAPTURE_SOURCE_H
+#define CAPTURE_SOURCE_H
+
+#include <cstddef>
+#include <cstdint>
+
+// Where AudioCapture gets its frames from: the wearable's microphone, or a
+// recording replayed for tests and benchmarks. Reads block like a device
+// period read would. Only the capture thread calls read().
+class CaptureSource {
+public:
+    virtual ~CaptureSource() {}
+
+    // Format of the frames read() returns, fixed for the source's lifetime
+    virtual int getSampleRate() const = 0;
+    virtual int getChannels() const = 0;
+
+    // Reads up to `frames` interleaved S16 frames into `dest`. Returns the
+    // frames read; 0 if the read failed and the source recovered, or the
+    // source has ended.
+    virtual size_t read(int16_t* dest, size_t frames) = 0;
+
+    // Frames the source lost since the last call (e.g. to a device overrun),
+    // all of them before the frames of the next successful read()
+    virtual uint64_t takeLostFrames() { return 0; }
+
+    // Recordings end; devices never do
+    virtual bool isFinished() const { return false; }
+
+    // A live source produces frames whether or not they are read, so a full
+    // ring has to drop them. Other sources can simply wait for room.
+    virtual bool isLive() const { return true; }
+
+    // Discards buffered input so the next read() starts from fresh frames
+    virtual void discard() {}
+};
+
+#endif // CAPTURE_SOURCE_H
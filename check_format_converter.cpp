@@ -0,0 +1,210 @@
+// Consistency check for FormatConverter's mid-stream rate switch
+//
+// Build:  cmake -S . -B build && cmake --build build --target check_format_converter
+// Usage:  ./check_format_converter
+//
+// Feeds the same signal to a converter that never switches and to one that
+// is switched to the same output rate every few chunks. A switch primes the
+// new filter from the converter's tail, so the two streams must match sample
+// for sample.
+//
+// Then walks one 48 kHz converter through real rate changes, including a
+// switch to and from pass-through. Each output buffer must start where the
+// previous one ended, and every sample must stay close to the ideal signal
+// at its timestamp.
+//
+// Both checks run twice: with chunks of 1 to 100 samples (many shorter than
+// the resampler's history), and with chunks of at least the resampler's
+// 8192-sample processing block, which a freshly primed filter must split.
+// Configure with -DVOCATALK_ASAN=ON to catch overruns. Exits non-zero on the
+// first failure.
+
+#include <iostream>
+#include <cmath>
+#include <cstdlib>
+#include <cstdint>
+#include <algorithm>
+#include "format_converter.h"
+
+struct ChunkPattern {
+    size_t min_samples;
+    size_t spread;        // Chunks are min_samples plus up to spread - 1
+    int rate_chunks;      // Chunks fed by checkRate()
+    int switch_every;     // checkRate() switches every this many chunks
+    int switch_chunks;    // Chunks per rate in checkSwitches()
+};
+
+static const ChunkPattern kSmallChunks = {1, 100, 2000, 7, 400};
+static const ChunkPattern kLargeChunks = {8192, 8192, 60, 2, 8};
+
+static size_t nextChunk(uint32_t& seed, const ChunkPattern& pattern) {
+    seed = seed * 1664525u + 1013904223u;
+    return pattern.min_samples + (seed >> 8) % pattern.spread;
+}
+
+static bool checkRate(AudioBlockPool& pool, int input_rate, int output_rate,
+                      const ChunkPattern& pattern) {
+    FormatConverter reference(pool, input_rate, 1, output_rate);
+    FormatConverter switched(pool, input_rate, 1, output_rate);
+    size_t compared = 0;
+
+    const double pi = 3.14159265358979323846;
+    uint32_t seed = 12345;
+    uint64_t position = 0;
+    for (int chunk = 0; chunk < pattern.rate_chunks; chunk++) {
+        size_t count = nextChunk(seed, pattern);
+        if (chunk % pattern.switch_every == pattern.switch_every / 2) {
+            switched.setOutputRate(output_rate);
+        }
+
+        AudioBuffer a = pool.acquire(count);
+        AudioBuffer b = pool.acquire(count);
+        if (!a.valid() || !b.valid()) {
+            std::cerr << "Pool exhausted" << std::endl;
+            return false;
+        }
+        for (AudioBuffer* buffer : {&a, &b}) {
+            buffer->resize(count);
+            buffer->sampleRate = input_rate;
+            buffer->channels = 1;
+            buffer->startFrame = position;
+            for (size_t i = 0; i < count; i++) {
+                double t = static_cast<double>(position + i) / input_rate;
+                buffer->data()[i] = static_cast<int16_t>(
+                    std::lround(8000 * std::sin(2 * pi * 440 * t) + 4000 * std::sin(2 * pi * 3100 * t)));
+            }
+        }
+        position += count;
+
+        AudioBuffer out_a = reference.process(std::move(a));
+        AudioBuffer out_b = switched.process(std::move(b));
+        if (out_a.size() != out_b.size() || out_a.startFrame != out_b.startFrame) {
+            std::cerr << input_rate << " -> " << output_rate << ": chunk " << chunk << " gave "
+                      << out_b.size() << " samples at " << out_b.startFrame << ", expected "
+                      << out_a.size() << " at " << out_a.startFrame << std::endl;
+            return false;
+        }
+        for (size_t i = 0; i < out_a.size(); i++) {
+            if (out_a.data()[i] != out_b.data()[i]) {
+                std::cerr << input_rate << " -> " << output_rate << ": chunk " << chunk
+                          << " sample " << i << " is " << out_b.data()[i] << ", expected "
+                          << out_a.data()[i] << std::endl;
+                return false;
+            }
+        }
+        compared += out_a.size();
+    }
+
+    std::cout << input_rate << " -> " << output_rate << ": " << compared
+              << " samples match across switches" << std::endl;
+    return true;
+}
+
+static double testSignal(double t) {
+    // Well inside the passband of every rate switched to below
+    const double pi = 3.14159265358979323846;
+    return 8000 * std::sin(2 * pi * 440 * t) + 4000 * std::sin(2 * pi * 1000 * t);
+}
+
+static bool checkSwitches(AudioBlockPool& pool, const ChunkPattern& pattern) {
+    const int input_rate = 48000;
+    const int rates[] = {16000, 8000, 16000, 48000, 16000, 44100, 16000};
+    const size_t num_rates = sizeof(rates) / sizeof(rates[0]);
+    // Skip the filter ramping up from silence at the very start
+    const int64_t settle_us = 5000;
+    const int64_t max_gap_us = 25;
+    // 1% of the signal's peak; the filters' own ripple stays under half that
+    const double max_error = 120.0;
+
+    FormatConverter converter(pool, input_rate, 1, rates[0]);
+    uint32_t seed = 54321;
+    uint64_t position = 0;
+    bool have_previous = false;
+    double previous_end_us = 0.0;
+    int previous_rate = rates[0];
+    double worst_gap_us = 0.0;
+    double worst_error = 0.0;
+
+    for (size_t r = 0; r < num_rates; r++) {
+        if (r > 0) {
+            converter.setOutputRate(rates[r]);
+        }
+        for (int chunk = 0; chunk < pattern.switch_chunks; chunk++) {
+            size_t count = nextChunk(seed, pattern);
+
+            AudioBuffer input = pool.acquire(count);
+            if (!input.valid()) {
+                std::cerr << "Pool exhausted" << std::endl;
+                return false;
+            }
+            input.resize(count);
+            input.sampleRate = input_rate;
+            input.channels = 1;
+            input.startFrame = position;
+            input.timestampUs = static_cast<int64_t>(position * 1000000ULL / input_rate);
+            for (size_t i = 0; i < count; i++) {
+                double t = static_cast<double>(position + i) / input_rate;
+                input.data()[i] = static_cast<int16_t>(std::lround(testSignal(t)));
+            }
+            position += count;
+
+            AudioBuffer output = converter.process(std::move(input));
+            if (!output.valid() || output.empty()) {
+                continue;
+            }
+            int rate = static_cast<int>(output.sampleRate);
+            if (rate != rates[r]) {
+                std::cerr << "Switch to " << rates[r] << " Hz: chunk " << chunk << " came out at "
+                          << rate << " Hz" << std::endl;
+                return false;
+            }
+
+            double start_us = static_cast<double>(output.timestampUs);
+            if (have_previous) {
+                double gap = std::fabs(start_us - previous_end_us);
+                worst_gap_us = std::max(worst_gap_us, gap);
+                if (gap > max_gap_us) {
+                    std::cerr << "Switch to " << rates[r] << " Hz: chunk " << chunk << " starts at "
+                              << start_us << " us, previous " << previous_rate
+                              << " Hz output ended at " << previous_end_us << " us" << std::endl;
+                    return false;
+                }
+            }
+            for (size_t i = 0; i < output.size(); i++) {
+                double t_us = start_us + i * 1e6 / rate;
+                if (t_us < settle_us) {
+                    continue;
+                }
+                double error = std::fabs(output.data()[i] - testSignal(t_us / 1e6));
+                worst_error = std::max(worst_error, error);
+                if (error > max_error) {
+                    std::cerr << "Switch to " << rates[r] << " Hz: chunk " << chunk << " sample "
+                              << i << " is off by " << error << std::endl;
+                    return false;
+                }
+            }
+            previous_end_us = start_us + output.size() * 1e6 / rate;
+            previous_rate = rate;
+            have_previous = true;
+        }
+    }
+
+    std::cout << input_rate << " Hz through " << num_rates - 1 << " rate switches: at most "
+              << worst_gap_us << " us between buffers, " << worst_error
+              << " from the ideal signal" << std::endl;
+    return true;
+}
+
+int main() {
+    AudioBlockPool pool({{16, 4096}, {8, 65536}});
+    bool ok = true;
+    for (const ChunkPattern* pattern : {&kSmallChunks, &kLargeChunks}) {
+        std::cout << "Chunks of " << pattern->min_samples << " to "
+                  << pattern->min_samples + pattern->spread - 1 << " samples" << std::endl;
+        ok = checkRate(pool, 44100, 16000, *pattern) && ok;
+        ok = checkRate(pool, 48000, 16000, *pattern) && ok;
+        ok = checkRate(pool, 16000, 44100, *pattern) && ok;
+        ok = checkSwitches(pool, *pattern) && ok;
+    }
+    return ok ? 0 : 1;
+}
@@ -5,7 +5,9 @@
 #include <sys/ioctl.h>
 #include <linux/i2c-dev.h>
 #include <cstring>
-#include <sstream>
+#include <cctype>
+#include <stdexcept>
+#include <algorithm>
 
 // SSD1306 OLED display commands
 #define SSD1306_ADDR 0x3C
@@ -16,32 +18,146 @@
 #define SSD1306_SETCONTRAST 0x81
 #define SSD1306_NORMALDISPLAY 0xA6
 #define SSD1306_INVERTDISPLAY 0xA7
+#define SSD1306_SETCOLUMNADDR 0x21
+#define SSD1306_SETPAGEADDR 0x22
 
-// Font data (5x8 font)
-// This would be a large array of font data for all ASCII characters
-// For brevity, I'm not including the full font data here
+// Unchanged columns this short between two changed runs are resent rather
+// than paying for another window setup and transaction
+static const int kMergeGap = 8;
+
+// 5x7 ASCII font, 0x20..0x7E, one byte per column with bit 0 at the top
+static const int kFirstGlyph = 0x20;
+static const int kGlyphCount = 95;
+static const int kGlyphColumns = 5;
+static constexpr uint8_t kFont5x7[kGlyphCount][kGlyphColumns] = {
+    {0x00, 0x00, 0x00, 0x00, 0x00}, {0x00, 0x00, 0x5F, 0x00, 0x00},   // space !
+    {0x00, 0x07, 0x00, 0x07, 0x00}, {0x14, 0x7F, 0x14, 0x7F, 0x14},   // " #
+    {0x24, 0x2A, 0x7F, 0x2A, 0x12}, {0x23, 0x13, 0x08, 0x64, 0x62},   // $ %
+    {0x36, 0x49, 0x55, 0x22, 0x50}, {0x00, 0x05, 0x03, 0x00, 0x00},   // & '
+    {0x00, 0x1C, 0x22, 0x41, 0x00}, {0x00, 0x41, 0x22, 0x1C, 0x00},   // ( )
+    {0x08, 0x2A, 0x1C, 0x2A, 0x08}, {0x08, 0x08, 0x3E, 0x08, 0x08},   // * +
+    {0x00, 0x50, 0x30, 0x00, 0x00}, {0x08, 0x08, 0x08, 0x08, 0x08},   // , -
+    {0x00, 0x60, 0x60, 0x00, 0x00}, {0x20, 0x10, 0x08, 0x04, 0x02},   // . /
+    {0x3E, 0x51, 0x49, 0x45, 0x3E}, {0x00, 0x42, 0x7F, 0x40, 0x00},   // 0 1
+    {0x42, 0x61, 0x51, 0x49, 0x46}, {0x21, 0x41, 0x45, 0x4B, 0x31},   // 2 3
+    {0x18, 0x14, 0x12, 0x7F, 0x10}, {0x27, 0x45, 0x45, 0x45, 0x39},   // 4 5
+    {0x3C, 0x4A, 0x49, 0x49, 0x30}, {0x01, 0x71, 0x09, 0x05, 0x03},   // 6 7
+    {0x36, 0x49, 0x49, 0x49, 0x36}, {0x06, 0x49, 0x49, 0x29, 0x1E},   // 8 9
+    {0x00, 0x36, 0x36, 0x00, 0x00}, {0x00, 0x56, 0x36, 0x00, 0x00},   // : ;
+    {0x08, 0x14, 0x22, 0x41, 0x00}, {0x14, 0x14, 0x14, 0x14, 0x14},   // < =
+    {0x00, 0x41, 0x22, 0x14, 0x08}, {0x02, 0x01, 0x51, 0x09, 0x06},   // > ?
+    {0x32, 0x49, 0x79, 0x41, 0x3E}, {0x7E, 0x11, 0x11, 0x11, 0x7E},   // @ A
+    {0x7F, 0x49, 0x49, 0x49, 0x36}, {0x3E, 0x41, 0x41, 0x41, 0x22},   // B C
+    {0x7F, 0x41, 0x41, 0x22, 0x1C}, {0x7F, 0x49, 0x49, 0x49, 0x41},   // D E
+    {0x7F, 0x09, 0x09, 0x01, 0x01}, {0x3E, 0x41, 0x41, 0x51, 0x32},   // F G
+    {0x7F, 0x08, 0x08, 0x08, 0x7F}, {0x00, 0x41, 0x7F, 0x41, 0x00},   // H I
+    {0x20, 0x40, 0x41, 0x3F, 0x01}, {0x7F, 0x08, 0x14, 0x22, 0x41},   // J K
+    {0x7F, 0x40, 0x40, 0x40, 0x40}, {0x7F, 0x02, 0x04, 0x02, 0x7F},   // L M
+    {0x7F, 0x04, 0x08, 0x10, 0x7F}, {0x3E, 0x41, 0x41, 0x41, 0x3E},   // N O
+    {0x7F, 0x09, 0x09, 0x09, 0x06}, {0x3E, 0x41, 0x51, 0x21, 0x5E},   // P Q
+    {0x7F, 0x09, 0x19, 0x29, 0x46}, {0x46, 0x49, 0x49, 0x49, 0x31},   // R S
+    {0x01, 0x01, 0x7F, 0x01, 0x01}, {0x3F, 0x40, 0x40, 0x40, 0x3F},   // T U
+    {0x1F, 0x20, 0x40, 0x20, 0x1F}, {0x7F, 0x20, 0x18, 0x20, 0x7F},   // V W
+    {0x63, 0x14, 0x08, 0x14, 0x63}, {0x03, 0x04, 0x78, 0x04, 0x03},   // X Y
+    {0x61, 0x51, 0x49, 0x45, 0x43}, {0x00, 0x7F, 0x41, 0x41, 0x00},   // Z [
+    {0x02, 0x04, 0x08, 0x10, 0x20}, {0x00, 0x41, 0x41, 0x7F, 0x00},   // \ ]
+    {0x04, 0x02, 0x01, 0x02, 0x04}, {0x40, 0x40, 0x40, 0x40, 0x40},   // ^ _
+    {0x00, 0x01, 0x02, 0x04, 0x00}, {0x20, 0x54, 0x54, 0x54, 0x78},   // ` a
+    {0x7F, 0x48, 0x44, 0x44, 0x38}, {0x38, 0x44, 0x44, 0x44, 0x20},   // b c
+    {0x38, 0x44, 0x44, 0x48, 0x7F}, {0x38, 0x54, 0x54, 0x54, 0x18},   // d e
+    {0x08, 0x7E, 0x09, 0x01, 0x02}, {0x08, 0x14, 0x54, 0x54, 0x3C},   // f g
+    {0x7F, 0x08, 0x04, 0x04, 0x78}, {0x00, 0x44, 0x7D, 0x40, 0x00},   // h i
+    {0x20, 0x40, 0x44, 0x3D, 0x00}, {0x00, 0x7F, 0x10, 0x28, 0x44},   // j k
+    {0x00, 0x41, 0x7F, 0x40, 0x00}, {0x7C, 0x04, 0x18, 0x04, 0x78},   // l m
+    {0x7C, 0x08, 0x04, 0x04, 0x78}, {0x38, 0x44, 0x44, 0x44, 0x38},   // n o
+    {0x7C, 0x14, 0x14, 0x14, 0x08}, {0x08, 0x14, 0x14, 0x18, 0x7C},   // p q
+    {0x7C, 0x08, 0x04, 0x04, 0x08}, {0x48, 0x54, 0x54, 0x54, 0x20},   // r s
+    {0x04, 0x3F, 0x44, 0x40, 0x20}, {0x3C, 0x40, 0x40, 0x20, 0x7C},   // t u
+    {0x1C, 0x20, 0x40, 0x20, 0x1C}, {0x3C, 0x40, 0x30, 0x40, 0x3C},   // v w
+    {0x44, 0x28, 0x10, 0x28, 0x44}, {0x0C, 0x50, 0x50, 0x50, 0x3C},   // x y
+    {0x44, 0x64, 0x54, 0x4C, 0x44}, {0x00, 0x08, 0x36, 0x41, 0x00},   // z {
+    {0x00, 0x00, 0x7F, 0x00, 0x00}, {0x00, 0x41, 0x36, 0x08, 0x00},   // | }
+    {0x02, 0x01, 0x02, 0x04, 0x02}                                    // ~
+};
+
+// Glyphs pre-rendered in the framebuffer's layout: for each glyph, `Scale`
+// pages of `kCellWidth` column bytes, with the spacing column included, so
+// drawing a glyph is one memcpy per page. Larger fonts are the 5x7 font
+// with every pixel scaled up, generated at compile time.
+template <int Scale>
+struct GlyphAtlas {
+    static constexpr int kCellWidth = (kGlyphColumns + 1) * Scale;
+    static constexpr int kPages = Scale;
+    uint8_t columns[kGlyphCount * kPages * kCellWidth];
+
+    constexpr GlyphAtlas() : columns() {
+        for (int glyph = 0; glyph < kGlyphCount; glyph++) {
+            uint8_t* cell = columns + glyph * kPages * kCellWidth;
+            for (int x = 0; x < kGlyphColumns * Scale; x++) {
+                uint8_t bits = kFont5x7[glyph][x / Scale];
+                for (int y = 0; y < 8 * Scale; y++) {
+                    if (bits & (1 << (y / Scale))) {
+                        cell[(y / 8) * kCellWidth + x] |= static_cast<uint8_t>(1 << (y % 8));
+                    }
+                }
+            }
+        }
+    }
+};
+
+static constexpr GlyphAtlas<1> kSmallAtlas;
+static constexpr GlyphAtlas<2> kLargeAtlas;
+
+struct Display::Font {
+    int cell_width;
+    int pages;
+    const uint8_t* columns;
+};
+
+static const Display::Font kFonts[] = {
+    {GlyphAtlas<1>::kCellWidth, GlyphAtlas<1>::kPages, kSmallAtlas.columns},   // FONT_SMALL, 6x8
+    {GlyphAtlas<2>::kCellWidth, GlyphAtlas<2>::kPages, kLargeAtlas.columns}    // FONT_LARGE, 12x16
+};
 
 Display::Display(int width, int height) 
-    : width(width), height(height), brightness(255), is_inverted(false), i2c_fd(-1) {
+    : width(width), height(height), brightness(255), is_inverted(false), i2c_fd(-1),
+      font(&kFonts[FONT_SMALL]), pages(height / 8), shadow_valid(false) {
+    if (width <= 0 || width > 128 || height <= 0 || height > 64 || height % 8 != 0) {
+        throw std::invalid_argument("Unsupported display size");
+    }
+    framebuffer.assign(pages * width, 0);
+    shadow.assign(pages * width, 0);
+    transfer.reserve(width + 1);
+    wrapped.reserve(pages);
+    
     if (!initializeI2C()) {
         throw std::runtime_error("Failed to initialize I2C for display");
     }
     
-    // Initialize display
-    sendCommand(SSD1306_DISPLAYOFF);
-    
-    // Various initialization commands for SSD1306
-    // ... (omitted for brevity)
-    
-    // Set contrast
-    sendCommand(SSD1306_SETCONTRAST);
-    sendCommand(brightness);
-    
-    // Normal display (not inverted)
-    sendCommand(SSD1306_NORMALDISPLAY);
-    
-    // Turn on display
-    sendCommand(SSD1306_DISPLAYON);
+    // Horizontal addressing, so a column/page window can be filled by one
+    // block of data
+    const uint8_t init[] = {
+        SSD1306_DISPLAYOFF,
+        0xD5, 0x80,                                 // Clock divide ratio / oscillator
+        0xA8, static_cast<uint8_t>(height - 1),     // Multiplex ratio
+        0xD3, 0x00,                                 // No display offset
+        0x40,                                       // Start line 0
+        0x8D, 0x14,                                 // Charge pump on
+        0x20, 0x00,                                 // Horizontal addressing mode
+        0xA1,                                       // Column 127 mapped to SEG0
+        0xC8,                                       // COM scan remapped
+        0xDA, static_cast<uint8_t>(height == 64 ? 0x12 : 0x02),   // COM pins
+        SSD1306_SETCONTRAST, static_cast<uint8_t>(brightness),
+        0xD9, 0xF1,                                 // Pre-charge period
+        0xDB, 0x40,                                 // VCOMH deselect level
+        0xA4,                                       // Display follows RAM
+        SSD1306_NORMALDISPLAY,
+        SSD1306_DISPLAYON
+    };
+    if (!sendCommands(init, sizeof(init))) {
+        closeI2C();
+        throw std::runtime_error("Failed to initialize display");
+    }
     
     // Clear the display initially
     clear();
@@ -78,75 +194,202 @@ void Display::closeI2C() {
     }
 }
 
-void Display::sendCommand(uint8_t command) {
-    uint8_t buffer[2] = {SSD1306_COMMAND, command};
-    if (write(i2c_fd, buffer, 2) != 2) {
+bool Display::sendCommands(const uint8_t* commands, size_t count) {
+    // One transaction: the command control byte followed by every byte
+    uint8_t buffer[32];
+    if (count + 1 > sizeof(buffer)) {
+        return false;
+    }
+    buffer[0] = SSD1306_COMMAND;
+    memcpy(buffer + 1, commands, count);
+    if (write(i2c_fd, buffer, count + 1) != static_cast<ssize_t>(count + 1)) {
         std::cerr << "Error writing command to display" << std::endl;
+        return false;
     }
+    return true;
+}
+
+void Display::sendCommand(uint8_t command) {
+    sendCommands(&command, 1);
 }
 
-void Display::sendData(uint8_t data) {
-    uint8_t buffer[2] = {SSD1306_DATA, data};
-    if (write(i2c_fd, buffer, 2) != 2) {
+bool Display::sendData(int page, int first_column, int last_column) {
+    const uint8_t window[] = {
+        SSD1306_SETCOLUMNADDR, static_cast<uint8_t>(first_column), static_cast<uint8_t>(last_column),
+        SSD1306_SETPAGEADDR, static_cast<uint8_t>(page), static_cast<uint8_t>(page)
+    };
+    if (!sendCommands(window, sizeof(window))) {
+        return false;
+    }
+    
+    const uint8_t* data = &framebuffer[page * width + first_column];
+    size_t count = static_cast<size_t>(last_column - first_column + 1);
+    transfer.resize(count + 1);
+    transfer[0] = SSD1306_DATA;
+    memcpy(&transfer[1], data, count);
+    if (write(i2c_fd, transfer.data(), transfer.size()) != static_cast<ssize_t>(transfer.size())) {
         std::cerr << "Error writing data to display" << std::endl;
+        return false;
     }
+    return true;
 }
 
 void Display::clear() {
-    // Implementation would clear the display buffer
-    // For brevity, not showing the full implementation
+    std::fill(framebuffer.begin(), framebuffer.end(), 0);
+}
+
+void Display::setFont(FontSize size) {
+    font = &kFonts[size];
 }
 
 void Display::showText(const std::string& text) {
-    std::vector<std::string> lines;
-    wrapText(text, lines);
-    showMultilineText(lines);
+    wrapText(text, wrapped);
+    for (size_t i = 0; i < wrapped.size(); i++) {
+        drawLine(static_cast<int>(i), text.data() + wrapped[i].offset, wrapped[i].length);
+    }
 }
 
-void Display::wrapText(const std::string& text, std::vector<std::string>& lines) {
-    // Simple text wrapping implementation
-    // For a 128x64 display with 5x8 font, we can fit about 21 characters per line
-    // and 8 lines total
-    
-    const int chars_per_line = 21;
-    std::istringstream iss(text);
-    std::string word;
-    std::string current_line;
+// Continuation bytes of a UTF-8 sequence; the lead byte alone takes a cell
+static bool isContinuationByte(char c) {
+    return (static_cast<unsigned char>(c) & 0xC0) == 0x80;
+}
+
+void Display::wrapText(const std::string& text, std::vector<TextSpan>& lines) const {
+    lines.clear();
+    const size_t max_lines = static_cast<size_t>(pages / font->pages);
+    const size_t line_cells = static_cast<size_t>(width / font->cell_width);
     
-    while (iss >> word) {
-        if (current_line.empty()) {
-            current_line = word;
-        } else if (current_line.length() + word.length() + 1 <= chars_per_line) {
-            current_line += " " + word;
-        } else {
-            lines.push_back(current_line);
-            current_line = word;
+    TextSpan line = {0, 0};
+    size_t line_used = 0;     // Cells on the current line, 0 if it has no words yet
+    size_t i = 0;
+    while (i < text.size() && lines.size() < max_lines) {
+        if (std::isspace(static_cast<unsigned char>(text[i]))) {
+            i++;
+            continue;
+        }
+        size_t word = i;
+        size_t cells = 0;
+        for (; i < text.size() && !std::isspace(static_cast<unsigned char>(text[i])); i++) {
+            if (!isContinuationByte(text[i])) {
+                cells++;
+            }
+        }
+        
+        if (line_used > 0 && line_used + 1 + cells <= line_cells) {
+            line.length = i - line.offset;
+            line_used += 1 + cells;
+            continue;
+        }
+        if (line_used > 0) {
+            lines.push_back(line);
+        }
+        
+        // Words longer than a line are broken across lines
+        while (cells > line_cells && lines.size() < max_lines) {
+            size_t end = word;
+            for (size_t taken = 0; taken < line_cells; end++) {
+                if (!isContinuationByte(text[end])) {
+                    taken++;
+                }
+            }
+            while (end < i && isContinuationByte(text[end])) {
+                end++;
+            }
+            lines.push_back({word, end - word});
+            word = end;
+            cells -= line_cells;
         }
+        line = {word, i - word};
+        line_used = cells;
     }
-    
-    if (!current_line.empty()) {
-        lines.push_back(current_line);
+    if (line_used > 0 && lines.size() < max_lines) {
+        lines.push_back(line);
+    }
+}
+
+void Display::drawLine(int line, const char* text, size_t length) {
+    int page = line * font->pages;
+    if (page + font->pages > pages) {
+        return;
     }
     
-    // Limit to 8 lines
-    if (lines.size() > 8) {
-        lines.resize(8);
+    const size_t glyph_bytes = static_cast<size_t>(font->pages * font->cell_width);
+    int x = 0;
+    for (size_t i = 0; i < length && x + font->cell_width <= width; i++) {
+        if (isContinuationByte(text[i])) {
+            continue;
+        }
+        int c = static_cast<unsigned char>(text[i]);
+        int glyph = (c >= kFirstGlyph && c < kFirstGlyph + kGlyphCount) ? c - kFirstGlyph
+                                                                         : '?' - kFirstGlyph;
+        const uint8_t* cell = font->columns + glyph * glyph_bytes;
+        for (int p = 0; p < font->pages; p++) {
+            memcpy(&framebuffer[(page + p) * width + x], cell + p * font->cell_width,
+                   font->cell_width);
+        }
+        x += font->cell_width;
     }
 }
 
 void Display::showMultilineText(const std::vector<std::string>& lines) {
-    // Implementation would render text lines to the display buffer
-    // For brevity, not showing the full implementation
+    for (size_t i = 0; i < lines.size(); i++) {
+        drawLine(static_cast<int>(i), lines[i].data(), lines[i].size());
+    }
 }
 
 void Display::drawProgressBar(float percentage) {
-    // Implementation would draw a progress bar on the display
-    // For brevity, not showing the full implementation
+    // Bottom page: a one-pixel frame with the filled part solid
+    float fraction = std::min(std::max(percentage, 0.0f), 100.0f) / 100.0f;
+    int filled = static_cast<int>(fraction * (width - 2) + 0.5f);
+    uint8_t* row = &framebuffer[(pages - 1) * width];
+    row[0] = 0xFF;
+    row[width - 1] = 0xFF;
+    for (int x = 1; x < width - 1; x++) {
+        row[x] = x <= filled ? 0xFF : 0x81;
+    }
 }
 
 void Display::update() {
-    // Implementation would send the display buffer to the OLED
-    // For brevity, not showing the full implementation
+    bool complete = true;
+    for (int page = 0; page < pages; page++) {
+        const uint8_t* row = &framebuffer[page * width];
+        uint8_t* shown = &shadow[page * width];
+        int x = 0;
+        while (x < width) {
+            if (shadow_valid && row[x] == shown[x]) {
+                x++;
+                continue;
+            }
+            
+            // Grow the run until kMergeGap unchanged columns in a row
+            int first = x;
+            int last = x;
+            int gap = 0;
+            for (x++; x < width; x++) {
+                if (!shadow_valid || row[x] != shown[x]) {
+                    last = x;
+                    gap = 0;
+                } else if (++gap > kMergeGap) {
+                    break;
+                }
+            }
+            
+            // On failure the shadow keeps the old bytes, so the next update
+            // retries them
+            if (sendData(page, first, last)) {
+                memcpy(shown + first, row + first, last - first + 1);
+            } else {
+                complete = false;
+            }
+        }
+    }
+    if (complete) {
+        shadow_valid = true;
+    }
+}
+
+void Display::invalidate() {
+    shadow_valid = false;
 }
 
 void Display::setBrightness(int new_brightness) {
@@ -3,18 +3,39 @@
 
 #include <string>
 #include <vector>
+#include <cstdint>
+#include <cstddef>
 
+// SSD1306 OLED over I2C. Drawing goes into an in-memory framebuffer laid
+// out like the panel's RAM (one byte per 8-pixel column of a page); a
+// shadow copy records what the panel currently shows, so update() only
+// sends the column ranges that changed, each as one block write.
 class Display {
 public:
+    enum FontSize {
+        FONT_SMALL,     // 6x8 cells: 21 x 8 characters on a 128x64 panel
+        FONT_LARGE      // 12x16 cells: 10 x 4 characters
+    };
+    
+    struct Font;
+    
     Display(int width, int height);
     ~Display();
     
+    // Drawing only touches the framebuffer; update() makes it visible
     void clear();
+    // Text is word-wrapped into as many lines as fit; rendering allocates
+    // nothing. Characters outside printable ASCII show as '?'.
     void showText(const std::string& text);
     void showMultilineText(const std::vector<std::string>& lines);
-    void drawProgressBar(float percentage);
+    void drawProgressBar(float percentage);   // 0..100, on the bottom 8 rows
+    void setFont(FontSize size);
     void update();
     
+    // Resend the whole framebuffer on the next update(), e.g. after the
+    // panel lost power
+    void invalidate();
+    
     void setBrightness(int brightness);
     void setInvertDisplay(bool invert);
     
@@ -24,12 +45,28 @@ private:
     int brightness;
     bool is_inverted;
     int i2c_fd;
+    const Font* font;
+    
+    int pages;                          // Rows of 8 pixels
+    std::vector<uint8_t> framebuffer;   // pages x width, bit n of a byte is row 8 * page + n
+    std::vector<uint8_t> shadow;        // What the panel is showing
+    bool shadow_valid;
+    std::vector<uint8_t> transfer;      // Control byte plus one block of data
+    
+    // A wrapped line, as a byte range of the text being shown
+    struct TextSpan {
+        size_t offset;
+        size_t length;
+    };
+    std::vector<TextSpan> wrapped;      // Reserved for the most lines that fit
     
     bool initializeI2C();
     void closeI2C();
+    bool sendCommands(const uint8_t* commands, size_t count);
     void sendCommand(uint8_t command);
-    void sendData(uint8_t data);
-    void wrapText(const std::string& text, std::vector<std::string>& lines);
+    bool sendData(int page, int first_column, int last_column);
+    void wrapText(const std::string& text, std::vector<TextSpan>& lines) const;
+    void drawLine(int line, const char* text, size_t length);
 };
 
 #endif // DISPLAY_H 
\ No newline at end of file
@@ -0,0 +1,325 @@
+#include "dsp_kernels.h"
+#include <cmath>
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define DSP_USE_NEON 1
+#elif defined(__AVX2__)
+#include <immintrin.h>
+#define DSP_USE_AVX2 1
+#elif defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define DSP_USE_SSE2 1
+#endif
+
+static const float kS16Scale = 1.0f / 32768.0f;
+
+// Scalar versions; also used for the tails the vector loops leave behind
+
+static inline float clampS16(float value) {
+    if (value > 32767.0f) value = 32767.0f;
+    if (value < -32768.0f) value = -32768.0f;
+    return value;
+}
+
+static void applyGainScalar(const int16_t* src, int16_t* dst, size_t count, float gain) {
+    for (size_t i = 0; i < count; i++) {
+        dst[i] = static_cast<int16_t>(clampS16(src[i] * gain));
+    }
+}
+
+static void convertS16ToF32Scalar(const int16_t* src, float* dst, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        dst[i] = src[i] * kS16Scale;
+    }
+}
+
+static void gainConvertScalar(const int16_t* src, float* dst, size_t count, float gain) {
+    for (size_t i = 0; i < count; i++) {
+        dst[i] = static_cast<float>(static_cast<int16_t>(clampS16(src[i] * gain))) * kS16Scale;
+    }
+}
+
+static float dotProductScalar(const float* a, const float* b, size_t count) {
+    float sum = 0.0f;
+    for (size_t i = 0; i < count; i++) {
+        sum += a[i] * b[i];
+    }
+    return sum;
+}
+
+static void convertF32ToS16Scalar(const float* src, int16_t* dst, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        dst[i] = static_cast<int16_t>(std::lrint(clampS16(src[i] * 32768.0f)));
+    }
+}
+
+#if DSP_USE_NEON
+
+static inline float32x4_t clampS16(float32x4_t v) {
+    return vmaxq_f32(vminq_f32(v, vdupq_n_f32(32767.0f)), vdupq_n_f32(-32768.0f));
+}
+
+static inline int32x4_t roundToInt(float32x4_t v) {
+#if defined(__aarch64__)
+    return vcvtnq_s32_f32(v);
+#else
+    // ARMv7 NEON only truncates; bias away from zero first
+    uint32x4_t sign = vandq_u32(vreinterpretq_u32_f32(v), vdupq_n_u32(0x80000000u));
+    float32x4_t half = vreinterpretq_f32_u32(vorrq_u32(vreinterpretq_u32_f32(vdupq_n_f32(0.5f)), sign));
+    return vcvtq_s32_f32(vaddq_f32(v, half));
+#endif
+}
+
+void applyGainS16(const int16_t* src, int16_t* dst, size_t count, float gain) {
+    const float32x4_t g = vdupq_n_f32(gain);
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        int16x8_t s = vld1q_s16(src + i);
+        float32x4_t lo = vcvtq_f32_s32(vmovl_s16(vget_low_s16(s)));
+        float32x4_t hi = vcvtq_f32_s32(vmovl_s16(vget_high_s16(s)));
+        int32x4_t lo_i = vcvtq_s32_f32(clampS16(vmulq_f32(lo, g)));
+        int32x4_t hi_i = vcvtq_s32_f32(clampS16(vmulq_f32(hi, g)));
+        vst1q_s16(dst + i, vcombine_s16(vqmovn_s32(lo_i), vqmovn_s32(hi_i)));
+    }
+    applyGainScalar(src + i, dst + i, count - i, gain);
+}
+
+void convertS16ToF32(const int16_t* src, float* dst, size_t count) {
+    const float32x4_t scale = vdupq_n_f32(kS16Scale);
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        int16x8_t s = vld1q_s16(src + i);
+        vst1q_f32(dst + i, vmulq_f32(vcvtq_f32_s32(vmovl_s16(vget_low_s16(s))), scale));
+        vst1q_f32(dst + i + 4, vmulq_f32(vcvtq_f32_s32(vmovl_s16(vget_high_s16(s))), scale));
+    }
+    convertS16ToF32Scalar(src + i, dst + i, count - i);
+}
+
+void gainConvertS16ToF32(const int16_t* src, float* dst, size_t count, float gain) {
+    const float32x4_t g = vdupq_n_f32(gain);
+    const float32x4_t scale = vdupq_n_f32(kS16Scale);
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        int16x8_t s = vld1q_s16(src + i);
+        float32x4_t lo = clampS16(vmulq_f32(vcvtq_f32_s32(vmovl_s16(vget_low_s16(s))), g));
+        float32x4_t hi = clampS16(vmulq_f32(vcvtq_f32_s32(vmovl_s16(vget_high_s16(s))), g));
+        // Round-trip through int to keep the truncation of the int16 path
+        vst1q_f32(dst + i, vmulq_f32(vcvtq_f32_s32(vcvtq_s32_f32(lo)), scale));
+        vst1q_f32(dst + i + 4, vmulq_f32(vcvtq_f32_s32(vcvtq_s32_f32(hi)), scale));
+    }
+    gainConvertScalar(src + i, dst + i, count - i, gain);
+}
+
+void convertF32ToS16(const float* src, int16_t* dst, size_t count) {
+    const float32x4_t scale = vdupq_n_f32(32768.0f);
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        int32x4_t lo = roundToInt(clampS16(vmulq_f32(vld1q_f32(src + i), scale)));
+        int32x4_t hi = roundToInt(clampS16(vmulq_f32(vld1q_f32(src + i + 4), scale)));
+        vst1q_s16(dst + i, vcombine_s16(vqmovn_s32(lo), vqmovn_s32(hi)));
+    }
+    convertF32ToS16Scalar(src + i, dst + i, count - i);
+}
+
+float dotProductF32(const float* a, const float* b, size_t count) {
+    float32x4_t acc0 = vdupq_n_f32(0.0f);
+    float32x4_t acc1 = vdupq_n_f32(0.0f);
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        acc0 = vmlaq_f32(acc0, vld1q_f32(a + i), vld1q_f32(b + i));
+        acc1 = vmlaq_f32(acc1, vld1q_f32(a + i + 4), vld1q_f32(b + i + 4));
+    }
+    float32x4_t acc = vaddq_f32(acc0, acc1);
+    float32x2_t pair = vadd_f32(vget_low_f32(acc), vget_high_f32(acc));
+    return vget_lane_f32(vpadd_f32(pair, pair), 0) + dotProductScalar(a + i, b + i, count - i);
+}
+
+const char* dspKernelBackend() {
+    return "NEON";
+}
+
+#elif DSP_USE_AVX2
+
+static inline __m256 clampS16(__m256 v) {
+    return _mm256_max_ps(_mm256_min_ps(v, _mm256_set1_ps(32767.0f)), _mm256_set1_ps(-32768.0f));
+}
+
+static inline __m256 loadS16AsF32(const int16_t* src) {
+    __m128i s = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src));
+    return _mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(s));
+}
+
+static inline void storeS32AsS16(int16_t* dst, __m256i v) {
+    __m128i packed = _mm_packs_epi32(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst), packed);
+}
+
+void applyGainS16(const int16_t* src, int16_t* dst, size_t count, float gain) {
+    const __m256 g = _mm256_set1_ps(gain);
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256 v = clampS16(_mm256_mul_ps(loadS16AsF32(src + i), g));
+        storeS32AsS16(dst + i, _mm256_cvttps_epi32(v));
+    }
+    applyGainScalar(src + i, dst + i, count - i, gain);
+}
+
+void convertS16ToF32(const int16_t* src, float* dst, size_t count) {
+    const __m256 scale = _mm256_set1_ps(kS16Scale);
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        _mm256_storeu_ps(dst + i, _mm256_mul_ps(loadS16AsF32(src + i), scale));
+    }
+    convertS16ToF32Scalar(src + i, dst + i, count - i);
+}
+
+void gainConvertS16ToF32(const int16_t* src, float* dst, size_t count, float gain) {
+    const __m256 g = _mm256_set1_ps(gain);
+    const __m256 scale = _mm256_set1_ps(kS16Scale);
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256 v = clampS16(_mm256_mul_ps(loadS16AsF32(src + i), g));
+        // Round-trip through int to keep the truncation of the int16 path
+        v = _mm256_cvtepi32_ps(_mm256_cvttps_epi32(v));
+        _mm256_storeu_ps(dst + i, _mm256_mul_ps(v, scale));
+    }
+    gainConvertScalar(src + i, dst + i, count - i, gain);
+}
+
+void convertF32ToS16(const float* src, int16_t* dst, size_t count) {
+    const __m256 scale = _mm256_set1_ps(32768.0f);
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256 v = clampS16(_mm256_mul_ps(_mm256_loadu_ps(src + i), scale));
+        storeS32AsS16(dst + i, _mm256_cvtps_epi32(v));
+    }
+    convertF32ToS16Scalar(src + i, dst + i, count - i);
+}
+
+float dotProductF32(const float* a, const float* b, size_t count) {
+    __m256 acc0 = _mm256_setzero_ps();
+    __m256 acc1 = _mm256_setzero_ps();
+    size_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+        acc0 = _mm256_add_ps(acc0, _mm256_mul_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i)));
+        acc1 = _mm256_add_ps(acc1, _mm256_mul_ps(_mm256_loadu_ps(a + i + 8), _mm256_loadu_ps(b + i + 8)));
+    }
+    for (; i + 8 <= count; i += 8) {
+        acc0 = _mm256_add_ps(acc0, _mm256_mul_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i)));
+    }
+    __m256 acc = _mm256_add_ps(acc0, acc1);
+    __m128 sum = _mm_add_ps(_mm256_castps256_ps128(acc), _mm256_extractf128_ps(acc, 1));
+    sum = _mm_add_ps(sum, _mm_movehl_ps(sum, sum));
+    sum = _mm_add_ss(sum, _mm_shuffle_ps(sum, sum, 1));
+    return _mm_cvtss_f32(sum) + dotProductScalar(a + i, b + i, count - i);
+}
+
+const char* dspKernelBackend() {
+    return "AVX2";
+}
+
+#elif DSP_USE_SSE2
+
+static inline __m128 clampS16(__m128 v) {
+    return _mm_max_ps(_mm_min_ps(v, _mm_set1_ps(32767.0f)), _mm_set1_ps(-32768.0f));
+}
+
+// SSE2 has no sign-extending load, so duplicate each lane and shift it down
+static inline void loadS16AsF32(const int16_t* src, __m128& lo, __m128& hi) {
+    __m128i s = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src));
+    lo = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(s, s), 16));
+    hi = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpackhi_epi16(s, s), 16));
+}
+
+void applyGainS16(const int16_t* src, int16_t* dst, size_t count, float gain) {
+    const __m128 g = _mm_set1_ps(gain);
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m128 lo, hi;
+        loadS16AsF32(src + i, lo, hi);
+        __m128i lo_i = _mm_cvttps_epi32(clampS16(_mm_mul_ps(lo, g)));
+        __m128i hi_i = _mm_cvttps_epi32(clampS16(_mm_mul_ps(hi, g)));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_packs_epi32(lo_i, hi_i));
+    }
+    applyGainScalar(src + i, dst + i, count - i, gain);
+}
+
+// The compiler vectorizes the plain loop better than the unpack-and-shift
+// widening above, which loses to it on this one
+void convertS16ToF32(const int16_t* src, float* dst, size_t count) {
+    convertS16ToF32Scalar(src, dst, count);
+}
+
+void gainConvertS16ToF32(const int16_t* src, float* dst, size_t count, float gain) {
+    const __m128 g = _mm_set1_ps(gain);
+    const __m128 scale = _mm_set1_ps(kS16Scale);
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m128 lo, hi;
+        loadS16AsF32(src + i, lo, hi);
+        // Round-trip through int to keep the truncation of the int16 path
+        lo = _mm_cvtepi32_ps(_mm_cvttps_epi32(clampS16(_mm_mul_ps(lo, g))));
+        hi = _mm_cvtepi32_ps(_mm_cvttps_epi32(clampS16(_mm_mul_ps(hi, g))));
+        _mm_storeu_ps(dst + i, _mm_mul_ps(lo, scale));
+        _mm_storeu_ps(dst + i + 4, _mm_mul_ps(hi, scale));
+    }
+    gainConvertScalar(src + i, dst + i, count - i, gain);
+}
+
+void convertF32ToS16(const float* src, int16_t* dst, size_t count) {
+    const __m128 scale = _mm_set1_ps(32768.0f);
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m128i lo = _mm_cvtps_epi32(clampS16(_mm_mul_ps(_mm_loadu_ps(src + i), scale)));
+        __m128i hi = _mm_cvtps_epi32(clampS16(_mm_mul_ps(_mm_loadu_ps(src + i + 4), scale)));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_packs_epi32(lo, hi));
+    }
+    convertF32ToS16Scalar(src + i, dst + i, count - i);
+}
+
+float dotProductF32(const float* a, const float* b, size_t count) {
+    __m128 acc0 = _mm_setzero_ps();
+    __m128 acc1 = _mm_setzero_ps();
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        acc0 = _mm_add_ps(acc0, _mm_mul_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i)));
+        acc1 = _mm_add_ps(acc1, _mm_mul_ps(_mm_loadu_ps(a + i + 4), _mm_loadu_ps(b + i + 4)));
+    }
+    __m128 sum = _mm_add_ps(acc0, acc1);
+    sum = _mm_add_ps(sum, _mm_movehl_ps(sum, sum));
+    sum = _mm_add_ss(sum, _mm_shuffle_ps(sum, sum, 1));
+    return _mm_cvtss_f32(sum) + dotProductScalar(a + i, b + i, count - i);
+}
+
+const char* dspKernelBackend() {
+    return "SSE2";
+}
+
+#else
+
+void applyGainS16(const int16_t* src, int16_t* dst, size_t count, float gain) {
+    applyGainScalar(src, dst, count, gain);
+}
+
+void convertS16ToF32(const int16_t* src, float* dst, size_t count) {
+    convertS16ToF32Scalar(src, dst, count);
+}
+
+void gainConvertS16ToF32(const int16_t* src, float* dst, size_t count, float gain) {
+    gainConvertScalar(src, dst, count, gain);
+}
+
+void convertF32ToS16(const float* src, int16_t* dst, size_t count) {
+    convertF32ToS16Scalar(src, dst, count);
+}
+
+float dotProductF32(const float* a, const float* b, size_t count) {
+    return dotProductScalar(a, b, count);
+}
+
+const char* dspKernelBackend() {
+    return "scalar";
+}
+
+#endif
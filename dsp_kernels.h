@@ -0,0 +1,32 @@
+#ifndef DSP_KERNELS_H
+#define DSP_KERNELS_H
+
+#include <cstdint>
+#include <cstddef>
+
+// Vectorized sample kernels shared by capture, noise reduction and the STT
+// front end. The instruction set is picked at compile time: NEON, AVX2 or
+// SSE2, with a scalar fallback. Under SSE2, convertS16ToF32 is the plain
+// loop, which the compiler vectorizes well. x86 builds get the AVX2 path only
+// when configured with -DVOCATALK_AVX2=ON. applyGainS16 accepts src == dst.
+
+// dst = saturate_int16(src * gain), truncating toward zero like a C cast
+void applyGainS16(const int16_t* src, int16_t* dst, size_t count, float gain);
+
+// dst = src / 32768
+void convertS16ToF32(const int16_t* src, float* dst, size_t count);
+
+// dst = saturate_int16(src * gain) / 32768 in a single pass, so applying
+// gain and converting for Whisper touches each sample once
+void gainConvertS16ToF32(const int16_t* src, float* dst, size_t count, float gain);
+
+// dst = saturate_int16(round(src * 32768))
+void convertF32ToS16(const float* src, int16_t* dst, size_t count);
+
+// Sum of a[i] * b[i], the inner loop of the FIR filters
+float dotProductF32(const float* a, const float* b, size_t count);
+
+// Name of the instruction set the kernels were compiled for
+const char* dspKernelBackend();
+
+#endif // DSP_KERNELS_H
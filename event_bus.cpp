@@ -0,0 +1,107 @@
+#include "event_bus.h"
+#include <chrono>
+
+static int64_t monotonicMicros() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+EventBus::Subscriber::Subscriber(uint32_t mask, size_t capacity)
+    : mask(mask), capacity(capacity > 0 ? capacity : 1), dropped(0), shut_down(false) {
+}
+
+void EventBus::Subscriber::deliver(const Event& event) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (mailbox.size() >= capacity) {
+            mailbox.pop_front();
+            dropped++;
+        }
+        mailbox.push_back(event);
+    }
+    ready.notify_one();
+}
+
+void EventBus::Subscriber::close() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        shut_down = true;
+    }
+    ready.notify_all();
+}
+
+bool EventBus::Subscriber::wait(Event& event, int timeout_ms) {
+    std::unique_lock<std::mutex> lock(mutex);
+    auto has_work = [this] { return !mailbox.empty() || shut_down; };
+    if (timeout_ms < 0) {
+        ready.wait(lock, has_work);
+    } else if (!ready.wait_for(lock, std::chrono::milliseconds(timeout_ms), has_work)) {
+        return false;
+    }
+
+    if (mailbox.empty()) {
+        return false;
+    }
+    event = std::move(mailbox.front());
+    mailbox.pop_front();
+    return true;
+}
+
+bool EventBus::Subscriber::poll(Event& event) {
+    return wait(event, 0);
+}
+
+bool EventBus::Subscriber::closed() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return shut_down && mailbox.empty();
+}
+
+uint64_t EventBus::Subscriber::getDroppedCount() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return dropped;
+}
+
+EventBus::EventBus() : shut_down(false) {
+}
+
+EventBus::Subscriber& EventBus::subscribe(std::initializer_list<Event::Type> types,
+                                          size_t capacity) {
+    uint32_t mask = 0;
+    for (Event::Type type : types) {
+        mask |= 1u << type;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    subscribers.push_back(std::unique_ptr<Subscriber>(new Subscriber(mask, capacity)));
+    if (shut_down) {
+        subscribers.back()->close();
+    }
+    return *subscribers.back();
+}
+
+void EventBus::publish(Event event) {
+    event.timestampUs = monotonicMicros();
+
+    std::lock_guard<std::mutex> lock(mutex);
+    if (shut_down) {
+        return;
+    }
+    for (const std::unique_ptr<Subscriber>& subscriber : subscribers) {
+        if (subscriber->mask & (1u << event.type)) {
+            subscriber->deliver(event);
+        }
+    }
+}
+
+void EventBus::shutdown() {
+    std::lock_guard<std::mutex> lock(mutex);
+    shut_down = true;
+    for (const std::unique_ptr<Subscriber>& subscriber : subscribers) {
+        subscriber->close();
+    }
+}
+
+bool EventBus::isShutdown() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return shut_down;
+}
@@ -0,0 +1,82 @@
+#ifndef EVENT_BUS_H
+#define EVENT_BUS_H
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <initializer_list>
+#include <cstdint>
+
+struct Event {
+    enum Type {
+        TRANSCRIPTION_UPDATED,   // Text on screen changed (committed + partial)
+        SEGMENT_FINISHED,        // An utterance is final and in the history
+        KEYWORD_DETECTED,        // text is the keyword that matched
+        BATTERY_CHANGED,
+        POWER_MODE_CHANGED,
+        EVENT_TYPE_COUNT
+    };
+
+    Type type = TRANSCRIPTION_UPDATED;
+    std::string text;
+    float battery_level = 0.0f;
+    bool low_power = false;
+    uint64_t sequence = 0;       // History sequence for SEGMENT_FINISHED
+    int64_t timestampUs = 0;     // Monotonic time of publication
+};
+
+// Small publish/subscribe bus so threads sleep until something they care
+// about happens instead of polling shared state. Each subscriber has its own
+// bounded mailbox and condition variable; publishing only wakes subscribers
+// whose mask includes the event type.
+class EventBus {
+public:
+    class Subscriber {
+    public:
+        // Waits for the next event. Returns false on timeout, or once the bus
+        // has shut down and the mailbox is empty. A negative timeout waits
+        // until an event or shutdown.
+        bool wait(Event& event, int timeout_ms = -1);
+        bool poll(Event& event);
+
+        bool closed() const;
+        uint64_t getDroppedCount() const;
+
+    private:
+        friend class EventBus;
+        Subscriber(uint32_t mask, size_t capacity);
+
+        const uint32_t mask;
+        const size_t capacity;
+        mutable std::mutex mutex;
+        std::condition_variable ready;
+        std::deque<Event> mailbox;
+        uint64_t dropped;
+        bool shut_down;
+
+        void deliver(const Event& event);
+        void close();
+    };
+
+    EventBus();
+
+    // Subscribe before the publishing threads start. When a mailbox is full
+    // the oldest event in it is dropped.
+    Subscriber& subscribe(std::initializer_list<Event::Type> types, size_t capacity = 64);
+
+    void publish(Event event);
+
+    // Wakes every subscriber; waits return false once mailboxes drain
+    void shutdown();
+    bool isShutdown() const;
+
+private:
+    mutable std::mutex mutex;
+    std::vector<std::unique_ptr<Subscriber>> subscribers;
+    bool shut_down;
+};
+
+#endif // EVENT_BUS_H
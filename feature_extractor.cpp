@@ -0,0 +1,212 @@
+#include "feature_extractor.h"
+#include <iostream>
+#include <stdexcept>
+#include <algorithm>
+#include <cstring>
+#include <cmath>
+
+static const int kFrameMs = 25;
+static const int kHopMs = 10;
+static const float kMaxMelHz = 8000.0f;
+
+// Chunk positions may wobble by a sample where the resampler rounds; only
+// larger jumps (lost audio) restart the framing
+static const int64_t kPositionSlack = 4;
+
+// Slaney's mel scale: linear below 1 kHz, logarithmic above
+static double melFromHz(double hz) {
+    const double log_step = std::log(6.4) / 27.0;
+    return hz < 1000.0 ? hz * 3.0 / 200.0 : 15.0 + std::log(hz / 1000.0) / log_step;
+}
+
+static double hzFromMel(double mel) {
+    const double log_step = std::log(6.4) / 27.0;
+    return mel < 15.0 ? mel * 200.0 / 3.0 : 1000.0 * std::exp(log_step * (mel - 15.0));
+}
+
+static int fftSizeFor(int frame_length) {
+    int size = 64;
+    while (size < frame_length) {
+        size <<= 1;
+    }
+    return size;
+}
+
+FeatureExtractor::FeatureExtractor(int sample_rate, int mel_bands, size_t mel_history_frames)
+    : sample_rate(sample_rate), frame_length(sample_rate * kFrameMs / 1000),
+      hop_length(sample_rate * kHopMs / 1000), mel_bands(mel_bands),
+      fft(fftSizeFor(sample_rate * kFrameMs / 1000)),
+      pending_fill(0), origin(0), next_position(0), frame_count(0), started(false),
+      history_frames(mel_history_frames), history_origin(0), history_count(0) {
+    if (sample_rate < 8000 || mel_bands < 8 || mel_bands > 256) {
+        throw std::invalid_argument("Invalid feature extractor configuration");
+    }
+
+    // Periodic Hann, as Whisper uses
+    const double pi = 3.14159265358979323846;
+    window.resize(frame_length);
+    for (int i = 0; i < frame_length; i++) {
+        window[i] = static_cast<float>(0.5 - 0.5 * std::cos(2.0 * pi * i / frame_length));
+    }
+    frame.assign(fft.size(), 0.0f);
+    spectrum.assign(fft.bins(), std::complex<float>(0.0f, 0.0f));
+    pending.assign(frame_length, 0.0f);
+
+    // Triangles between mel_bands + 2 points evenly spaced on the mel scale,
+    // each normalized to unit area in Hz. The zero-padded FFT has
+    // fft_size / frame_length times as many bins under each triangle as the
+    // frame-length DFT Whisper uses, hence the extra scale.
+    double max_hz = std::min<double>(kMaxMelHz, sample_rate / 2.0);
+    double max_mel = melFromHz(max_hz);
+    std::vector<double> edges(mel_bands + 2);
+    for (int m = 0; m < mel_bands + 2; m++) {
+        edges[m] = hzFromMel(max_mel * m / (mel_bands + 1));
+    }
+    double bin_hz = static_cast<double>(sample_rate) / fft.size();
+    double padding_scale = static_cast<double>(frame_length) / fft.size();
+    mel_filters.resize(mel_bands);
+    mel_first_bin.assign(mel_bands, 0);
+    for (int m = 0; m < mel_bands; m++) {
+        double area = 2.0 / (edges[m + 2] - edges[m]);
+        int first = static_cast<int>(std::ceil(edges[m] / bin_hz));
+        int last = std::min(static_cast<int>(std::floor(edges[m + 2] / bin_hz)), fft.bins() - 1);
+        mel_first_bin[m] = first;
+        for (int bin = first; bin <= last; bin++) {
+            double hz = bin * bin_hz;
+            double weight = hz <= edges[m + 1]
+                                ? (hz - edges[m]) / (edges[m + 1] - edges[m])
+                                : (edges[m + 2] - hz) / (edges[m + 2] - edges[m + 1]);
+            mel_filters[m].push_back(static_cast<float>(std::max(weight, 0.0) * area * padding_scale));
+        }
+    }
+
+    history.assign(history_frames * mel_bands, 0.0f);
+}
+
+void FeatureExtractor::reset() {
+    started = false;
+    pending_fill = 0;
+    frame_count = 0;
+    batch.clear();
+    std::lock_guard<std::mutex> lock(history_mutex);
+    history_count = 0;
+}
+
+void FeatureExtractor::restart(uint64_t position) {
+    pending_fill = 0;
+    frame_count = 0;
+    origin = position;
+    next_position = position;
+    started = true;
+    std::lock_guard<std::mutex> lock(history_mutex);
+    history_origin = origin;
+    history_count = 0;
+}
+
+void FeatureExtractor::analyse(float* power_out, float* mel_out, float& energy) {
+    energy = 0.0f;
+    for (int i = 0; i < frame_length; i++) {
+        energy += pending[i] * pending[i];
+        frame[i] = pending[i] * window[i];
+    }
+    energy /= frame_length;
+
+    fft.forward(frame.data(), spectrum.data());
+    for (int bin = 0; bin < fft.bins(); bin++) {
+        power_out[bin] = std::norm(spectrum[bin]);
+    }
+    for (int m = 0; m < mel_bands; m++) {
+        const std::vector<float>& weights = mel_filters[m];
+        const float* power = power_out + mel_first_bin[m];
+        float sum = 0.0f;
+        for (size_t j = 0; j < weights.size(); j++) {
+            sum += weights[j] * power[j];
+        }
+        mel_out[m] = std::log10(std::max(sum, 1e-10f));
+    }
+}
+
+const std::vector<FeatureExtractor::Frame>& FeatureExtractor::process(const AudioBuffer& chunk) {
+    batch.clear();
+    if (!chunk.valid() || chunk.empty()) {
+        return batch;
+    }
+    if (chunk.channels != 1 || chunk.sampleRate != static_cast<size_t>(sample_rate)) {
+        std::cerr << "Feature extraction expects " << sample_rate << " Hz mono audio" << std::endl;
+        return batch;
+    }
+
+    int64_t jump = static_cast<int64_t>(chunk.startFrame - next_position);
+    if (!started || chunk.discontinuity || jump > kPositionSlack || jump < -kPositionSlack) {
+        restart(chunk.startFrame);
+    }
+    next_position += chunk.size();
+
+    // Sized up front so the rows don't move while frames point into them
+    size_t most = (pending_fill + chunk.size()) / hop_length + 1;
+    if (batch_power.size() < most * fft.bins()) {
+        batch_power.resize(most * fft.bins());
+        batch_mel.resize(most * mel_bands);
+    }
+
+    const int16_t* samples = chunk.data();
+    for (size_t i = 0; i < chunk.size(); i++) {
+        pending[pending_fill++] = samples[i] * (1.0f / 32768.0f);
+        if (pending_fill < frame_length) {
+            continue;
+        }
+
+        size_t n = batch.size();
+        Frame out;
+        out.index = frame_count;
+        out.startSample = origin + frame_count * hop_length;
+        out.chunkEnd = i + 1;
+        out.endUs = chunk.timestampUs + static_cast<int64_t>(i + 1) * 1000000 / sample_rate;
+        out.power = &batch_power[n * fft.bins()];
+        out.logMel = &batch_mel[n * mel_bands];
+        analyse(&batch_power[n * fft.bins()], &batch_mel[n * mel_bands], out.energy);
+        batch.push_back(out);
+        frame_count++;
+
+        std::memmove(pending.data(), pending.data() + hop_length,
+                     (frame_length - hop_length) * sizeof(float));
+        pending_fill -= hop_length;
+    }
+
+    if (history_frames > 0 && !batch.empty()) {
+        std::lock_guard<std::mutex> lock(history_mutex);
+        for (const Frame& out : batch) {
+            std::copy(out.logMel, out.logMel + mel_bands,
+                      &history[(out.index % history_frames) * mel_bands]);
+        }
+        history_count = frame_count;
+    }
+    return batch;
+}
+
+int FeatureExtractor::copyMel(uint64_t first_center, int count, float* out, int stride) const {
+    std::lock_guard<std::mutex> lock(history_mutex);
+    if (history_frames == 0 || history_count == 0 || count <= 0) {
+        return 0;
+    }
+
+    // Nearest analysed frame to the requested centre
+    int64_t offset = static_cast<int64_t>(first_center - history_origin) - frame_length / 2;
+    if (offset < -hop_length / 2) {
+        return 0;
+    }
+    uint64_t first = static_cast<uint64_t>((offset + hop_length / 2) / hop_length);
+    uint64_t oldest = history_count > history_frames ? history_count - history_frames : 0;
+    if (first < oldest || first >= history_count) {
+        return 0;
+    }
+
+    int copied = static_cast<int>(std::min<uint64_t>(count, history_count - first));
+    for (int t = 0; t < copied; t++) {
+        const float* row = &history[((first + t) % history_frames) * mel_bands];
+        for (int j = 0; j < mel_bands; j++) {
+            out[j * stride + t] = row[j];
+        }
+    }
+    return copied;
+}
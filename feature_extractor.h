@@ -0,0 +1,94 @@
+#ifndef FEATURE_EXTRACTOR_H
+#define FEATURE_EXTRACTOR_H
+
+#include <vector>
+#include <complex>
+#include <cstdint>
+#include <mutex>
+#include "audio_buffer.h"
+#include "fft.h"
+
+// Streaming STFT and log-mel analysis of the cleaned capture stream, shared
+// by every stage that needs spectral features so each frame is transformed
+// once. Framing follows Whisper: 25 ms periodic-Hann frames every 10 ms
+// (400 / 160 samples at 16 kHz), log10 power through a Slaney-normalized mel
+// filterbank up to 8 kHz. The frame is zero-padded to a power-of-two FFT;
+// filter weights are scaled so mel energies match Whisper's 400-point DFT.
+//
+// process() runs on the audio thread and returns the frames the chunk
+// completed; consumers on the same thread read them until the next call.
+// When a mel history is configured, recent log-mel frames can also be
+// copied out from other threads (e.g. to hand Whisper precomputed mel).
+class FeatureExtractor {
+public:
+    struct Frame {
+        uint64_t index;         // Frames since the stream (re)started
+        uint64_t startSample;   // Stream position (AudioBuffer::startFrame) of the first sample
+        size_t chunkEnd;        // Offset just past the frame's last sample in the current chunk
+        int64_t endUs;          // Capture time just past the last sample
+        float energy;           // Mean square of the unwindowed samples
+        const float* power;     // getBins() values of |X|^2
+        const float* logMel;    // getMelBands() values of log10 mel power
+    };
+
+    // Keeps the last `mel_history_frames` log-mel frames for copyMel()
+    FeatureExtractor(int sample_rate = 16000, int mel_bands = 80, size_t mel_history_frames = 0);
+
+    // Analyses the next chunk (mono, at the constructor's rate). A jump in
+    // the chunk's stream position restarts the framing and clears the mel
+    // history.
+    const std::vector<Frame>& process(const AudioBuffer& chunk);
+    const std::vector<Frame>& frames() const { return batch; }
+    void reset();
+
+    // Copies up to `count` log-mel frames, the first centred on stream
+    // position `first_center` and then one per hop, mel-major: band j of
+    // frame t goes to out[j * stride + t]. Returns the frames copied; fewer
+    // than `count` when the newest ones are not analysed yet, 0 when the
+    // first is no longer (or not yet) in the history.
+    int copyMel(uint64_t first_center, int count, float* out, int stride) const;
+
+    int getSampleRate() const { return sample_rate; }
+    int getFrameLength() const { return frame_length; }
+    int getHopLength() const { return hop_length; }
+    int getFftSize() const { return fft.size(); }
+    int getBins() const { return fft.bins(); }
+    int getMelBands() const { return mel_bands; }
+
+private:
+    int sample_rate;
+    int frame_length;
+    int hop_length;
+    int mel_bands;
+
+    FFTPlan fft;
+    std::vector<float> window;
+    std::vector<float> frame;
+    std::vector<std::complex<float>> spectrum;
+    std::vector<std::vector<float>> mel_filters;   // Per band, weights from mel_first_bin
+    std::vector<int> mel_first_bin;
+
+    std::vector<float> pending;        // Last frame_length samples, oldest first
+    int pending_fill;
+    uint64_t origin;                   // Stream position of frame 0's first sample
+    uint64_t next_position;            // Expected startFrame of the next chunk
+    uint64_t frame_count;
+    bool started;
+
+    // Per-chunk output, reused; power and mel rows are frames x bins/bands
+    std::vector<Frame> batch;
+    std::vector<float> batch_power;
+    std::vector<float> batch_mel;
+
+    // Mel history ring, frame f in row f % history_frames
+    mutable std::mutex history_mutex;
+    std::vector<float> history;
+    size_t history_frames;
+    uint64_t history_origin;           // Copies of origin/frame_count for readers
+    uint64_t history_count;
+
+    void restart(uint64_t position);
+    void analyse(float* power_out, float* mel_out, float& energy);
+};
+
+#endif // FEATURE_EXTRACTOR_H
@@ -0,0 +1,101 @@
+#include "fft.h"
+#include <cmath>
+#include <stdexcept>
+#include <utility>
+
+FFTPlan::FFTPlan(int size) : n(size), half(size / 2) {
+    if (size < 4 || (size & (size - 1)) != 0) {
+        throw std::invalid_argument("FFT size must be a power of two >= 4");
+    }
+
+    const double pi = 3.14159265358979323846;
+
+    twiddles.resize(half / 2);
+    for (int k = 0; k < half / 2; k++) {
+        double angle = -2.0 * pi * k / half;
+        twiddles[k] = std::complex<float>(std::cos(angle), std::sin(angle));
+    }
+
+    real_twiddles.resize(half + 1);
+    for (int k = 0; k <= half; k++) {
+        double angle = -2.0 * pi * k / n;
+        real_twiddles[k] = std::complex<float>(std::cos(angle), std::sin(angle));
+    }
+
+    int bits = 0;
+    while ((1 << bits) < half) {
+        bits++;
+    }
+    bit_reverse.resize(half);
+    for (int i = 0; i < half; i++) {
+        int reversed = 0;
+        for (int b = 0; b < bits; b++) {
+            if (i & (1 << b)) {
+                reversed |= 1 << (bits - 1 - b);
+            }
+        }
+        bit_reverse[i] = reversed;
+    }
+
+    work.resize(half);
+}
+
+// In-place iterative radix-2 complex FFT of size `half`
+void FFTPlan::transform(std::complex<float>* data, bool inverse_direction) {
+    for (int i = 0; i < half; i++) {
+        int j = bit_reverse[i];
+        if (i < j) {
+            std::swap(data[i], data[j]);
+        }
+    }
+
+    for (int length = 2; length <= half; length <<= 1) {
+        int step = half / length;
+        int span = length / 2;
+        for (int start = 0; start < half; start += length) {
+            for (int k = 0; k < span; k++) {
+                std::complex<float> w = twiddles[k * step];
+                if (inverse_direction) {
+                    w = std::conj(w);
+                }
+                std::complex<float> odd = w * data[start + k + span];
+                data[start + k + span] = data[start + k] - odd;
+                data[start + k] += odd;
+            }
+        }
+    }
+}
+
+void FFTPlan::forward(const float* input, std::complex<float>* spectrum) {
+    // Pack even samples into the real part and odd samples into the
+    // imaginary part, transform at half size, then split the result
+    for (int k = 0; k < half; k++) {
+        work[k] = std::complex<float>(input[2 * k], input[2 * k + 1]);
+    }
+    transform(work.data(), false);
+
+    for (int k = 0; k <= half; k++) {
+        std::complex<float> z = work[k % half];
+        std::complex<float> z_mirror = std::conj(work[(half - k) % half]);
+        std::complex<float> even = 0.5f * (z + z_mirror);
+        std::complex<float> odd = std::complex<float>(0.0f, -0.5f) * (z - z_mirror);
+        spectrum[k] = even + real_twiddles[k] * odd;
+    }
+}
+
+void FFTPlan::inverse(const std::complex<float>* spectrum, float* output) {
+    for (int k = 0; k < half; k++) {
+        std::complex<float> x = spectrum[k];
+        std::complex<float> x_mirror = std::conj(spectrum[half - k]);
+        std::complex<float> even = 0.5f * (x + x_mirror);
+        std::complex<float> odd = 0.5f * (x - x_mirror) * std::conj(real_twiddles[k]);
+        work[k] = even + std::complex<float>(0.0f, 1.0f) * odd;
+    }
+    transform(work.data(), true);
+
+    const float scale = 1.0f / half;
+    for (int k = 0; k < half; k++) {
+        output[2 * k] = work[k].real() * scale;
+        output[2 * k + 1] = work[k].imag() * scale;
+    }
+}
@@ -0,0 +1,37 @@
+#ifndef FFT_H
+#define FFT_H
+
+#include <vector>
+#include <complex>
+
+// Precomputed plan for a real-input FFT of a fixed power-of-two size.
+// Twiddles, the bit-reversal table and scratch space are allocated once, so
+// forward() and inverse() never allocate. A plan is not safe to use from
+// several threads at once.
+class FFTPlan {
+public:
+    explicit FFTPlan(int size);
+
+    int size() const { return n; }
+    int bins() const { return n / 2 + 1; }
+
+    // `input` holds size() real samples; `spectrum` receives bins() values
+    void forward(const float* input, std::complex<float>* spectrum);
+
+    // Inverse of forward(), including the 1/N scaling, so
+    // inverse(forward(x)) == x
+    void inverse(const std::complex<float>* spectrum, float* output);
+
+private:
+    int n;       // Real transform size
+    int half;    // Size of the complex transform underneath
+
+    std::vector<std::complex<float>> twiddles;       // exp(-2*pi*i*k/half)
+    std::vector<std::complex<float>> real_twiddles;  // exp(-2*pi*i*k/n)
+    std::vector<int> bit_reverse;
+    std::vector<std::complex<float>> work;
+
+    void transform(std::complex<float>* data, bool inverse_direction);
+};
+
+#endif // FFT_H
@@ -0,0 +1,28 @@
+#include "file_io.h"
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+
+bool writeAll(int fd, const void* data, size_t length) {
+    const char* bytes = static_cast<const char*>(data);
+    while (length > 0) {
+        ssize_t count = write(fd, bytes, length);
+        if (count < 0 && errno == EINTR) {
+            continue;
+        }
+        if (count <= 0) {
+            return false;
+        }
+        bytes += count;
+        length -= static_cast<size_t>(count);
+    }
+    return true;
+}
+
+void syncDirectory(const std::string& directory) {
+    int dir_fd = open(directory.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (dir_fd >= 0) {
+        fsync(dir_fd);
+        close(dir_fd);
+    }
+}
@@ -0,0 +1,17 @@
+#ifndef FILE_IO_H
+#define FILE_IO_H
+
+#include <string>
+#include <cstddef>
+
+// Small POSIX helpers shared by the on-disk transcription log and index
+
+// Writes all `length` bytes, retrying short writes and EINTR. Returns false
+// on any other error.
+bool writeAll(int fd, const void* data, size_t length);
+
+// fsyncs `directory` so a file created or renamed in it survives a crash.
+// Best effort: failures are ignored.
+void syncDirectory(const std::string& directory);
+
+#endif // FILE_IO_H
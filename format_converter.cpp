@@ -0,0 +1,153 @@
+#include "format_converter.h"
+#include <iostream>
+#include <stdexcept>
+#include <algorithm>
+#include <cstring>
+#include <cmath>
+
+FormatConverter::FormatConverter(AudioBlockPool& pool, int input_rate, int input_channels,
+                                 int output_rate)
+    : pool(pool), input_rate(input_rate), input_channels(input_channels),
+      requested_rate(output_rate), switch_pending(false), tail(Resampler::kTapsPerPhase, 0),
+      tail_fill(0), tail_end_frame(0), pending_lead(0) {
+    if (input_rate <= 0 || input_channels <= 0) {
+        throw std::invalid_argument("Invalid capture format for conversion");
+    }
+    resampler = makeResampler(output_rate);
+}
+
+std::unique_ptr<Resampler> FormatConverter::makeResampler(int output_rate) const {
+    if (output_rate <= 0) {
+        throw std::invalid_argument("Invalid conversion output rate");
+    }
+    if (output_rate == input_rate) {
+        return nullptr;
+    }
+    return std::unique_ptr<Resampler>(new Resampler(pool, input_rate, output_rate));
+}
+
+void FormatConverter::setOutputRate(int rate) {
+    // Filter banks are built here, off the conversion thread
+    std::unique_ptr<Resampler> next = makeResampler(rate);
+    std::unique_ptr<Resampler> retired;
+    {
+        std::lock_guard<std::mutex> lock(switch_mutex);
+        retired = std::move(next_resampler);
+        next_resampler = std::move(next);
+        requested_rate = rate;
+        switch_pending.store(true, std::memory_order_release);
+    }
+}
+
+void FormatConverter::applySwitch() {
+    // Where the outgoing stage's next output would have fallen; a pass-through
+    // has no filter delay
+    double next_output = resampler ? resampler->getNextOutputTime()
+                                   : static_cast<double>(tail_end_frame);
+    {
+        std::lock_guard<std::mutex> lock(switch_mutex);
+        resampler.swap(next_resampler);
+        switch_pending.store(false, std::memory_order_relaxed);
+    }
+    if (resampler && tail_fill > 0) {
+        resampler->prime(&tail[tail.size() - tail_fill], tail_fill, tail_end_frame, next_output);
+    } else if (!resampler) {
+        double lag = static_cast<double>(tail_end_frame) - std::ceil(next_output);
+        pending_lead = lag > 0.0 ? std::min(static_cast<size_t>(lag), tail_fill) : 0;
+    }
+}
+
+void FormatConverter::reset() {
+    if (resampler) {
+        resampler->reset();
+    }
+    tail_fill = 0;
+    pending_lead = 0;
+}
+
+void FormatConverter::rememberTail(const int16_t* samples, size_t count, uint64_t end_frame) {
+    size_t keep = std::min(count, tail.size());
+    size_t shift = std::min(tail_fill, tail.size() - keep);
+    std::memmove(&tail[tail.size() - keep - shift], &tail[tail.size() - shift],
+                 shift * sizeof(int16_t));
+    std::memcpy(&tail[tail.size() - keep], samples + (count - keep), keep * sizeof(int16_t));
+    tail_fill = keep + shift;
+    tail_end_frame = end_frame;
+}
+
+AudioBuffer FormatConverter::process(AudioBuffer&& input) {
+    if (!input.valid() || input.empty()) {
+        return std::move(input);
+    }
+    if (input.sampleRate != static_cast<size_t>(input_rate) ||
+        input.channels != static_cast<size_t>(input_channels)) {
+        std::cerr << "Converter set up for " << input_rate << " Hz, " << input_channels
+                  << " channels, got " << input.sampleRate << " Hz, " << input.channels
+                  << " channels" << std::endl;
+        return AudioBuffer();
+    }
+
+    // Audio from before lost frames must not prime a resampler switched in
+    // after them
+    if (input.discontinuity) {
+        tail_fill = 0;
+        pending_lead = 0;
+    }
+    if (switch_pending.load(std::memory_order_acquire)) {
+        applySwitch();
+    }
+
+    // Average the channels down, in place unless the block is shared; the
+    // buffer shrinks to one sample per frame
+    if (input_channels > 1) {
+        size_t frames = input.frames();
+        AudioBuffer mono;
+        if (input.isShared()) {
+            mono = pool.acquire(frames);
+            if (!mono.valid()) {
+                std::cerr << "No free audio buffer for downmixed audio" << std::endl;
+                return mono;
+            }
+            mono.copyFormatFrom(input);
+        }
+        const int16_t* samples = input.data();
+        int16_t* out = mono.valid() ? mono.data() : input.data();
+        for (size_t i = 0; i < frames; i++) {
+            int32_t sum = 0;
+            for (int c = 0; c < input_channels; c++) {
+                sum += samples[i * input_channels + c];
+            }
+            out[i] = static_cast<int16_t>(sum / input_channels);
+        }
+        if (mono.valid()) {
+            input = std::move(mono);
+        }
+        input.resize(frames);
+        input.channels = 1;
+    }
+
+    // Right after a switch to pass-through, lead with the samples the old
+    // filter still owed so the output timeline has no hole
+    AudioBuffer joined;
+    if (!resampler && pending_lead > 0 && input.startFrame == tail_end_frame) {
+        joined = pool.acquire(pending_lead + input.size());
+        if (joined.valid()) {
+            joined.resize(0);
+            joined.copyFormatFrom(input);
+            joined.append(&tail[tail.size() - pending_lead], pending_lead);
+            joined.startFrame -= pending_lead;
+            joined.timestampUs -= static_cast<int64_t>(pending_lead * 1000000ULL / input_rate);
+        }
+    }
+    pending_lead = 0;
+
+    rememberTail(input.data(), input.size(), input.startFrame + input.size());
+    if (joined.valid()) {
+        joined.append(input.data(), input.size());
+        return joined;
+    }
+    if (!resampler) {
+        return std::move(input);
+    }
+    return resampler->process(std::move(input));
+}
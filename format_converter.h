@@ -0,0 +1,71 @@
+#ifndef FORMAT_CONVERTER_H
+#define FORMAT_CONVERTER_H
+
+#include <vector>
+#include <cstdint>
+#include <atomic>
+#include <mutex>
+#include <memory>
+#include "audio_buffer.h"
+#include "resampler.h"
+
+// Software conversion from the device's native capture format to the mono
+// rate the pipeline asks for: channels are averaged down, then resampled.
+// The output rate can be changed from any thread while another thread is
+// converting. The new filter is built by the caller and swapped in between
+// two buffers, primed with the audio the previous one just consumed, so the
+// stream carries on without a gap and the device is never touched.
+class FormatConverter {
+public:
+    // Output buffers are drawn from `pool`, which must outlive this object.
+    // Throws std::invalid_argument for a ratio the resampler can't handle.
+    FormatConverter(AudioBlockPool& pool, int input_rate, int input_channels, int output_rate);
+
+    // Conversion thread. Returns `input` untouched when it is already mono at
+    // the output rate; otherwise the result may be empty for very short chunks.
+    AudioBuffer process(AudioBuffer&& input);
+
+    // Any thread. Takes effect at the start of the next process() call.
+    // Throws std::invalid_argument for a ratio the resampler can't handle.
+    void setOutputRate(int rate);
+
+    // The rate most recently asked for, which may not have reached the
+    // conversion thread yet
+    int getOutputRate() const { return requested_rate; }
+    int getInputRate() const { return input_rate; }
+    int getInputChannels() const { return input_channels; }
+
+    // Conversion thread. Drops the filter state, e.g. after a stream restart.
+    void reset();
+
+private:
+    AudioBlockPool& pool;
+    int input_rate;
+    int input_channels;
+    std::atomic<int> requested_rate;
+
+    // Conversion thread only; a null resampler means the rates match
+    std::unique_ptr<Resampler> resampler;
+
+    // Handover from setOutputRate(). The slot keeps whichever resampler was
+    // swapped out so it is freed by the next setOutputRate() call rather than
+    // on the conversion thread.
+    std::mutex switch_mutex;
+    std::unique_ptr<Resampler> next_resampler;
+    std::atomic<bool> switch_pending;
+
+    // Last mono input samples, to prime a resampler switched in mid-stream
+    std::vector<int16_t> tail;
+    size_t tail_fill;
+    uint64_t tail_end_frame;
+
+    // After a switch to pass-through, tail samples the outgoing filter's
+    // delay hadn't reached yet; they lead the next buffer
+    size_t pending_lead;
+
+    std::unique_ptr<Resampler> makeResampler(int output_rate) const;
+    void applySwitch();
+    void rememberTail(const int16_t* samples, size_t count, uint64_t end_frame);
+};
+
+#endif // FORMAT_CONVERTER_H
@@ -0,0 +1,194 @@
+#include "keyword_detector.h"
+#include <stdexcept>
+#include <algorithm>
+#include <deque>
+
+static const uint8_t kBoundaryClass = 0;
+static const uint8_t kOtherWordClass = 1;
+static const uint32_t kMissing = UINT32_MAX;
+
+static bool isWordByte(unsigned char c) {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c >= 0x80;
+}
+
+static unsigned char foldCase(unsigned char c) {
+    return (c >= 'A' && c <= 'Z') ? static_cast<unsigned char>(c - 'A' + 'a') : c;
+}
+
+// Keywords go through the same normalization as the text, wrapped in
+// boundaries: "Fire-Alarm" -> " fire alarm "
+static std::string normalizeKeyword(const std::string& keyword) {
+    std::string normalized = " ";
+    for (unsigned char c : keyword) {
+        if (c == '\'') {
+            continue;
+        }
+        if (isWordByte(c)) {
+            normalized.push_back(static_cast<char>(foldCase(c)));
+        } else if (normalized.back() != ' ') {
+            normalized.push_back(' ');
+        }
+    }
+    if (normalized.back() != ' ') {
+        normalized.push_back(' ');
+    }
+    return normalized;
+}
+
+KeywordDetector::KeywordDetector(const std::vector<std::string>& keywords)
+    : keywords(keywords), class_count(2) {
+    std::vector<std::string> patterns;
+    patterns.reserve(keywords.size());
+    size_t longest = 0;
+    for (const std::string& keyword : keywords) {
+        patterns.push_back(normalizeKeyword(keyword));
+        if (patterns.back().size() < 3) {
+            throw std::invalid_argument("Keyword \"" + keyword + "\" has no letters or digits");
+        }
+        longest = std::max(longest, patterns.back().size());
+        pattern_length.push_back(static_cast<uint32_t>(patterns.back().size()));
+    }
+
+    // Only bytes that occur in some keyword get their own class; every
+    // other word byte shares one, which keeps the table narrow
+    std::fill(byte_class, byte_class + 256, kBoundaryClass);
+    for (int c = 0; c < 256; c++) {
+        if (isWordByte(static_cast<unsigned char>(c))) {
+            byte_class[c] = kOtherWordClass;
+        }
+    }
+    for (const std::string& pattern : patterns) {
+        for (unsigned char c : pattern) {
+            if (c != ' ' && byte_class[c] == kOtherWordClass) {
+                byte_class[c] = static_cast<uint8_t>(class_count++);
+            }
+        }
+    }
+    for (int c = 'A'; c <= 'Z'; c++) {
+        byte_class[c] = byte_class[foldCase(static_cast<unsigned char>(c))];
+    }
+
+    // Trie
+    transitions.assign(class_count, kMissing);
+    output.assign(1, -1);
+    for (size_t k = 0; k < patterns.size(); k++) {
+        uint32_t node = 0;
+        for (unsigned char c : patterns[k]) {
+            uint32_t& next = transitions[node * class_count + byte_class[c]];
+            if (next == kMissing) {
+                next = static_cast<uint32_t>(output.size());
+                output.push_back(-1);
+                transitions.resize(transitions.size() + class_count, kMissing);
+            }
+            node = transitions[node * class_count + byte_class[c]];
+        }
+        if (output[node] < 0) {
+            // Duplicate keywords report the first one
+            output[node] = static_cast<int32_t>(k);
+        }
+    }
+
+    // Breadth-first, resolve failure links into the table itself so
+    // matching never follows them at run time
+    std::vector<uint32_t> failure(output.size(), 0);
+    output_link.assign(output.size(), 0);
+    std::deque<uint32_t> queue;
+    for (size_t c = 0; c < class_count; c++) {
+        uint32_t& next = transitions[c];
+        if (next == kMissing) {
+            next = 0;
+        } else {
+            queue.push_back(next);
+        }
+    }
+    while (!queue.empty()) {
+        uint32_t node = queue.front();
+        queue.pop_front();
+        for (size_t c = 0; c < class_count; c++) {
+            uint32_t& next = transitions[node * class_count + c];
+            uint32_t fallback = transitions[failure[node] * class_count + c];
+            if (next == kMissing) {
+                next = fallback;
+                continue;
+            }
+            failure[next] = fallback;
+            output_link[next] = output[fallback] >= 0 ? fallback : output_link[fallback];
+            queue.push_back(next);
+        }
+    }
+
+    size_t ring = 1;
+    while (ring < longest) {
+        ring <<= 1;
+    }
+    recent.assign(ring, 0);
+    reset();
+}
+
+void KeywordDetector::reset() {
+    state = 0;
+    stream_offset = 0;
+    normalized_count = 0;
+    at_boundary = false;
+    std::vector<Match> unused;
+    // Start of stream counts as a word boundary
+    step(kBoundaryClass, 0, 0, unused);
+    at_boundary = true;
+}
+
+void KeywordDetector::step(uint8_t cls, uint64_t offset, int64_t base,
+                           std::vector<Match>& matches) {
+    recent[normalized_count & (recent.size() - 1)] = offset;
+    normalized_count++;
+    state = transitions[state * class_count + cls];
+
+    uint32_t node = output[state] >= 0 ? state : output_link[state];
+    while (node != 0) {
+        size_t keyword = static_cast<size_t>(output[node]);
+        // Skip the boundaries on both ends of the pattern
+        uint64_t first = normalized_count - pattern_length[keyword] + 1;
+        uint64_t last = normalized_count - 2;
+        Match match;
+        match.keyword = keyword;
+        match.begin = static_cast<int64_t>(recent[first & (recent.size() - 1)]) - base;
+        match.end = static_cast<int64_t>(recent[last & (recent.size() - 1)]) + 1 - base;
+        matches.push_back(match);
+        node = output_link[node];
+    }
+}
+
+size_t KeywordDetector::feed(const std::string& text, std::vector<Match>& matches) {
+    size_t before = matches.size();
+    int64_t base = static_cast<int64_t>(stream_offset);
+
+    for (size_t i = 0; i < text.size(); i++) {
+        unsigned char c = static_cast<unsigned char>(text[i]);
+        if (c == '\'') {
+            continue;
+        }
+        uint8_t cls = byte_class[c];
+        if (cls == kBoundaryClass) {
+            if (at_boundary) {
+                continue;
+            }
+            at_boundary = true;
+        } else {
+            at_boundary = false;
+        }
+        step(cls, stream_offset + i, base, matches);
+    }
+    stream_offset += text.size();
+
+    // Segments are separate words; closing the last one here reports a
+    // keyword at the end of this text now rather than on the next feed()
+    if (!at_boundary) {
+        step(kBoundaryClass, stream_offset, base, matches);
+        at_boundary = true;
+    }
+    return matches.size() - before;
+}
+
+bool KeywordDetector::detectKeywords(const std::string& text) {
+    std::vector<Match> matches;
+    return feed(text, matches) > 0;
+}
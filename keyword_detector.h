@@ -0,0 +1,64 @@
+#ifndef KEYWORD_DETECTOR_H
+#define KEYWORD_DETECTOR_H
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+// Finds whole-word keywords and phrases in transcribed text.
+//
+// All keywords are compiled into one Aho-Corasick automaton stored as a flat
+// state x byte-class transition table, so matching costs one table lookup
+// per input byte however many keywords are loaded. Text is normalized on
+// the fly: ASCII is case folded, apostrophes are dropped ("don't" ==
+// "dont") and any run of other non-word characters acts as a single word
+// boundary. Bytes >= 0x80 are word characters, so UTF-8 keywords work but
+// are matched case-sensitively.
+//
+// Consecutive feed() calls are treated as one stream with a word boundary
+// between them, so a phrase split across transcription segments still
+// matches. Not thread-safe; use one detector per stream.
+class KeywordDetector {
+public:
+    struct Match {
+        size_t keyword;    // Index into the constructor's keyword list
+        int64_t begin;     // Byte offsets into the text passed to this feed();
+        int64_t end;       // begin is negative if the match started in an earlier one
+    };
+
+    KeywordDetector(const std::vector<std::string>& keywords);
+
+    // Scans the next piece of the stream; appends matches in the order they
+    // end. Returns how many were found.
+    size_t feed(const std::string& text, std::vector<Match>& matches);
+
+    // feed() without the details
+    bool detectKeywords(const std::string& text);
+
+    // Starts a new stream; nothing carries over into the next feed()
+    void reset();
+
+    const std::string& getKeyword(size_t index) const { return keywords[index]; }
+    size_t getKeywordCount() const { return keywords.size(); }
+    size_t getStateCount() const { return output.size(); }
+
+private:
+    std::vector<std::string> keywords;
+    uint8_t byte_class[256];           // 0 = boundary, 1 = word byte in no keyword
+    size_t class_count;
+    std::vector<uint32_t> transitions; // [state * class_count + class]
+    std::vector<int32_t> output;       // Keyword ending at this state, or -1
+    std::vector<uint32_t> output_link; // Nearest suffix state with output, 0 if none
+    std::vector<uint32_t> pattern_length;   // Normalized length per keyword, with boundaries
+
+    // Stream state
+    uint32_t state;
+    bool at_boundary;
+    uint64_t stream_offset;            // Bytes fed since reset()
+    std::vector<uint64_t> recent;      // Stream offset of each recent normalized byte
+    uint64_t normalized_count;
+
+    void step(uint8_t cls, uint64_t offset, int64_t base, std::vector<Match>& matches);
+};
+
+#endif // KEYWORD_DETECTOR_H
@@ -0,0 +1,360 @@
+#include "keyword_spotter.h"
+#include <iostream>
+#include <stdexcept>
+#include <algorithm>
+#include <fstream>
+#include <cmath>
+#include <cstring>
+
+static const int kCoefficients = 12;       // c1..c12
+static const int kCepstrumBands = 26;
+
+// Enrolled examples are 0.2 .. 2 s of speech after trimming
+static const int kMinTemplateFrames = 20;
+static const int kMaxTemplateFrames = 200;
+
+// Frames more than this far below the loudest one count as silence when
+// trimming an example (natural log of power, ~35 dB)
+static const float kTrimRange = 8.0f;
+
+// A calibrated template accepts matches up to this much farther than its
+// farthest sibling example
+static const float kThresholdMargin = 1.15f;
+
+// Frame end times kept for reporting when a match started; covers the
+// longest match a template allows (2x its length)
+static const size_t kFrameHistory = 512;
+
+// Version 2: features come from the shared Whisper-style log-mel frames
+static const char kTemplateMagic[4] = {'K', 'W', 'S', '2'};
+
+static float frameDistance(const float* a, const float* b) {
+    float sum = 0.0f;
+    for (int k = 0; k < kCoefficients; k++) {
+        float d = a[k] - b[k];
+        sum += d * d;
+    }
+    return std::sqrt(sum);
+}
+
+// Best full alignment of two sequences with symmetric step weights
+// (diagonal 2d, horizontal and vertical d), normalized by the summed
+// lengths so it reads as a mean per-frame distance
+static float alignmentDistance(const float* a, int a_frames, const float* b, int b_frames) {
+    std::vector<float> cost(b_frames);
+    std::vector<float> next(b_frames);
+
+    for (int i = 0; i < a_frames; i++) {
+        for (int j = 0; j < b_frames; j++) {
+            float d = frameDistance(a + i * kCoefficients, b + j * kCoefficients);
+            if (i == 0 && j == 0) {
+                next[j] = 2.0f * d;
+                continue;
+            }
+            float best = INFINITY;
+            if (i > 0) {
+                best = cost[j] + d;
+                if (j > 0) {
+                    best = std::min(best, cost[j - 1] + 2.0f * d);
+                }
+            }
+            if (j > 0) {
+                best = std::min(best, next[j - 1] + d);
+            }
+            next[j] = best;
+        }
+        cost.swap(next);
+    }
+    return cost[b_frames - 1] / (a_frames + b_frames);
+}
+
+KeywordSpotter::KeywordSpotter(const FeatureExtractor& features)
+    : source(features), mel_bands(features.getMelBands()),
+      frame_us(static_cast<int64_t>(features.getFrameLength()) * 1000000 / features.getSampleRate()),
+      frame_count(0), frame_end_us(kFrameHistory, 0), threshold(5.0f),
+      features(kCoefficients, 0.0f) {
+    // Orthonormal DCT-II rows 1..kCoefficients over kCepstrumBands wider
+    // bands, each the mean of its share of the extractor's log10 mel bands
+    // (converted to natural log). Whisper's narrow bands resolve pitch
+    // harmonics and noise that MFCCs are meant to smooth over; folding the
+    // pooling into the DCT matrix makes it free.
+    const double pi = 3.14159265358979323846;
+    const double ln10 = std::log(10.0);
+    dct.assign(kCoefficients * mel_bands, 0.0f);
+    for (int m = 0; m < mel_bands; m++) {
+        int band = m * kCepstrumBands / mel_bands;
+        int first = (band * mel_bands + kCepstrumBands - 1) / kCepstrumBands;
+        int end = ((band + 1) * mel_bands + kCepstrumBands - 1) / kCepstrumBands;
+        for (int k = 0; k < kCoefficients; k++) {
+            dct[k * mel_bands + m] = static_cast<float>(
+                ln10 / (end - first) * std::sqrt(2.0 / kCepstrumBands) *
+                std::cos(pi * (k + 1) * (band + 0.5) / kCepstrumBands));
+        }
+    }
+}
+
+void KeywordSpotter::setThreshold(float mean_distance) {
+    threshold = mean_distance;
+}
+
+void KeywordSpotter::reset() {
+    frame_count = 0;
+    last_fired.clear();
+    for (Template& entry : templates) {
+        std::fill(entry.cost.begin(), entry.cost.end(), INFINITY);
+        std::fill(entry.start.begin(), entry.start.end(), 0);
+    }
+}
+
+void KeywordSpotter::computeFeatures(const float* log_mel, float* out) const {
+    for (int k = 0; k < kCoefficients; k++) {
+        const float* row = &dct[k * mel_bands];
+        float sum = 0.0f;
+        for (int m = 0; m < mel_bands; m++) {
+            sum += row[m] * log_mel[m];
+        }
+        out[k] = sum;
+    }
+}
+
+void KeywordSpotter::extractAll(const AudioBuffer& audio, std::vector<float>& out, int& frames) {
+    // Same analysis as the live stream, on a private extractor
+    FeatureExtractor extractor(source.getSampleRate(), mel_bands);
+    const std::vector<FeatureExtractor::Frame>& analysed = extractor.process(audio);
+
+    out.assign(analysed.size() * kCoefficients, 0.0f);
+    std::vector<float> energies;
+    for (size_t f = 0; f < analysed.size(); f++) {
+        computeFeatures(analysed[f].logMel, &out[f * kCoefficients]);
+        energies.push_back(std::log(analysed[f].energy + 1e-10f));
+    }
+    frames = static_cast<int>(energies.size());
+    if (frames == 0) {
+        return;
+    }
+
+    // Trim leading and trailing silence
+    float loudest = *std::max_element(energies.begin(), energies.end());
+    int first = 0;
+    int last = frames - 1;
+    while (first < last && energies[first] < loudest - kTrimRange) {
+        first++;
+    }
+    while (last > first && energies[last] < loudest - kTrimRange) {
+        last--;
+    }
+    out.erase(out.begin() + (last + 1) * kCoefficients, out.end());
+    out.erase(out.begin(), out.begin() + first * kCoefficients);
+    frames = last - first + 1;
+}
+
+void KeywordSpotter::addTemplate(const std::string& keyword, std::vector<float>&& template_features,
+                                 int frames) {
+    Template entry;
+    entry.keyword = keyword;
+    entry.frames = frames;
+    entry.features = std::move(template_features);
+    entry.threshold = 0.0f;
+    entry.cost.assign(frames, INFINITY);
+    entry.start.assign(frames, 0);
+    templates.push_back(std::move(entry));
+}
+
+void KeywordSpotter::calibrate(const std::string& keyword) {
+    std::vector<Template*> siblings;
+    for (Template& entry : templates) {
+        if (entry.keyword == keyword) {
+            siblings.push_back(&entry);
+        }
+    }
+    if (siblings.size() < 2) {
+        return;
+    }
+    for (Template* a : siblings) {
+        float farthest = 0.0f;
+        for (Template* b : siblings) {
+            if (a != b) {
+                farthest = std::max(farthest, alignmentDistance(a->features.data(), a->frames,
+                                                                b->features.data(), b->frames));
+            }
+        }
+        a->threshold = farthest * kThresholdMargin;
+    }
+}
+
+bool KeywordSpotter::enroll(const std::string& keyword, const AudioBuffer& example) {
+    std::vector<float> template_features;
+    int frames = 0;
+    extractAll(example, template_features, frames);
+    if (frames < kMinTemplateFrames || frames > kMaxTemplateFrames) {
+        std::cerr << "Keyword example for \"" << keyword << "\" has " << frames
+                  << " frames of speech, need " << kMinTemplateFrames << ".."
+                  << kMaxTemplateFrames << std::endl;
+        return false;
+    }
+    addTemplate(keyword, std::move(template_features), frames);
+    calibrate(keyword);
+    return true;
+}
+
+bool KeywordSpotter::saveTemplates(const std::string& path) const {
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    if (!file) {
+        return false;
+    }
+    uint32_t count = static_cast<uint32_t>(templates.size());
+    file.write(kTemplateMagic, sizeof(kTemplateMagic));
+    file.write(reinterpret_cast<const char*>(&count), sizeof(count));
+    for (const Template& entry : templates) {
+        uint32_t name_length = static_cast<uint32_t>(entry.keyword.size());
+        uint32_t frames = static_cast<uint32_t>(entry.frames);
+        file.write(reinterpret_cast<const char*>(&name_length), sizeof(name_length));
+        file.write(entry.keyword.data(), name_length);
+        file.write(reinterpret_cast<const char*>(&frames), sizeof(frames));
+        file.write(reinterpret_cast<const char*>(entry.features.data()),
+                   entry.features.size() * sizeof(float));
+    }
+    return static_cast<bool>(file);
+}
+
+bool KeywordSpotter::loadTemplates(const std::string& path) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+        return false;
+    }
+    char magic[sizeof(kTemplateMagic)];
+    uint32_t count = 0;
+    file.read(magic, sizeof(magic));
+    file.read(reinterpret_cast<char*>(&count), sizeof(count));
+    if (!file || std::memcmp(magic, kTemplateMagic, sizeof(magic)) != 0) {
+        std::cerr << "Not a keyword template file: " << path << std::endl;
+        return false;
+    }
+
+    std::vector<Template> previous;
+    previous.swap(templates);
+    std::vector<std::string> keywords;
+    for (uint32_t i = 0; i < count; i++) {
+        uint32_t name_length = 0;
+        uint32_t frames = 0;
+        file.read(reinterpret_cast<char*>(&name_length), sizeof(name_length));
+        if (!file || name_length == 0 || name_length > 256) {
+            break;
+        }
+        std::string keyword(name_length, '\0');
+        file.read(&keyword[0], name_length);
+        file.read(reinterpret_cast<char*>(&frames), sizeof(frames));
+        if (!file || frames < static_cast<uint32_t>(kMinTemplateFrames) ||
+            frames > static_cast<uint32_t>(kMaxTemplateFrames)) {
+            break;
+        }
+        std::vector<float> template_features(frames * kCoefficients);
+        file.read(reinterpret_cast<char*>(template_features.data()),
+                  template_features.size() * sizeof(float));
+        if (!file) {
+            break;
+        }
+        addTemplate(keyword, std::move(template_features), static_cast<int>(frames));
+        if (std::find(keywords.begin(), keywords.end(), keyword) == keywords.end()) {
+            keywords.push_back(keyword);
+        }
+    }
+    if (templates.size() != count) {
+        std::cerr << "Keyword template file is truncated: " << path << std::endl;
+        templates.swap(previous);
+        return false;
+    }
+
+    for (const std::string& keyword : keywords) {
+        calibrate(keyword);
+    }
+    reset();
+    return true;
+}
+
+bool KeywordSpotter::matchFrame(Template& entry, int64_t end_us,
+                                std::vector<Detection>& detections) {
+    // Subsequence DTW, one stream frame at a time. Cell i holds the best
+    // path ending at template frame i and the current stream frame; the
+    // path may start at any stream frame. Same step weights as
+    // alignmentDistance(), so the scores are comparable.
+    float diagonal = 0.0f;            // Free start before template frame 0
+    uint64_t diagonal_start = frame_count;
+
+    for (int i = 0; i < entry.frames; i++) {
+        float d = frameDistance(features.data(), &entry.features[i * kCoefficients]);
+
+        float best = diagonal + 2.0f * d;
+        uint64_t best_start = diagonal_start;
+        // Stream advanced; cell i still holds the previous frame's path
+        if (entry.cost[i] + d < best) {
+            best = entry.cost[i] + d;
+            best_start = entry.start[i];
+        }
+        // Template advanced within this frame; cell i - 1 is already updated
+        if (i > 0 && entry.cost[i - 1] + d < best) {
+            best = entry.cost[i - 1] + d;
+            best_start = entry.start[i - 1];
+        }
+
+        // Both advanced: the previous frame's cell i, saved before overwriting
+        diagonal = entry.cost[i];
+        diagonal_start = entry.start[i];
+        entry.cost[i] = best;
+        entry.start[i] = best_start;
+    }
+
+    int last = entry.frames - 1;
+    uint64_t duration = frame_count - entry.start[last] + 1;
+    float distance = entry.cost[last] / (entry.frames + duration);
+    float limit = entry.threshold > 0.0f ? entry.threshold : threshold;
+    if (distance >= limit || duration * 2 < static_cast<uint64_t>(entry.frames) ||
+        duration > 2 * static_cast<uint64_t>(entry.frames)) {
+        return false;
+    }
+
+    auto fired = std::find_if(last_fired.begin(), last_fired.end(),
+                              [&](const std::pair<std::string, uint64_t>& previous) {
+                                  return previous.first == entry.keyword;
+                              });
+    if (fired == last_fired.end()) {
+        last_fired.emplace_back(entry.keyword, frame_count);
+    } else if (frame_count - fired->second <= static_cast<uint64_t>(entry.frames)) {
+        // Same utterance, seen by another template or a later frame
+        return false;
+    } else {
+        fired->second = frame_count;
+    }
+
+    Detection detection;
+    detection.keyword = entry.keyword;
+    detection.distance = distance;
+    detection.endUs = end_us;
+    detection.startUs = frame_end_us[entry.start[last] % kFrameHistory] - frame_us;
+    detections.push_back(std::move(detection));
+    return true;
+}
+
+size_t KeywordSpotter::process(std::vector<Detection>& detections) {
+    size_t before = detections.size();
+    if (templates.empty()) {
+        return 0;
+    }
+
+    for (const FeatureExtractor::Frame& frame : source.frames()) {
+        // The extractor restarted after lost audio; a word can't be matched
+        // across the gap
+        if (frame.index == 0) {
+            for (Template& entry : templates) {
+                std::fill(entry.cost.begin(), entry.cost.end(), INFINITY);
+            }
+        }
+        frame_end_us[frame_count % kFrameHistory] = frame.endUs;
+        computeFeatures(frame.logMel, features.data());
+        for (Template& entry : templates) {
+            matchFrame(entry, frame.endUs, detections);
+        }
+        frame_count++;
+    }
+    return detections.size() - before;
+}
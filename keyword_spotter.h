@@ -0,0 +1,88 @@
+#ifndef KEYWORD_SPOTTER_H
+#define KEYWORD_SPOTTER_H
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include "audio_buffer.h"
+#include "feature_extractor.h"
+
+// Always-on acoustic keyword spotting that runs on the capture stream
+// ahead of Whisper, so alerts don't wait for a decode.
+//
+// Each 10 ms frame of the shared FeatureExtractor is reduced to 12 MFCCs by
+// a DCT of its log-mel energies (c1..c12; c0 is dropped so input gain
+// doesn't matter). Every enrolled example of a keyword is a template
+// matched by subsequence DTW: the match may start and end anywhere in the
+// stream, and the DTW column is updated once per frame. A keyword is
+// reported on the first frame at which the path cost, normalized by
+// template plus matched length, drops under the template's threshold;
+// further matches within one template length of it are suppressed.
+//
+// With two or more examples of a keyword, each template's threshold is
+// calibrated from how far it is from the other examples; otherwise the
+// global threshold applies. Templates are speaker- and microphone-specific
+// and meant to be enrolled on the device.
+class KeywordSpotter {
+public:
+    struct Detection {
+        std::string keyword;
+        float distance;       // Normalized MFCC path cost of the match
+        int64_t startUs;      // Monotonic capture time of the match
+        int64_t endUs;
+    };
+
+    // Reads the frames of `features`, which must outlive this object
+    explicit KeywordSpotter(const FeatureExtractor& features);
+
+    // Adds an example recording of `keyword`. Leading and trailing silence
+    // is trimmed. Returns false if the example is too short or silent.
+    bool enroll(const std::string& keyword, const AudioBuffer& example);
+
+    bool loadTemplates(const std::string& path);
+    bool saveTemplates(const std::string& path) const;
+
+    // Matches the frames `features` produced from its latest chunk
+    size_t process(std::vector<Detection>& detections);
+    void reset();
+
+    // Normalized path cost under which an uncalibrated template matches
+    void setThreshold(float mean_distance);
+
+    size_t getTemplateCount() const { return templates.size(); }
+
+private:
+    struct Template {
+        std::string keyword;
+        int frames;
+        std::vector<float> features;   // frames x kCoefficients
+        float threshold;               // <= 0: use the global threshold
+
+        // Streaming DTW column, one cell per template frame
+        std::vector<float> cost;
+        std::vector<uint64_t> start;   // Stream frame where the path began
+    };
+
+    const FeatureExtractor& source;
+    int mel_bands;
+    int64_t frame_us;                // Duration of one analysis frame
+    std::vector<float> dct;          // Coefficients x bands, from log10 mel
+
+    uint64_t frame_count;            // Stream frames since reset()
+    std::vector<int64_t> frame_end_us;   // Recent frame end times, by frame % size
+
+    std::vector<Template> templates;
+    float threshold;
+    std::vector<float> features;     // Current frame's MFCCs
+
+    // Latest frame a keyword fired at, so one utterance fires once
+    std::vector<std::pair<std::string, uint64_t>> last_fired;
+
+    void computeFeatures(const float* log_mel, float* out) const;
+    void extractAll(const AudioBuffer& audio, std::vector<float>& out, int& frames);
+    void calibrate(const std::string& keyword);
+    void addTemplate(const std::string& keyword, std::vector<float>&& features, int frames);
+    bool matchFrame(Template& entry, int64_t end_us, std::vector<Detection>& detections);
+};
+
+#endif // KEYWORD_SPOTTER_H
@@ -6,12 +6,14 @@
 #include <chrono>
 #include <atomic>
 #include <mutex>
-#include <ctime>
-#include <iomanip>
+#include <algorithm>
+#include <memory>
 #include <signal.h>
 
 // Hardware interfaces
 #include "audio_capture.h"
+#include "alsa_capture_source.h"
+#include "replay_capture_source.h"
 #include "display.h"
 #include "haptic.h"
 #include "power_manager.h"
@@ -21,15 +23,21 @@
 // Processing modules
 #include "speech_to_text.h"
 #include "noise_reduction.h"
+#include "voice_activity_detector.h"
+#include "streaming_transcriber.h"
+#include "transcription_worker_pool.h"
+#include "event_bus.h"
+#include "transcription_history.h"
 #include "keyword_detector.h"
+#include "keyword_spotter.h"
+#include "feature_extractor.h"
 #include "storage_manager.h"
+#include "tracer.h"
 
 // Global control flags
 std::atomic<bool> g_running(true);
 std::atomic<bool> g_low_power_mode(false);
-std::mutex g_text_mutex;
-std::string g_current_transcription;
-std::vector<std::string> g_transcription_history;
+TranscriptionHistory g_transcription_history(128);  // Written by the transcription sink only
 
 // Signal handler for graceful shutdown
 void signalHandler(int signum) {
@@ -37,147 +45,631 @@ void signalHandler(int signum) {
     g_running = false;
 }
 
-// Helper function to get current timestamp
-std::string getCurrentTimestamp() {
-    auto now = std::chrono::system_clock::now();
-    auto time = std::chrono::system_clock::to_time_t(now);
-    std::stringstream ss;
-    ss << std::put_time(std::localtime(&time), "%Y-%m-%d %H:%M:%S");
-    return ss.str();
+// Audio timestamps use the monotonic clock; storage wants wall-clock time
+int64_t monotonicToWallClockMicros(int64_t monotonic_us) {
+    using namespace std::chrono;
+    int64_t wall_now = duration_cast<microseconds>(system_clock::now().time_since_epoch()).count();
+    int64_t mono_now = duration_cast<microseconds>(steady_clock::now().time_since_epoch()).count();
+    return wall_now - (mono_now - monotonic_us);
 }
 
+// One alert per spoken keyword, from whichever path hears it first. The
+// acoustic spotter buzzes within a hop of the word ending; Whisper's text
+// then confirms it. A keyword only the text path caught still buzzes.
+class KeywordAlerts {
+public:
+    struct Stats {
+        uint64_t acoustic = 0;      // Alerts raised by the spotter
+        uint64_t confirmed = 0;     // ... later seen in the text
+        uint64_t text_only = 0;     // Alerts the spotter missed
+    };
+    
+    KeywordAlerts(EventBus& bus, HapticFeedback& haptic) : bus(bus), haptic(haptic) {}
+    
+    // Audio thread
+    void acousticHit(const std::string& keyword) {
+        std::lock_guard<std::mutex> lock(mutex);
+        int64_t now = nowMicros();
+        for (const Pending& pending : unconfirmed) {
+            if (pending.keyword == keyword && now - pending.time_us < kRepeatUs) {
+                return;
+            }
+        }
+        unconfirmed.push_back({keyword, now});
+        stats.acoustic++;
+        alert(keyword);
+    }
+    
+    // Transcription sink
+    void textHit(const std::string& keyword) {
+        std::lock_guard<std::mutex> lock(mutex);
+        int64_t now = nowMicros();
+        for (auto it = unconfirmed.begin(); it != unconfirmed.end(); ++it) {
+            if (it->keyword == keyword && now - it->time_us < kConfirmUs) {
+                unconfirmed.erase(it);
+                stats.confirmed++;
+                return;
+            }
+        }
+        stats.text_only++;
+        alert(keyword);
+    }
+    
+    Stats getStats() {
+        std::lock_guard<std::mutex> lock(mutex);
+        return stats;
+    }
+    
+private:
+    // Whisper's text for a word arrives within a few seconds of the audio
+    static const int64_t kConfirmUs = 10000000;
+    static const int64_t kRepeatUs = 1000000;
+    
+    struct Pending {
+        std::string keyword;
+        int64_t time_us;
+    };
+    
+    EventBus& bus;
+    HapticFeedback& haptic;
+    std::mutex mutex;
+    std::vector<Pending> unconfirmed;
+    Stats stats;
+    
+    static int64_t nowMicros() {
+        return std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+    
+    void alert(const std::string& keyword) {
+        int64_t now = nowMicros();
+        unconfirmed.erase(std::remove_if(unconfirmed.begin(), unconfirmed.end(),
+                                         [now](const Pending& pending) {
+                                             return now - pending.time_us >= kConfirmUs;
+                                         }),
+                          unconfirmed.end());
+        haptic.triggerVibration();
+        
+        Event event;
+        event.type = Event::KEYWORD_DETECTED;
+        event.text = keyword;
+        bus.publish(std::move(event));
+    }
+};
+
+// Publishes text as it is transcribed: committed words are checked for
+// keywords right away, finished utterances go into the history
+class TranscriptionSink {
+public:
+    TranscriptionSink(EventBus& bus, KeywordDetector& keyword, KeywordAlerts& alerts)
+        : bus(bus), keyword(keyword), alerts(alerts) {}
+    
+    // Called on a transcription worker; results for one stream arrive in order
+    void handle(const TranscriptionWorkerPool::Result& result) {
+        if (result.dropped) {
+            std::cerr << "Transcription fell behind, dropped " << result.samples
+                      << " samples of speech" << std::endl;
+            return;
+        }
+        
+        // Lost audio cut the segment: what was heard before the gap is an
+        // utterance of its own, never stitched to what follows
+        if (result.segment_cut) {
+            addText(result.cut_text);
+            finishUtterance();
+        }
+        
+        if (!utterance_started && result.samples > 0) {
+            utterance_start_us = result.timestampUs;
+            utterance_started = true;
+        }
+        
+        addText(result.text);
+        
+        if (result.segment_end) {
+            finishUtterance();
+            return;
+        }
+        if (result.text.empty() && result.partial == last_partial) {
+            return;
+        }
+        last_partial = result.partial;
+        
+        Event event;
+        event.type = Event::TRANSCRIPTION_UPDATED;
+        event.text = utterance;
+        if (!result.partial.empty()) {
+            event.text += event.text.empty() ? "" : " ";
+            event.text += result.partial;
+        }
+        bus.publish(std::move(event));
+    }
+    
+private:
+    EventBus& bus;
+    KeywordDetector& keyword;
+    KeywordAlerts& alerts;
+    std::vector<KeywordDetector::Match> keyword_matches;
+    std::string utterance;
+    std::string last_partial;
+    int64_t utterance_start_us = 0;  // Capture time of the segment's first sample
+    bool utterance_started = false;
+    
+    void addText(const std::string& text) {
+        if (text.empty()) {
+            return;
+        }
+        
+        // Check for keywords; phrases split across results still match
+        TRACE_SCOPE("keywords.text");
+        keyword_matches.clear();
+        keyword.feed(text, keyword_matches);
+        for (const KeywordDetector::Match& match : keyword_matches) {
+            alerts.textHit(keyword.getKeyword(match.keyword));
+        }
+        if (!utterance.empty()) {
+            utterance += " ";
+        }
+        utterance += text;
+    }
+    
+    void finishUtterance() {
+        last_partial.clear();
+        keyword.reset();
+        bool started = utterance_started;
+        utterance_started = false;
+        if (utterance.empty()) {
+            return;
+        }
+        
+        int64_t capture_us = monotonicToWallClockMicros(
+            started ? utterance_start_us : std::chrono::duration_cast<std::chrono::microseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count());
+        uint64_t sequence = g_transcription_history.append(utterance, capture_us);
+        
+        Event event;
+        event.type = Event::TRANSCRIPTION_UPDATED;
+        event.text = utterance;
+        bus.publish(event);
+        
+        event.type = Event::SEGMENT_FINISHED;
+        event.sequence = sequence;
+        event.text.swap(utterance);
+        bus.publish(std::move(event));
+    }
+};
+
 // Audio processing thread function
-void audioProcessingThread(AudioCapture& audio, SpeechToText& stt, 
-                          NoiseReduction& noise, KeywordDetector& keyword,
-                          HapticFeedback& haptic) {
+void audioProcessingThread(AudioCapture& audio,
+                          NoiseReduction& noise, FeatureExtractor& features,
+                          VoiceActivityDetector& vad,
+                          StreamingTranscriber& transcriber, TranscriptionWorkerPool& workers,
+                          KeywordSpotter& spotter, EventBus& bus, KeywordDetector& keyword,
+                          KeywordAlerts& alerts) {
+    Tracer::setThreadName("audio");
+    
+    // The capture thread keeps filling the ring while we run noise reduction,
+    // and Whisper runs on the worker pool, so this loop never waits on
+    // inference
+    if (!audio.startStreaming()) {
+        std::cerr << "Failed to start audio streaming" << std::endl;
+        g_running = false;
+        bus.shutdown();
+        return;
+    }
+    
+    // Short windows keep the speech gate and the keyword spotter responsive;
+    // the transcriber decides when enough speech has arrived to run Whisper
+    // again
+    const size_t window_frames = audio.getSampleRate() / 20;  // 50 ms
+    AudioBuffer buffer;
+    std::vector<KeywordSpotter::Detection> detections;
+    TranscriptionSink sink(bus, keyword, alerts);
+    auto on_result = [&sink](const TranscriptionWorkerPool::Result& result) {
+        sink.handle(result);
+    };
+    uint64_t last_overruns = 0;
+    
     while (g_running) {
         // Capture audio
-        AudioBuffer buffer = audio.captureAudio();
+        bool captured;
+        {
+            TRACE_SCOPE("capture.wait");
+            captured = audio.readWindow(buffer, window_frames, 500);
+        }
+        if (!captured) {
+            if (audio.isFinished()) {
+                break;  // A replayed recording ran out
+            }
+            continue;
+        }
+        
+        uint64_t overruns = audio.getOverrunFrames();
+        if (overruns != last_overruns) {
+            std::cerr << "Audio overrun: " << (overruns - last_overruns)
+                      << " frames dropped" << std::endl;
+            last_overruns = overruns;
+        }
+        if (buffer.empty()) {
+            continue;
+        }
         
         // Apply noise reduction
-        buffer = noise.processAudio(buffer);
+        {
+            TRACE_SCOPE("denoise");
+            buffer = noise.processAudio(std::move(buffer));
+        }
         
-        // Convert speech to text
-        std::string text = stt.transcribe(buffer);
+        // One STFT and log-mel pass over the cleaned audio, read by the
+        // keyword spotter, the speech gate and (later) Whisper
+        {
+            TRACE_SCOPE("features");
+            features.process(buffer);
+        }
         
-        if (!text.empty()) {
-            // Check for keywords
-            if (keyword.detectKeywords(text)) {
-                haptic.triggerVibration();
-            }
-            
-            // Update current transcription
-            {
-                std::lock_guard<std::mutex> lock(g_text_mutex);
-                g_current_transcription = text;
-                g_transcription_history.push_back(text);
-                
-                // Limit history size
-                if (g_transcription_history.size() > 100) {
-                    g_transcription_history.erase(g_transcription_history.begin());
-                }
+        // Alert on keywords straight from the audio, before the speech gate
+        // and long before Whisper has decoded them
+        {
+            TRACE_SCOPE("keywords.acoustic");
+            detections.clear();
+            spotter.process(detections);
+            for (const KeywordSpotter::Detection& detection : detections) {
+                alerts.acousticHit(detection.keyword);
             }
         }
         
-        // Sleep briefly to prevent CPU overuse
-        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        // Drop silence before it reaches Whisper
+        VoiceActivityDetector::Result speech;
+        {
+            TRACE_SCOPE("vad");
+            speech = vad.process(std::move(buffer));
+        }
+        
+        // Convert speech to text
+        if (!speech.speech.empty() || speech.segment_end) {
+            TRACE_SCOPE("transcribe.submit");
+            workers.submitStream(transcriber, std::move(speech.speech), speech.segment_end,
+                                 on_result);
+        }
     }
+    
+    audio.stopStreaming();
+    
+    // Flush the last words; the sink must outlive every queued job
+    workers.submitStream(transcriber, AudioBuffer(), true, on_result);
+    workers.waitIdle();
+    
+    if (audio.getOverrunCount() > 0 || audio.getSourceGapCount() > 0 ||
+        audio.getDroppedFrames() > 0) {
+        std::cout << "Capture gaps: " << audio.getOverrunCount() << " ring overruns ("
+                  << audio.getOverrunFrames() << " frames), " << audio.getSourceGapCount()
+                  << " device gaps (" << audio.getSourceLostFrames() << " frames), "
+                  << audio.getDroppedFrames() << " frames dropped in conversion" << std::endl;
+    }
+    
+    const VoiceActivityDetector::Stats& stats = vad.getStats();
+    if (stats.processed_samples > 0) {
+        std::cout << "Voice activity: " << stats.segments << " segments, "
+                  << (100.0 * stats.skipped_samples / stats.processed_samples)
+                  << "% of audio skipped" << std::endl;
+    }
+    
+    const StreamingTranscriber::Stats& stt_stats = transcriber.getStats();
+    if (stt_stats.input_samples > 0) {
+        std::cout << "Transcription: " << stt_stats.decodes << " decodes, "
+                  << (static_cast<double>(stt_stats.decoded_samples) / stt_stats.input_samples)
+                  << " s decoded per second of speech, "
+                  << (stt_stats.decodes ? stt_stats.encoder_frames / stt_stats.decodes : 0)
+                  << " of 1500 encoder frames per decode, "
+                  << stt_stats.mel_decodes << " from shared features" << std::endl;
+    }
+    
+    TranscriptionWorkerPool::Stats pool_stats = workers.getStats();
+    std::cout << "Transcription queue: " << pool_stats.submitted << " jobs, "
+              << pool_stats.coalesced << " coalesced, " << pool_stats.dropped << " dropped"
+              << std::endl;
+    
+    KeywordAlerts::Stats alert_stats = alerts.getStats();
+    std::cout << "Keyword alerts: " << alert_stats.acoustic << " acoustic ("
+              << alert_stats.confirmed << " confirmed by text), " << alert_stats.text_only
+              << " from text only" << std::endl;
+    
+    // Everything has been published; let the other threads drain and exit
+    bus.shutdown();
 }
 
 // Display update thread function
-void displayUpdateThread(Display& display) {
-    while (g_running) {
-        std::string text_to_display;
-        {
-            std::lock_guard<std::mutex> lock(g_text_mutex);
-            text_to_display = g_current_transcription;
+void displayUpdateThread(Display& display, EventBus::Subscriber& events) {
+    Tracer::setThreadName("display");
+    Event event;
+    std::string shown;
+    while (events.wait(event)) {
+        // Only the newest text matters; skip redraws for stale updates
+        Event newer;
+        while (events.poll(newer)) {
+            event = std::move(newer);
         }
+        if (event.text == shown) {
+            continue;
+        }
+        shown = event.text;
         
+        // update() only sends the parts of the panel that changed
+        TRACE_SCOPE("display.update");
         display.clear();
-        display.showText(text_to_display);
+        display.showText(event.text);
         display.update();
-        
-        // Update display at reasonable rate
-        std::this_thread::sleep_for(std::chrono::milliseconds(100));
     }
 }
 
 // Storage thread function
-void storageThread(StorageManager& storage) {
-    std::vector<std::string> last_saved_transcriptions;
+void storageThread(StorageManager& storage, EventBus::Subscriber& events) {
+    Tracer::setThreadName("storage");
     
-    while (g_running) {
-        std::vector<std::string> current_transcriptions;
-        {
-            std::lock_guard<std::mutex> lock(g_text_mutex);
-            current_transcriptions = g_transcription_history;
-        }
-        
-        // Only save new transcriptions
-        if (current_transcriptions.size() > last_saved_transcriptions.size()) {
-            for (size_t i = last_saved_transcriptions.size(); i < current_transcriptions.size(); i++) {
-                storage.saveTranscription(getCurrentTimestamp(), current_transcriptions[i]);
+    // Events only wake us; the history says what is new, so a dropped event
+    // or a full history never loses or repeats a save
+    uint64_t last_saved = 0;
+    std::vector<TranscriptionHistory::Entry> entries;
+    Event event;
+    while (events.wait(event)) {
+        TRACE_SCOPE("storage.save");
+        entries.clear();
+        g_transcription_history.readSince(last_saved, entries);
+        for (const TranscriptionHistory::Entry& entry : entries) {
+            if (entry.sequence != last_saved + 1) {
+                std::cerr << "Transcription history overran storage, "
+                          << (entry.sequence - last_saved - 1) << " segments lost" << std::endl;
             }
-            last_saved_transcriptions = current_transcriptions;
+            storage.saveTranscription(entry.timeUs, entry.text);
+            last_saved = entry.sequence;
         }
         
-        // Check less frequently to save power
-        std::this_thread::sleep_for(std::chrono::seconds(5));
+        // One synced write for the whole batch
+        TRACE_SCOPE("storage.commit");
+        storage.commit();
     }
 }
 
 // Power management thread
-void powerManagementThread(PowerManager& power) {
-    while (g_running) {
-        float battery_level = power.getBatteryLevel();
+void powerManagementThread(PowerManager& power, EventBus& bus, EventBus::Subscriber& events) {
+    Tracer::setThreadName("power");
+    float last_level = -1.0f;
+    Event event;
+    
+    while (!events.closed()) {
+        float battery_level;
+        {
+            TRACE_SCOPE("power.battery");
+            battery_level = power.getBatteryLevel();
+        }
         
         // Switch to low power mode if battery is below threshold
+        bool low_power = g_low_power_mode;
         if (battery_level < 0.2) {  // 20%
-            g_low_power_mode = true;
+            low_power = true;
         } else if (battery_level > 0.3) {  // 30%
-            g_low_power_mode = false;
+            low_power = false;
         }
         
-        power.updatePowerMode(g_low_power_mode);
+        if (low_power != g_low_power_mode || last_level < 0.0f) {
+            g_low_power_mode = low_power;
+            power.updatePowerMode(low_power);
+            
+            Event changed;
+            changed.type = Event::POWER_MODE_CHANGED;
+            changed.low_power = low_power;
+            changed.battery_level = battery_level;
+            bus.publish(std::move(changed));
+        }
+        
+        // Whole percent steps are enough for anyone listening
+        if (static_cast<int>(battery_level * 100) != static_cast<int>(last_level * 100)) {
+            Event changed;
+            changed.type = Event::BATTERY_CHANGED;
+            changed.battery_level = battery_level;
+            changed.low_power = low_power;
+            bus.publish(std::move(changed));
+        }
+        last_level = battery_level;
         
-        // Check battery less frequently
-        std::this_thread::sleep_for(std::chrono::seconds(60));
+        // The battery gauge has no interrupt, so it is still sampled, but
+        // shutdown ends the wait immediately
+        events.wait(event, 60000);
     }
 }
 
 // Connectivity thread (Bluetooth & WiFi)
-void connectivityThread(BluetoothManager& bt, WiFiManager& wifi, StorageManager& storage) {
-    while (g_running) {
+void connectivityThread(BluetoothManager& bt, WiFiManager& wifi, StorageManager& storage,
+                        EventBus::Subscriber& events) {
+    Tracer::setThreadName("connectivity");
+    using Clock = std::chrono::steady_clock;
+    bool bt_pending = false;
+    bool wifi_pending = false;
+    uint64_t bt_synced = 0;       // Last history sequence sent over Bluetooth
+    std::vector<TranscriptionHistory::Entry> entries;
+    Clock::time_point last_attempt;
+    
+    while (true) {
+        // With nothing to sync, sleep until a new segment arrives. Otherwise
+        // retry at the radio interval until the peers are reachable.
+        int timeout_ms = -1;
+        if (bt_pending || wifi_pending) {
+            auto interval = std::chrono::seconds(g_low_power_mode ? 300 : 60);
+            auto elapsed = Clock::now() - last_attempt;
+            timeout_ms = elapsed >= interval ? 0 : static_cast<int>(
+                std::chrono::duration_cast<std::chrono::milliseconds>(interval - elapsed).count());
+        }
+        
+        Event event;
+        if (events.wait(event, timeout_ms)) {
+            if (event.type == Event::SEGMENT_FINISHED) {
+                bt_pending = true;
+                wifi_pending = true;
+            }
+            // Power mode changes only shorten or stretch the retry interval
+            continue;
+        }
+        if (events.closed()) {
+            break;
+        }
+        last_attempt = Clock::now();
+        
         // Handle Bluetooth connections and data sync
-        if (bt.isConnected()) {
+        if (bt_pending && bt.isConnected()) {
+            // Only what the phone has not seen yet
+            TRACE_SCOPE("bluetooth.sync");
+            entries.clear();
+            g_transcription_history.readSince(bt_synced, entries);
             std::vector<std::string> transcriptions;
-            {
-                std::lock_guard<std::mutex> lock(g_text_mutex);
-                transcriptions = g_transcription_history;
+            for (TranscriptionHistory::Entry& entry : entries) {
+                transcriptions.push_back(std::move(entry.text));
+            }
+            if (!entries.empty()) {
+                bt.syncTranscriptions(transcriptions);
+                bt_synced = entries.back().sequence;
             }
-            bt.syncTranscriptions(transcriptions);
+            bt_pending = false;
         }
         
         // Handle WiFi backup if enabled and connected
-        if (wifi.isEnabled() && wifi.isConnected()) {
+        if (wifi_pending && wifi.isEnabled() && wifi.isConnected()) {
+            TRACE_SCOPE("wifi.backup");
             wifi.backupTranscriptions(storage.getUnsyncedTranscriptions());
             storage.markTranscriptionsAsSynced();
+            wifi_pending = false;
+        }
+    }
+}
+
+// Acoustic keyword templates, enrolled with --enroll
+static const char* kKeywordTemplatesPath = "/home/pi/keyword_templates.bin";
+
+// Longest keyword example accepted, in 16 kHz samples
+static const size_t kMaxExampleSamples = 16000 * 4;
+
+// Runs a recorded example through the same capture and noise reduction as
+// the live stream, so the template matches what the spotter will hear
+static bool loadKeywordExample(const std::string& path, AudioBlockPool& pool,
+                               AudioBuffer& example) {
+    AudioCapture capture(pool, std::unique_ptr<CaptureSource>(
+        new ReplayCaptureSource(path, ReplayCaptureSource::FAST)));
+    capture.setSampleRate(16000);
+    NoiseReduction noise;
+    noise.enableAdaptiveMode(true);
+    
+    example = pool.acquire(kMaxExampleSamples);
+    if (!example.valid() || !capture.startStreaming()) {
+        return false;
+    }
+    example.resize(0);
+    example.sampleRate = 16000;
+    example.channels = 1;
+    
+    AudioBuffer buffer;
+    while (capture.readWindow(buffer, 800)) {
+        if (buffer.empty()) {
+            continue;
+        }
+        buffer = noise.processAudio(std::move(buffer));
+        if (example.append(buffer.data(), buffer.size()) < buffer.size()) {
+            std::cerr << path << " is longer than " << kMaxExampleSamples / 16000
+                      << " s; using the start" << std::endl;
+            break;
+        }
+    }
+    return !example.empty();
+}
+
+// `--enroll <keyword> <wav>...`: adds the wearer's recorded examples of a
+// keyword to the acoustic templates. Run once per keyword; two or more
+// examples let the spotter calibrate each template's threshold.
+static int enrollKeyword(const std::string& keyword, const std::vector<std::string>& paths) {
+    try {
+        AudioBlockPool pool({{8, 16384}, {1, kMaxExampleSamples}});
+        
+        // The templates are only comparable with the live features when the
+        // mel layout matches the model's
+        SpeechToText stt("whisper");
+        FeatureExtractor features(16000, stt.getMelBands());
+        KeywordSpotter spotter(features);
+        if (spotter.loadTemplates(kKeywordTemplatesPath)) {
+            std::cout << "Adding to " << spotter.getTemplateCount() << " enrolled templates"
+                      << std::endl;
         }
         
-        // Check connectivity less frequently to save power
-        std::this_thread::sleep_for(std::chrono::seconds(g_low_power_mode ? 300 : 60));
+        size_t enrolled = 0;
+        for (const std::string& path : paths) {
+            AudioBuffer example;
+            bool loaded = false;
+            try {
+                loaded = loadKeywordExample(path, pool, example);
+            } catch (const std::exception& e) {
+                std::cerr << "Skipping " << path << ": " << e.what() << std::endl;
+                continue;
+            }
+            if (!loaded) {
+                std::cerr << "No audio in " << path << std::endl;
+            } else if (spotter.enroll(keyword, example)) {
+                enrolled++;
+            }
+        }
+        if (enrolled == 0) {
+            std::cerr << "No usable examples of \"" << keyword << "\"" << std::endl;
+            return 1;
+        }
+        if (!spotter.saveTemplates(kKeywordTemplatesPath)) {
+            std::cerr << "Failed to write " << kKeywordTemplatesPath << std::endl;
+            return 1;
+        }
+        std::cout << "Enrolled " << enrolled << " of " << paths.size() << " examples of \""
+                  << keyword << "\"" << std::endl;
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
     }
+    return 0;
 }
 
-int main() {
+int main(int argc, char** argv) {
     // Register signal handler
     signal(SIGINT, signalHandler);
     
+    if (argc > 3 && std::string(argv[1]) == "--enroll") {
+        return enrollKeyword(argv[2], std::vector<std::string>(argv + 3, argv + argc));
+    }
+    
+    // `kill -USR1` writes the recent per-thread trace for chrome://tracing
+    // or ui.perfetto.dev
+    std::unique_ptr<TraceSignalDumper> trace_dumper;
+    try {
+        trace_dumper.reset(new TraceSignalDumper(SIGUSR1, "/home/pi/trace"));
+    } catch (const std::exception& e) {
+        std::cerr << "Tracing dump unavailable: " << e.what() << std::endl;
+    }
+    
     std::cout << "Initializing wearable transcription system..." << std::endl;
     
     try {
-        // Initialize hardware components
-        AudioCapture audio(44100, 1);  // 44.1kHz, mono
+        // Preallocated sample memory for the capture -> denoise -> STT path
+        AudioBlockPool buffer_pool({{32, 16384}});
+        
+        // Initialize hardware components. `--replay <file>` feeds a recording
+        // through the pipeline in real time instead of the microphone.
+        std::unique_ptr<CaptureSource> source;
+        if (argc > 2 && std::string(argv[1]) == "--replay") {
+            source.reset(new ReplayCaptureSource(argv[2], ReplayCaptureSource::REALTIME));
+        } else {
+            // Mono at the codec's native rate (44.1 kHz preferred); 20 ms
+            // periods match AudioCapture's streaming period, with 80 ms of
+            // DMA buffer to absorb scheduling delays
+            source.reset(new AlsaCaptureSource("hw:1,0", 44100, 1, 20, 4));
+        }
+        AudioCapture audio(buffer_pool, std::move(source));
+        
+        // The device stays at its own rate; capture converts to Whisper's
+        // 16 kHz before any further processing
+        audio.setSampleRate(16000);
+        
         Display display(128, 64);      // 128x64 OLED
         HapticFeedback haptic;
         PowerManager power;
@@ -186,24 +678,59 @@ int main() {
         
         // Initialize processing modules
         NoiseReduction noise;
+        noise.enableAdaptiveMode(true);  // Follow the noise floor as the wearer moves around
         SpeechToText stt("whisper");  // Using OpenAI Whisper
+        
+        // Log-mel in the model's layout, with 30 s of history so queued
+        // decodes can still pick up the frames of their window
+        FeatureExtractor features(16000, stt.getMelBands(), 3000);
+        VoiceActivityDetector vad(buffer_pool, features);
+        StreamingTranscriber transcriber(stt, 500, 5000, 200);  // 0.5 s step, 5 s window
+        transcriber.setFeatureSource(&features);
+        
+        // One stream only ever runs on one worker at a time, so a single
+        // worker gets all the cores. When it falls behind, queued speech is
+        // merged and decoded in one pass instead of piling up.
+        TranscriptionWorkerPool transcription_workers(stt, buffer_pool, 1, 8,
+                                                      TranscriptionWorkerPool::COALESCE);
         KeywordDetector keyword({"emergency", "help", "alert"});  // Example keywords
-        StorageManager storage("/home/pi/transcriptions");
+        
+        // Acoustic templates are recorded per wearer; their names should
+        // match the keywords above so Whisper can confirm the hits
+        KeywordSpotter spotter(features);
+        if (!spotter.loadTemplates(kKeywordTemplatesPath)) {
+            std::cout << "No keyword templates enrolled (see --enroll); keyword alerts wait "
+                         "for transcription" << std::endl;
+        }
+        StorageManager storage("/home/pi/transcriptions");  // Append-only log segments
+        
+        // Threads block on their mailbox instead of polling shared state
+        EventBus bus;
+        KeywordAlerts alerts(bus, haptic);
+        EventBus::Subscriber& display_events = bus.subscribe({Event::TRANSCRIPTION_UPDATED}, 8);
+        EventBus::Subscriber& storage_events = bus.subscribe({Event::SEGMENT_FINISHED});
+        EventBus::Subscriber& power_events = bus.subscribe({});
+        EventBus::Subscriber& connectivity_events =
+            bus.subscribe({Event::SEGMENT_FINISHED, Event::POWER_MODE_CHANGED});
         
         std::cout << "System initialized. Starting processing threads..." << std::endl;
         
         // Start processing threads
         std::thread audio_thread(audioProcessingThread, 
-                                std::ref(audio), std::ref(stt), 
-                                std::ref(noise), std::ref(keyword),
-                                std::ref(haptic));
+                                std::ref(audio),
+                                std::ref(noise), std::ref(features), std::ref(vad),
+                                std::ref(transcriber),
+                                std::ref(transcription_workers), std::ref(spotter),
+                                std::ref(bus), std::ref(keyword), std::ref(alerts));
         
-        std::thread display_thread(displayUpdateThread, std::ref(display));
-        std::thread storage_thread(storageThread, std::ref(storage));
-        std::thread power_thread(powerManagementThread, std::ref(power));
+        std::thread display_thread(displayUpdateThread, std::ref(display),
+                                   std::ref(display_events));
+        std::thread storage_thread(storageThread, std::ref(storage), std::ref(storage_events));
+        std::thread power_thread(powerManagementThread, std::ref(power), std::ref(bus),
+                                 std::ref(power_events));
         std::thread connectivity_thread(connectivityThread, 
                                       std::ref(bluetooth), std::ref(wifi), 
-                                      std::ref(storage));
+                                      std::ref(storage), std::ref(connectivity_events));
         
         std::cout << "System running. Press Ctrl+C to exit." << std::endl;
         
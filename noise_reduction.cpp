@@ -0,0 +1,208 @@
+#include "noise_reduction.h"
+#include <iostream>
+#include <stdexcept>
+#include <algorithm>
+#include <cmath>
+#include "fft.h"
+#include "dsp_kernels.h"
+
+NoiseReduction::NoiseReduction(int fft_size)
+    : reduction_level(0.5f), adaptive_mode(false), noise_tracker(fft_size / 2 + 1),
+      fft_handle(nullptr),
+      fft_size(fft_size), hop_size(fft_size / 2), input_fill(0) {
+    if (!initializeFFT()) {
+        throw std::runtime_error("Failed to initialize FFT for noise reduction");
+    }
+}
+
+NoiseReduction::~NoiseReduction() {
+    cleanupFFT();
+}
+
+bool NoiseReduction::initializeFFT() {
+    cleanupFFT();
+
+    try {
+        fft_handle = new FFTPlan(fft_size);
+    } catch (const std::exception& e) {
+        std::cerr << "Cannot create FFT plan: " << e.what() << std::endl;
+        return false;
+    }
+
+    // Periodic sqrt-Hann: applied on analysis and synthesis, its square sums
+    // to one at 50% overlap, so unmodified frames reconstruct exactly
+    const double pi = 3.14159265358979323846;
+    window.resize(fft_size);
+    for (int i = 0; i < fft_size; i++) {
+        window[i] = static_cast<float>(std::sqrt(0.5 - 0.5 * std::cos(2.0 * pi * i / fft_size)));
+    }
+
+    input_frame.assign(fft_size, 0.0f);
+    frame.assign(fft_size, 0.0f);
+    spectrum.assign(fft_handle->bins(), std::complex<float>(0.0f, 0.0f));
+    power.assign(fft_handle->bins(), 0.0f);
+    output_accum.assign(fft_size, 0.0f);
+    output_ready.assign(hop_size, 0.0f);
+    input_fill = 0;
+    return true;
+}
+
+void NoiseReduction::reset() {
+    std::fill(input_frame.begin(), input_frame.end(), 0.0f);
+    std::fill(output_accum.begin(), output_accum.end(), 0.0f);
+    std::fill(output_ready.begin(), output_ready.end(), 0.0f);
+    input_fill = 0;
+}
+
+void NoiseReduction::cleanupFFT() {
+    delete fft_handle;
+    fft_handle = nullptr;
+}
+
+void NoiseReduction::setReductionLevel(float level) {
+    reduction_level = std::min(std::max(level, 0.0f), 1.0f);
+}
+
+void NoiseReduction::enableAdaptiveMode(bool enable) {
+    if (enable && !adaptive_mode) {
+        if (noise_psd.empty()) {
+            noise_tracker.reset();
+        } else {
+            noise_tracker.seed(noise_psd);
+        }
+    }
+    adaptive_mode = enable;
+}
+
+void NoiseReduction::setNoiseProfile(const AudioBuffer& profile) {
+    if (profile.channels != 1 || profile.frames() < static_cast<size_t>(fft_size)) {
+        std::cerr << "Noise profile needs at least " << fft_size << " mono samples" << std::endl;
+        return;
+    }
+
+    // Average the power spectrum over every full frame of the profile
+    std::vector<float> psd(fft_handle->bins(), 0.0f);
+    const int16_t* samples = profile.data();
+    size_t frames = 0;
+    for (size_t start = 0; start + fft_size <= profile.size(); start += hop_size) {
+        convertS16ToF32(samples + start, frame.data(), fft_size);
+        for (int i = 0; i < fft_size; i++) {
+            frame[i] *= window[i];
+        }
+        fft_handle->forward(frame.data(), spectrum.data());
+        for (size_t k = 0; k < psd.size(); k++) {
+            psd[k] += std::norm(spectrum[k]);
+        }
+        frames++;
+    }
+    for (float& value : psd) {
+        value /= frames;
+    }
+    noise_psd.swap(psd);
+
+    if (adaptive_mode) {
+        noise_tracker.seed(noise_psd);
+    }
+}
+
+AudioBuffer NoiseReduction::processAudio(AudioBuffer&& input) {
+    if (!input.valid() || input.empty()) {
+        return std::move(input);
+    }
+    if (input.channels != 1) {
+        std::cerr << "Noise reduction only handles mono audio" << std::endl;
+        return std::move(input);
+    }
+    if (input.isShared()) {
+        std::cerr << "Noise reduction skipped: buffer is shared and cannot be modified in place"
+                  << std::endl;
+        return std::move(input);
+    }
+
+    // Overlap-adding across lost frames would smear the audio on both sides
+    // together; the tail still in flight is dropped instead
+    if (input.discontinuity) {
+        reset();
+    }
+
+    int16_t* samples = input.data();
+    size_t remaining = input.size();
+
+    while (remaining > 0) {
+        size_t count = std::min(remaining, static_cast<size_t>(hop_size - input_fill));
+
+        // Stage the new input into the tail of the analysis frame before the
+        // same samples are overwritten with output
+        convertS16ToF32(samples, &input_frame[fft_size - hop_size + input_fill], count);
+        convertF32ToS16(&output_ready[input_fill], samples, count);
+
+        input_fill += static_cast<int>(count);
+        samples += count;
+        remaining -= count;
+
+        if (input_fill == hop_size) {
+            processFrame();
+            input_fill = 0;
+        }
+    }
+
+    // Every output sample is exactly fft_size samples older than the input
+    // sample it replaced
+    uint64_t latency = static_cast<uint64_t>(fft_size);
+    input.startFrame = input.startFrame > latency ? input.startFrame - latency : 0;
+    if (input.sampleRate > 0) {
+        input.timestampUs -= static_cast<int64_t>(latency * 1000000ULL / input.sampleRate);
+    }
+    return std::move(input);
+}
+
+void NoiseReduction::processFrame() {
+    for (int i = 0; i < fft_size; i++) {
+        frame[i] = input_frame[i] * window[i];
+    }
+    fft_handle->forward(frame.data(), spectrum.data());
+
+    for (size_t k = 0; k < spectrum.size(); k++) {
+        power[k] = std::norm(spectrum[k]);
+    }
+    if (adaptive_mode) {
+        updateNoiseProfile();
+    }
+
+    spectralSubtraction();
+
+    fft_handle->inverse(spectrum.data(), frame.data());
+    for (int i = 0; i < fft_size; i++) {
+        output_accum[i] += frame[i] * window[i];
+    }
+
+    // The first hop of the accumulator has now received both of its
+    // overlapping frames; hand it out and slide everything down
+    std::copy(output_accum.begin(), output_accum.begin() + hop_size, output_ready.begin());
+    std::copy(output_accum.begin() + hop_size, output_accum.end(), output_accum.begin());
+    std::fill(output_accum.end() - hop_size, output_accum.end(), 0.0f);
+    std::copy(input_frame.begin() + hop_size, input_frame.end(), input_frame.begin());
+}
+
+void NoiseReduction::updateNoiseProfile() {
+    noise_tracker.update(power.data());
+}
+
+void NoiseReduction::spectralSubtraction() {
+    const std::vector<float>& noise = adaptive_mode ? noise_tracker.noisePower() : noise_psd;
+    if (noise.empty() || reduction_level <= 0.0f) {
+        return;
+    }
+
+    // Power subtraction with over-subtraction and a spectral floor that both
+    // scale with the reduction level: level 1 subtracts twice the noise
+    // estimate and allows up to 30 dB of attenuation
+    const float over_subtraction = 1.0f + reduction_level;
+    const float floor_gain = std::pow(10.0f, -1.5f * reduction_level);
+    const float floor_power = floor_gain * floor_gain;
+
+    for (size_t k = 0; k < spectrum.size(); k++) {
+        float gain_power = 1.0f - over_subtraction * noise[k] / (power[k] + 1e-12f);
+        spectrum[k] *= std::sqrt(std::max(gain_power, floor_power));
+    }
+}
@@ -1,35 +1,72 @@
 #ifndef NOISE_REDUCTION_H
 #define NOISE_REDUCTION_H
 
-#include "audio_capture.h"
+#include <vector>
+#include <complex>
+#include "audio_buffer.h"
+#include "noise_tracker.h"
 
+class FFTPlan;
+
+// Streaming spectral-subtraction denoiser. Audio is analysed in sqrt-Hann
+// windowed frames with 50% overlap and resynthesised by overlap-add, with the
+// frame state carried across calls, so any sequence of chunk sizes produces
+// the same seamless output. The output lags the input by fft_size samples;
+// buffer timestamps are shifted to match.
 class NoiseReduction {
 public:
-    NoiseReduction();
+    NoiseReduction(int fft_size = 512);
     ~NoiseReduction();
-    
-    AudioBuffer processAudio(const AudioBuffer& input);
+
+    // Works in place on the pooled block and hands the same buffer back
+    AudioBuffer processAudio(AudioBuffer&& input);
     void setNoiseProfile(const AudioBuffer& noise_profile);
     void setReductionLevel(float level);
+
+    // Tracks the noise floor continuously from the signal itself. A profile
+    // set with setNoiseProfile() is used as the starting point.
     void enableAdaptiveMode(bool enable);
-    
+
+    int getLatencySamples() const { return fft_size; }
+
+    // Drops the frames in flight, keeping the noise estimate. processAudio()
+    // does this itself for buffers marked as a discontinuity.
+    void reset();
+
 private:
     float reduction_level;
     bool adaptive_mode;
-    AudioBuffer noise_profile;
-    
+
+    // Per-bin noise power from setNoiseProfile(); empty until one is set
+    std::vector<float> noise_psd;
+    NoiseTracker noise_tracker;
+
     // FFT-related members
-    void* fft_handle;
+    FFTPlan* fft_handle;
     int fft_size;
-    
+    int hop_size;
+
+    // Streaming state, all sized once in initializeFFT()
+    std::vector<float> window;                  // sqrt-Hann, analysis and synthesis
+    std::vector<float> input_frame;             // Last fft_size input samples
+    std::vector<float> frame;                   // Windowed frame / synthesis output
+    std::vector<std::complex<float>> spectrum;
+    std::vector<float> power;
+    std::vector<float> output_accum;            // Overlap-add accumulator
+    std::vector<float> output_ready;            // Finished hop being played out
+    int input_fill;                             // New samples since the last frame
+
     bool initializeFFT();
     void cleanupFFT();
-    
-    // Spectral subtraction method
-    AudioBuffer spectralSubtraction(const AudioBuffer& input);
-    
-    // Adaptive noise estimation
-    void updateNoiseProfile(const AudioBuffer& input);
+
+    // Runs one analysis/synthesis frame over input_frame
+    void processFrame();
+
+    // Spectral subtraction method, in place on `spectrum`
+    void spectralSubtraction();
+
+    // Adaptive noise estimation, once per frame from `power`
+    void updateNoiseProfile();
 };
 
-#endif // NOISE_REDUCTION_H 
\ No newline at end of file
+#endif // NOISE_REDUCTION_H
\ No newline at end of file
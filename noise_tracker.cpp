@@ -0,0 +1,74 @@
+#include "noise_tracker.h"
+#include <algorithm>
+
+// Smoothing constants from the MCRA paper, tuned for ~16 ms hops
+static const float kPowerSmoothing = 0.8f;     // alpha_s
+static const float kPresenceSmoothing = 0.2f;  // alpha_p
+static const float kNoiseSmoothing = 0.95f;    // alpha_d
+static const float kPresenceRatio = 5.0f;      // delta: S/S_min above this means speech
+
+NoiseTracker::NoiseTracker(int bins, int window_frames)
+    : num_bins(bins), window_frames(std::max(window_frames, 2)), frame_count(0),
+      initialized(false),
+      smoothed(bins, 0.0f), minimum(bins, 0.0f), window_min(bins, 0.0f),
+      presence(bins, 0.0f), noise(bins, 0.0f) {
+}
+
+void NoiseTracker::reset() {
+    std::fill(presence.begin(), presence.end(), 0.0f);
+    frame_count = 0;
+    initialized = false;
+}
+
+void NoiseTracker::seed(const std::vector<float>& noise_power) {
+    if (static_cast<int>(noise_power.size()) != num_bins) {
+        return;
+    }
+    noise = noise_power;
+    smoothed = noise_power;
+    minimum = noise_power;
+    window_min = noise_power;
+    std::fill(presence.begin(), presence.end(), 0.0f);
+    frame_count = 0;
+    initialized = true;
+}
+
+void NoiseTracker::update(const float* power) {
+    if (!initialized) {
+        for (int k = 0; k < num_bins; k++) {
+            smoothed[k] = minimum[k] = window_min[k] = noise[k] = power[k];
+        }
+        initialized = true;
+        return;
+    }
+
+    for (int k = 0; k < num_bins; k++) {
+        // Smooth across neighbouring bins with a [0.25 0.5 0.25] kernel,
+        // then recursively over time
+        float left = power[k > 0 ? k - 1 : k];
+        float right = power[k + 1 < num_bins ? k + 1 : k];
+        float local = 0.25f * left + 0.5f * power[k] + 0.25f * right;
+        smoothed[k] = kPowerSmoothing * smoothed[k] + (1.0f - kPowerSmoothing) * local;
+
+        minimum[k] = std::min(minimum[k], smoothed[k]);
+        window_min[k] = std::min(window_min[k], smoothed[k]);
+
+        // Speech is likely where the smoothed power sits well above the floor
+        float indicator = smoothed[k] > kPresenceRatio * minimum[k] ? 1.0f : 0.0f;
+        presence[k] = kPresenceSmoothing * presence[k] + (1.0f - kPresenceSmoothing) * indicator;
+
+        // Noise adapts quickly in noise-only bins and freezes during speech
+        float alpha = kNoiseSmoothing + (1.0f - kNoiseSmoothing) * presence[k];
+        noise[k] = alpha * noise[k] + (1.0f - alpha) * power[k];
+    }
+
+    // Restart the minimum search each window so the floor can rise again
+    // when the environment gets louder
+    if (++frame_count >= window_frames) {
+        for (int k = 0; k < num_bins; k++) {
+            minimum[k] = std::min(window_min[k], smoothed[k]);
+            window_min[k] = smoothed[k];
+        }
+        frame_count = 0;
+    }
+}
@@ -0,0 +1,40 @@
+#ifndef NOISE_TRACKER_H
+#define NOISE_TRACKER_H
+
+#include <vector>
+
+// Per-bin noise floor tracker in the STFT domain (minima controlled
+// recursive averaging, Cohen & Berdugo 2002). Each update() costs O(bins) and
+// keeps only a handful of running values per bin, never past audio, so it can
+// follow the noise floor indefinitely as the environment changes.
+class NoiseTracker {
+public:
+    // `window_frames` is the span over which the minimum is searched; it
+    // should cover the longest stretch of continuous speech (about 1 s)
+    NoiseTracker(int bins, int window_frames = 64);
+
+    // Feeds one frame of power spectrum (bins() values)
+    void update(const float* power);
+
+    // Starts tracking from a known noise spectrum instead of the next frame
+    void seed(const std::vector<float>& noise_power);
+    void reset();
+
+    int bins() const { return num_bins; }
+    const std::vector<float>& noisePower() const { return noise; }
+    const std::vector<float>& speechPresence() const { return presence; }
+
+private:
+    int num_bins;
+    int window_frames;
+    int frame_count;
+    bool initialized;
+
+    std::vector<float> smoothed;      // S: time/frequency smoothed power
+    std::vector<float> minimum;       // S_min over the current window
+    std::vector<float> window_min;    // S_tmp: running minimum of the next window
+    std::vector<float> presence;      // Speech presence probability
+    std::vector<float> noise;         // Noise power estimate
+};
+
+#endif // NOISE_TRACKER_H
@@ -0,0 +1,119 @@
+#include "replay_capture_source.h"
+#include <iostream>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+#include <thread>
+#include <algorithm>
+#include <cstring>
+
+static uint32_t readLE32(const char* p) {
+    const unsigned char* u = reinterpret_cast<const unsigned char*>(p);
+    return u[0] | (u[1] << 8) | (u[2] << 16) | (static_cast<uint32_t>(u[3]) << 24);
+}
+
+static uint16_t readLE16(const char* p) {
+    const unsigned char* u = reinterpret_cast<const unsigned char*>(p);
+    return static_cast<uint16_t>(u[0] | (u[1] << 8));
+}
+
+ReplayCaptureSource::ReplayCaptureSource(const std::string& path, Pacing pacing,
+                                         int raw_sample_rate, int raw_channels)
+    : pacing(pacing), sample_rate(raw_sample_rate), channels(raw_channels),
+      total_frames(0), position(0), started(false) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+        throw std::runtime_error("Cannot open replay file: " + path);
+    }
+    std::vector<char> data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+    bool is_wav = data.size() >= 12 && std::memcmp(data.data(), "RIFF", 4) == 0 &&
+                  std::memcmp(data.data() + 8, "WAVE", 4) == 0;
+    if (is_wav) {
+        if (!parseWav(data)) {
+            throw std::runtime_error("Unsupported WAV file: " + path);
+        }
+    } else {
+        if (sample_rate <= 0 || channels <= 0) {
+            throw std::invalid_argument("Invalid raw replay format");
+        }
+        samples.resize(data.size() / sizeof(int16_t));
+        for (size_t i = 0; i < samples.size(); i++) {
+            samples[i] = static_cast<int16_t>(readLE16(&data[i * 2]));
+        }
+    }
+
+    total_frames = samples.size() / channels;
+    samples.resize(total_frames * channels);
+}
+
+bool ReplayCaptureSource::parseWav(const std::vector<char>& data) {
+    bool have_format = false;
+    size_t pos = 12;
+    while (pos + 8 <= data.size()) {
+        const char* chunk = &data[pos];
+        size_t length = readLE32(chunk + 4);
+        size_t body = pos + 8;
+        size_t available = std::min(length, data.size() - body);
+
+        if (std::memcmp(chunk, "fmt ", 4) == 0 && available >= 16) {
+            uint16_t format = readLE16(&data[body]);
+            uint16_t bits = readLE16(&data[body + 14]);
+            // WAVE_FORMAT_PCM, or WAVE_FORMAT_EXTENSIBLE wrapping it
+            if ((format != 1 && format != 0xFFFE) || bits != 16) {
+                std::cerr << "Replay supports 16-bit PCM only (format " << format
+                          << ", " << bits << " bits)" << std::endl;
+                return false;
+            }
+            channels = readLE16(&data[body + 2]);
+            sample_rate = static_cast<int>(readLE32(&data[body + 4]));
+            have_format = channels > 0 && sample_rate > 0;
+        } else if (std::memcmp(chunk, "data", 4) == 0) {
+            if (!have_format) {
+                std::cerr << "WAV data chunk precedes its format chunk" << std::endl;
+                return false;
+            }
+            samples.resize(available / sizeof(int16_t));
+            for (size_t i = 0; i < samples.size(); i++) {
+                samples[i] = static_cast<int16_t>(readLE16(&data[body + i * 2]));
+            }
+            return true;
+        }
+
+        // Nothing follows a chunk that runs past the end of the file, and
+        // stepping over its length could wrap a 32-bit size_t
+        if (length > data.size() - body) {
+            break;
+        }
+        // Chunks are padded to an even length
+        pos = body + length + (length & 1);
+    }
+    std::cerr << "WAV file has no data chunk" << std::endl;
+    return false;
+}
+
+size_t ReplayCaptureSource::read(int16_t* dest, size_t frames) {
+    frames = std::min(frames, total_frames - position);
+    if (frames == 0) {
+        return 0;
+    }
+
+    if (pacing == REALTIME) {
+        if (!started) {
+            start_time = std::chrono::steady_clock::now();
+            started = true;
+        }
+        // A device hands a period over once its last frame was captured
+        uint64_t end_us = static_cast<uint64_t>(position + frames) * 1000000 / sample_rate;
+        std::this_thread::sleep_until(start_time + std::chrono::microseconds(end_us));
+    }
+
+    std::memcpy(dest, &samples[position * channels], frames * channels * sizeof(int16_t));
+    position += frames;
+    return frames;
+}
+
+void ReplayCaptureSource::rewind() {
+    position = 0;
+    started = false;
+}
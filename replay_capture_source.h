@@ -0,0 +1,48 @@
+#ifndef REPLAY_CAPTURE_SOURCE_H
+#define REPLAY_CAPTURE_SOURCE_H
+
+#include <string>
+#include <vector>
+#include <chrono>
+#include "capture_source.h"
+
+// Plays a recording back through AudioCapture in place of the microphone.
+// 16-bit PCM WAV files carry their own format; anything else is read as raw
+// interleaved S16 little-endian at the format given to the constructor.
+class ReplayCaptureSource : public CaptureSource {
+public:
+    enum Pacing {
+        REALTIME,   // Frames arrive at the recording's rate, like a device
+        FAST        // Frames arrive as fast as they are read
+    };
+
+    ReplayCaptureSource(const std::string& path, Pacing pacing = REALTIME,
+                        int raw_sample_rate = 16000, int raw_channels = 1);
+
+    int getSampleRate() const { return sample_rate; }
+    int getChannels() const { return channels; }
+
+    size_t read(int16_t* dest, size_t frames);
+    bool isFinished() const { return position >= total_frames; }
+    bool isLive() const { return false; }
+
+    // Length of the whole recording in frames
+    size_t getTotalFrames() const { return total_frames; }
+
+    // Starts the recording over from the beginning
+    void rewind();
+
+private:
+    Pacing pacing;
+    int sample_rate;
+    int channels;
+    std::vector<int16_t> samples;
+    size_t total_frames;
+    size_t position;
+    bool started;
+    std::chrono::steady_clock::time_point start_time;
+
+    bool parseWav(const std::vector<char>& data);
+};
+
+#endif // REPLAY_CAPTURE_SOURCE_H
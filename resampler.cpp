@@ -0,0 +1,273 @@
+#include "resampler.h"
+#include <iostream>
+#include <stdexcept>
+#include <algorithm>
+#include <numeric>
+#include <cstring>
+#include <cmath>
+#include "dsp_kernels.h"
+
+// Filter design, usable in constant expressions so the common banks are baked
+// into the binary instead of being computed at startup
+
+static constexpr double kPi = 3.14159265358979323846;
+
+// Kaiser beta for roughly 70 dB of stopband attenuation
+static constexpr double kKaiserBeta = 6.76;
+
+static constexpr double constexprSin(double x) {
+    // Reduce to [-pi, pi] so the series converges quickly
+    double turns = x / (2.0 * kPi);
+    long long whole = static_cast<long long>(turns >= 0 ? turns + 0.5 : turns - 0.5);
+    x -= static_cast<double>(whole) * 2.0 * kPi;
+
+    double term = x;
+    double sum = x;
+    for (int k = 1; k < 20; k++) {
+        term *= -x * x / ((2.0 * k) * (2.0 * k + 1.0));
+        sum += term;
+    }
+    return sum;
+}
+
+static constexpr double constexprSqrt(double x) {
+    if (x <= 0.0) {
+        return 0.0;
+    }
+    double guess = x > 1.0 ? x : 1.0;
+    for (int i = 0; i < 64; i++) {
+        guess = 0.5 * (guess + x / guess);
+    }
+    return guess;
+}
+
+// Zeroth-order modified Bessel function of the first kind, for the window
+static constexpr double besselI0(double x) {
+    double sum = 1.0;
+    double term = 1.0;
+    for (int k = 1; k < 64; k++) {
+        double half = x / (2.0 * k);
+        term *= half * half;
+        sum += term;
+        if (term < sum * 1e-16) {
+            break;
+        }
+    }
+    return sum;
+}
+
+// Fills `out` with up * kTapsPerPhase coefficients: the Kaiser-windowed sinc
+// prototype at the upsampled rate, split into `up` phases with each phase's
+// taps reversed and scaled by `up` for unity passband gain
+static constexpr void fillPolyphaseBank(int up, int down, float* out) {
+    const int taps = Resampler::kTapsPerPhase;
+    const int length = up * taps;
+    // Cutoff 10% below the lower Nyquist frequency, in cycles per upsampled
+    // sample. A 64-tap filter's transition band is about that wide, so what
+    // lies above Nyquist is attenuated before it can fold back into the top
+    // of the output band.
+    const double cutoff = 0.45 / (up > down ? up : down);
+    const double center = (length - 1) / 2.0;
+    const double window_norm = besselI0(kKaiserBeta);
+
+    for (int p = 0; p < up; p++) {
+        for (int j = 0; j < taps; j++) {
+            int k = (taps - 1 - j) * up + p;
+            double t = k - center;
+            double sinc = (t == 0.0) ? 2.0 * cutoff
+                                     : constexprSin(2.0 * kPi * cutoff * t) / (kPi * t);
+            double r = t / center;
+            double window = besselI0(kKaiserBeta * constexprSqrt(1.0 - r * r)) / window_norm;
+            out[p * taps + j] = static_cast<float>(sinc * window * up);
+        }
+    }
+}
+
+template <int Up, int Down>
+struct PolyphaseBank {
+    float taps[Up * Resampler::kTapsPerPhase];
+
+    constexpr PolyphaseBank() : taps() {
+        fillPolyphaseBank(Up, Down, taps);
+    }
+};
+
+static constexpr PolyphaseBank<160, 441> kBank44100To16000;
+static constexpr PolyphaseBank<1, 3> kBank48000To16000;
+static constexpr PolyphaseBank<1, 2> kBank32000To16000;
+
+Resampler::Resampler(AudioBlockPool& pool, int input_rate, int output_rate, size_t max_chunk)
+    : pool(pool), input_rate(input_rate), output_rate(output_rate), up(1), down(1),
+      bank(nullptr), history_fill(0), position(0), phase(0), max_chunk(max_chunk),
+      history_start_frame(0), next_input_frame(0), started(false) {
+    if (input_rate <= 0 || output_rate <= 0 || max_chunk == 0) {
+        throw std::invalid_argument("Resampler needs positive rates and chunk size");
+    }
+
+    int divisor = std::gcd(input_rate, output_rate);
+    up = output_rate / divisor;
+    down = input_rate / divisor;
+
+    // Keep the bank small and make sure one output never skips past the
+    // context the history keeps
+    if (up > 1024 || down / up >= kTapsPerPhase) {
+        throw std::invalid_argument("Unsupported resampling ratio " + std::to_string(input_rate) +
+                                    " -> " + std::to_string(output_rate));
+    }
+
+    if (up == 160 && down == 441) {
+        bank = kBank44100To16000.taps;
+    } else if (up == 1 && down == 3) {
+        bank = kBank48000To16000.taps;
+    } else if (up == 1 && down == 2) {
+        bank = kBank32000To16000.taps;
+    } else {
+        runtime_bank.resize(static_cast<size_t>(up) * kTapsPerPhase);
+        fillPolyphaseBank(up, down, runtime_bank.data());
+        bank = runtime_bank.data();
+    }
+
+    // Room for the context, up to kTapsPerPhase samples left unconsumed by
+    // prime(), and one chunk
+    history.resize(2 * kTapsPerPhase - 1 + max_chunk);
+    output_scratch.resize(((kTapsPerPhase + max_chunk) * up) / down + 2);
+    reset();
+}
+
+size_t Resampler::maxOutput(size_t input_count) const {
+    // Samples prime() left past the next output produce output too
+    size_t unconsumed = history_fill > position ? history_fill - position : 0;
+    return ((unconsumed + input_count) * up) / down + 2;
+}
+
+void Resampler::reset() {
+    std::fill(history.begin(), history.end(), 0.0f);
+    history_fill = kTapsPerPhase - 1;
+    position = kTapsPerPhase - 1;
+    phase = 0;
+    history_start_frame = 0;
+    next_input_frame = 0;
+    started = false;
+}
+
+double Resampler::getNextOutputTime() const {
+    return static_cast<double>(history_start_frame + static_cast<int64_t>(position)) +
+           static_cast<double>(phase) / up - (kTapsPerPhase * up - 1) / (2.0 * up);
+}
+
+void Resampler::prime(const int16_t* in, size_t count, uint64_t next_frame, double next_output) {
+    reset();
+    count = std::min<size_t>(count, std::min<uint64_t>(kTapsPerPhase, next_frame));
+    history_start_frame = static_cast<int64_t>(next_frame - count) - (kTapsPerPhase - 1);
+    next_input_frame = next_frame;
+    started = true;
+    convertS16ToF32(in, &history[history_fill], count);
+    history_fill += count;
+
+    // Newest input sample and sub-sample phase of the next output, inverting
+    // getNextOutputTime(); rounding the phase keeps an equal ratio's grid
+    // exact
+    double newest = next_output + (kTapsPerPhase * up - 1) / (2.0 * up);
+    int64_t whole = static_cast<int64_t>(std::floor(newest));
+    int64_t sub = std::llround((newest - static_cast<double>(whole)) * up);
+    if (sub >= up) {
+        whole++;
+        sub -= up;
+    }
+
+    // The context kept in the history bounds how far back the grid can start
+    int64_t first = history_start_frame + (kTapsPerPhase - 1);
+    if (whole < first) {
+        whole = first;
+        sub = 0;
+    }
+    position = static_cast<size_t>(whole - history_start_frame);
+    phase = static_cast<int>(sub);
+}
+
+size_t Resampler::process(const int16_t* in, size_t count, int16_t* out) {
+    const size_t taps = kTapsPerPhase;
+    size_t written = 0;
+
+    while (count > 0) {
+        size_t chunk = std::min(count, max_chunk);
+        convertS16ToF32(in, &history[history_fill], chunk);
+        history_fill += chunk;
+        in += chunk;
+        count -= chunk;
+
+        // Emit every output whose newest input sample is now buffered
+        size_t produced = 0;
+        while (position < history_fill) {
+            output_scratch[produced++] = dotProductF32(&bank[phase * taps],
+                                                       &history[position + 1 - taps], taps);
+            phase += down;
+            position += phase / up;
+            phase %= up;
+        }
+        convertF32ToS16(output_scratch.data(), out + written, produced);
+        written += produced;
+
+        // Slide the window down, keeping taps - 1 samples of context
+        size_t keep_from = position + 1 - taps;
+        size_t remaining = history_fill - keep_from;
+        std::memmove(&history[0], &history[keep_from], remaining * sizeof(float));
+        history_fill = remaining;
+        position -= keep_from;
+        history_start_frame += keep_from;
+    }
+
+    return written;
+}
+
+AudioBuffer Resampler::process(AudioBuffer&& input) {
+    AudioBuffer result;
+    if (!input.valid() || input.empty()) {
+        return result;
+    }
+    if (input.channels != 1) {
+        std::cerr << "Resampler only handles mono audio, got " << input.channels
+                  << " channels" << std::endl;
+        return result;
+    }
+
+    // Filter history from before lost frames must not bleed into the audio
+    // after them
+    if (input.discontinuity) {
+        reset();
+    }
+
+    // Follow the input's stream position, including frames lost upstream,
+    // so output timestamps stay sample-accurate
+    if (!started) {
+        history_start_frame = static_cast<int64_t>(input.startFrame) - (kTapsPerPhase - 1);
+        started = true;
+    } else if (input.startFrame != next_input_frame) {
+        history_start_frame += static_cast<int64_t>(input.startFrame - next_input_frame);
+    }
+    next_input_frame = input.startFrame + input.frames();
+
+    result = pool.acquire(maxOutput(input.size()));
+    if (!result.valid()) {
+        std::cerr << "No free audio buffer for resampler output" << std::endl;
+        return result;
+    }
+
+    // Input time (in input frames) of the first output sample, after the
+    // filter's group delay
+    double first_input_frame = static_cast<double>(history_start_frame + static_cast<int64_t>(position)) +
+                               static_cast<double>(phase) / up -
+                               (kTapsPerPhase * up - 1) / (2.0 * up);
+
+    size_t produced = process(input.data(), input.size(), result.data());
+    result.resize(produced);
+    result.sampleRate = output_rate;
+    result.channels = 1;
+    result.discontinuity = input.discontinuity;
+    result.startFrame = first_input_frame > 0.0
+        ? static_cast<uint64_t>(std::llround(first_input_frame * output_rate / input_rate))
+        : 0;
+    result.timestampUs = input.timestampUs +
+        std::llround((first_input_frame - static_cast<double>(input.startFrame)) * 1e6 / input_rate);
+    return result;
+}
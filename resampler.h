@@ -0,0 +1,75 @@
+#ifndef RESAMPLER_H
+#define RESAMPLER_H
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include "audio_buffer.h"
+
+// Streaming polyphase resampler for mono int16 audio. The rate ratio is
+// reduced to L/M and tracked with integer arithmetic, so any sequence of
+// chunk sizes produces the same output with no drift. Filter banks for the
+// common capture rates into 16 kHz are generated at compile time; other
+// ratios build the same Kaiser-windowed sinc bank at construction.
+class Resampler {
+public:
+    static const int kTapsPerPhase = 64;
+
+    // Output buffers are drawn from `pool`, which must outlive this object
+    Resampler(AudioBlockPool& pool, int input_rate, int output_rate, size_t max_chunk = 8192);
+
+    // Consumes `input` and returns the resampled samples, which may be empty
+    // for very short chunks. Timestamps follow the input stream.
+    AudioBuffer process(AudioBuffer&& input);
+
+    // Low-level entry point. Consumes all `count` samples and returns the
+    // number written to `out`, which needs room for maxOutput(count).
+    size_t process(const int16_t* in, size_t count, int16_t* out);
+    size_t maxOutput(size_t input_count) const;
+
+    void reset();
+
+    // Input stream time, in (fractional) input frames, of the next output
+    // sample, after the filter's group delay
+    double getNextOutputTime() const;
+
+    // Restarts the filter from the last `count` input samples before stream
+    // frame `next_frame`, with the next output at input time `next_output`
+    // (e.g. another resampler's getNextOutputTime()). A resampler switched in
+    // mid-stream then carries on the previous stage's output grid instead of
+    // ramping up from silence or starting a new grid. `count` is at most
+    // kTapsPerPhase.
+    void prime(const int16_t* in, size_t count, uint64_t next_frame, double next_output);
+
+    int getInputRate() const { return input_rate; }
+    int getOutputRate() const { return output_rate; }
+
+private:
+    AudioBlockPool& pool;
+    int input_rate;
+    int output_rate;
+    int up;      // L
+    int down;    // M
+
+    // Phase-major coefficients with taps reversed so each output is a single
+    // contiguous dot product against the history
+    const float* bank;
+    std::vector<float> runtime_bank;
+
+    // History holds kTapsPerPhase - 1 samples of context followed by the
+    // unconsumed input; `position` indexes the newest sample the next output
+    // needs, `phase` is its sub-sample offset in units of 1/L
+    std::vector<float> history;
+    std::vector<float> output_scratch;
+    size_t history_fill;
+    size_t position;
+    int phase;
+    size_t max_chunk;
+
+    // Absolute input frame of history[0], used to timestamp the output
+    int64_t history_start_frame;
+    uint64_t next_input_frame;
+    bool started;
+};
+
+#endif // RESAMPLER_H
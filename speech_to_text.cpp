@@ -3,12 +3,15 @@
 #include <stdexcept>
 #include <algorithm>
 #include <cctype>
+#include <thread>
+#include "dsp_kernels.h"
 
 // For Whisper implementation
 #include "whisper.h"
 
 SpeechToText::SpeechToText(const std::string& engine_name) 
-    : language("en"), engine_handle(nullptr) {
+    : language("en"), engine_handle(nullptr), whisper_params(nullptr),
+      default_session(nullptr) {
     setEngine(engine_name);
     if (!initializeEngine()) {
         throw std::runtime_error("Failed to initialize speech-to-text engine");
@@ -38,6 +41,19 @@ void SpeechToText::setEngine(const std::string& engine_name) {
 
 void SpeechToText::setLanguage(const std::string& language_code) {
     language = language_code;
+    if (whisper_params != nullptr) {
+        whisper_params->language = language.c_str();
+    }
+}
+
+void SpeechToText::setThreads(int n_threads) {
+    if (n_threads < 1) {
+        std::cerr << "Invalid thread count " << n_threads << std::endl;
+        return;
+    }
+    if (whisper_params != nullptr) {
+        whisper_params->n_threads = n_threads;
+    }
 }
 
 bool SpeechToText::initializeEngine() {
@@ -45,13 +61,30 @@ bool SpeechToText::initializeEngine() {
     
     switch (engine) {
         case WHISPER: {
-            // Initialize Whisper
-            struct whisper_context* ctx = whisper_init_from_file("/home/pi/models/ggml-tiny.en.bin");
+            // Initialize Whisper. Only the weights live in the context;
+            // decoding state is allocated per session
+            struct whisper_context* ctx =
+                whisper_init_from_file_no_state("/home/pi/models/ggml-tiny.en.bin");
             if (ctx == nullptr) {
                 std::cerr << "Failed to initialize Whisper model" << std::endl;
                 return false;
             }
             engine_handle = ctx;
+            
+            // Parameters are built once; sessions copy them per call and
+            // only fill in the per-call fields
+            whisper_params = new whisper_full_params(
+                whisper_full_default_params(WHISPER_SAMPLING_GREEDY));
+            whisper_params->print_realtime = false;
+            whisper_params->print_progress = false;
+            whisper_params->print_timestamps = false;
+            whisper_params->translate = false;
+            whisper_params->language = language.c_str();
+            // One inference thread per core unless told otherwise
+            whisper_params->n_threads = std::max(1u, std::thread::hardware_concurrency());
+            
+            // Context is passed explicitly so callers decide what carries over
+            whisper_params->no_context = true;
             break;
         }
         case VOSK:
@@ -68,6 +101,12 @@ bool SpeechToText::initializeEngine() {
 }
 
 void SpeechToText::cleanupEngine() {
+    // Sessions hold state tied to the model, so they go first
+    delete default_session;
+    default_session = nullptr;
+    delete whisper_params;
+    whisper_params = nullptr;
+    
     if (engine_handle != nullptr) {
         switch (engine) {
             case WHISPER:
@@ -97,42 +136,180 @@ std::string SpeechToText::transcribe(const AudioBuffer& audio) {
     }
 }
 
+std::string SpeechToText::transcribeSamples(const float* samples, size_t count,
+                                            const std::vector<int32_t>& prompt,
+                                            std::vector<int32_t>* tokens, int audio_ctx) {
+    if (engine != WHISPER) {
+        if (tokens != nullptr) {
+            tokens->clear();
+        }
+        std::cerr << "Streaming transcription is only supported by Whisper" << std::endl;
+        return "";
+    }
+    if (defaultSession() == nullptr) {
+        if (tokens != nullptr) {
+            tokens->clear();
+        }
+        return "";
+    }
+    return default_session->transcribeSamples(samples, count, prompt, tokens, audio_ctx);
+}
+
+std::unique_ptr<SpeechToText::Session> SpeechToText::createSession() {
+    if (engine != WHISPER || engine_handle == nullptr) {
+        std::cerr << "Sessions are only supported by an initialized Whisper engine" << std::endl;
+        return nullptr;
+    }
+    
+    struct whisper_state* state = whisper_init_state((struct whisper_context*)engine_handle);
+    if (state == nullptr) {
+        std::cerr << "Failed to allocate Whisper state" << std::endl;
+        return nullptr;
+    }
+    return std::unique_ptr<Session>(new Session(*this, state));
+}
+
+int SpeechToText::getMelBands() const {
+    if (engine != WHISPER || engine_handle == nullptr) {
+        return 0;
+    }
+    return whisper_model_n_mels((struct whisper_context*)engine_handle);
+}
+
+SpeechToText::Session* SpeechToText::defaultSession() {
+    // Created on first use: callers that only decode on their own sessions
+    // never pay for this one's Whisper state
+    if (default_session == nullptr) {
+        default_session = createSession().release();
+    }
+    return default_session;
+}
+
 std::string SpeechToText::transcribeWithWhisper(const AudioBuffer& audio) {
-    if (engine_handle == nullptr) {
+    if (defaultSession() == nullptr) {
         return "Whisper model not initialized";
     }
-    
-    struct whisper_context* ctx = (struct whisper_context*)engine_handle;
+    return default_session->transcribe(audio);
+}
+
+SpeechToText::Session::Session(SpeechToText& owner, void* state_handle)
+    : owner(owner), state_handle(state_handle), n_threads(0) {
+}
+
+SpeechToText::Session::~Session() {
+    whisper_free_state((struct whisper_state*)state_handle);
+}
+
+void SpeechToText::Session::setThreads(int threads) {
+    n_threads = std::max(0, threads);
+}
+
+std::string SpeechToText::Session::transcribe(const AudioBuffer& audio) {
+    // Whisper has no resampling of its own
+    if (audio.sampleRate != WHISPER_SAMPLE_RATE || audio.channels != 1) {
+        std::cerr << "Whisper expects 16 kHz mono audio, got " << audio.sampleRate << " Hz, "
+                  << audio.channels << " channel(s)" << std::endl;
+        return "";
+    }
     
     // Convert int16_t samples to float
-    std::vector<float> pcmf32(audio.samples.size());
-    for (size_t i = 0; i < audio.samples.size(); i++) {
-        pcmf32[i] = float(audio.samples[i]) / 32768.0f;
+    pcmf32.resize(audio.size());
+    convertS16ToF32(audio.data(), pcmf32.data(), audio.size());
+    
+    static const std::vector<int32_t> no_prompt;
+    std::string result;
+    if (!runWhisper(pcmf32.data(), pcmf32.size(), no_prompt, nullptr, 0, 0, result)) {
+        return "Failed to run Whisper inference";
+    }
+    return result;
+}
+
+std::string SpeechToText::Session::transcribeSamples(const float* samples, size_t count,
+                                                     const std::vector<int32_t>& prompt,
+                                                     std::vector<int32_t>* tokens, int audio_ctx) {
+    std::string result;
+    if (!runWhisper(samples, count, prompt, tokens, audio_ctx, 0, result)) {
+        std::cerr << "Failed to run Whisper inference" << std::endl;
+        return "";
     }
+    return result;
+}
+
+std::string SpeechToText::Session::transcribeMel(const float* mel, int frames, int audio_frames,
+                                                 const std::vector<int32_t>& prompt,
+                                                 std::vector<int32_t>* tokens, int audio_ctx) {
+    struct whisper_context* ctx = (struct whisper_context*)owner.engine_handle;
+    struct whisper_state* state = (struct whisper_state*)state_handle;
     
-    // Set up Whisper parameters
-    struct whisper_full_params params = whisper_full_default_params(WHISPER_SAMPLING_GREEDY);
-    params.print_realtime = false;
-    params.print_progress = false;
-    params.print_timestamps = false;
-    params.translate = false;
-    params.language = language.c_str();
-    params.n_threads = 2;  // Use 2 threads on Raspberry Pi
+    if (whisper_set_mel_with_state(ctx, state, mel, frames, whisper_model_n_mels(ctx)) != 0) {
+        std::cerr << "Failed to set Whisper mel spectrogram" << std::endl;
+        return "";
+    }
     
-    // Run inference
-    if (whisper_full(ctx, params, pcmf32.data(), pcmf32.size()) != 0) {
-        return "Failed to run Whisper inference";
+    // Whisper takes the whole mel as audio, so without a duration it would
+    // keep seeking through the 30 s of padding, paying for extra passes and
+    // inventing text on the silence
+    int duration_ms = std::max(1, audio_frames * WHISPER_HOP_LENGTH * 1000 / WHISPER_SAMPLE_RATE);
+    std::string result;
+    if (!runWhisper(nullptr, 0, prompt, tokens, audio_ctx, duration_ms, result)) {
+        std::cerr << "Failed to run Whisper inference" << std::endl;
+        return "";
+    }
+    return result;
+}
+
+bool SpeechToText::Session::runWhisper(const float* samples, size_t count,
+                                       const std::vector<int32_t>& prompt,
+                                       std::vector<int32_t>* tokens, int audio_ctx, int duration_ms,
+                                       std::string& result) {
+    struct whisper_context* ctx = (struct whisper_context*)owner.engine_handle;
+    struct whisper_state* state = (struct whisper_state*)state_handle;
+    
+    if (tokens != nullptr) {
+        tokens->clear();
+    }
+    
+    struct whisper_full_params params = *owner.whisper_params;
+    if (n_threads > 0) {
+        params.n_threads = n_threads;
+    }
+    if (!prompt.empty()) {
+        params.prompt_tokens = prompt.data();
+        params.prompt_n_tokens = static_cast<int>(prompt.size());
+    }
+    if (audio_ctx > 0) {
+        params.audio_ctx = audio_ctx;
+    }
+    if (duration_ms > 0) {
+        params.duration_ms = duration_ms;
+    }
+    
+    // Run inference; without samples Whisper keeps the mel already set
+    if (whisper_full_with_state(ctx, state, params, samples, static_cast<int>(count)) != 0) {
+        return false;
     }
     
     // Get the result
-    std::string result;
-    const int n_segments = whisper_full_n_segments(ctx);
+    result.clear();
+    const whisper_token eot = whisper_token_eot(ctx);
+    const int n_segments = whisper_full_n_segments_from_state(state);
     for (int i = 0; i < n_segments; i++) {
-        result += whisper_full_get_segment_text(ctx, i);
+        result += whisper_full_get_segment_text_from_state(state, i);
         result += " ";
+        
+        if (tokens != nullptr) {
+            // Special tokens (timestamps, end of text, ...) sort after eot
+            const int n_tokens = whisper_full_n_tokens_from_state(state, i);
+            for (int j = 0; j < n_tokens; j++) {
+                whisper_token id = whisper_full_get_token_id_from_state(state, i, j);
+                if (id < eot) {
+                    tokens->push_back(id);
+                }
+            }
+        }
     }
     
-    return result;
+    return true;
 }
 
 std::string SpeechToText::transcribeWithVosk(const AudioBuffer& audio) {
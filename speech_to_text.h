@@ -2,10 +2,66 @@
 #define SPEECH_TO_TEXT_H
 
 #include <string>
-#include "audio_capture.h"
+#include <vector>
+#include <cstdint>
+#include <memory>
+#include "audio_buffer.h"
+
+struct whisper_full_params;
 
 class SpeechToText {
 public:
+    // Independent decoding state over the loaded model. Each session owns its
+    // own Whisper state (KV caches, mel buffer) and sample buffer, so several
+    // streams or worker threads can share one copy of the weights. A session
+    // must only be used by one thread at a time and must not outlive its
+    // SpeechToText.
+    class Session {
+    public:
+        ~Session();
+        
+        std::string transcribe(const AudioBuffer& audio);
+        
+        // Inference threads for this session; 0 uses the engine default
+        void setThreads(int n_threads);
+        
+        // See SpeechToText::transcribeSamples
+        std::string transcribeSamples(const float* samples, size_t count,
+                                      const std::vector<int32_t>& prompt,
+                                      std::vector<int32_t>* tokens = nullptr,
+                                      int audio_ctx = 0);
+        
+        // Decodes a precomputed log-mel spectrogram instead of samples, so
+        // Whisper skips its own STFT. `mel` is getMelBands() rows of
+        // `frames` values (mel-major), already normalized the way Whisper
+        // does: clamped to 8 below the maximum, then (x + 4) / 4. Only the
+        // first `audio_frames` of each row are audio; the rest is the
+        // silence padding, which Whisper then doesn't seek into. Same
+        // prompt, token and audio_ctx handling as transcribeSamples().
+        std::string transcribeMel(const float* mel, int frames, int audio_frames,
+                                  const std::vector<int32_t>& prompt,
+                                  std::vector<int32_t>* tokens = nullptr,
+                                  int audio_ctx = 0);
+        
+    private:
+        friend class SpeechToText;
+        Session(SpeechToText& owner, void* state_handle);
+        Session(const Session&) = delete;
+        Session& operator=(const Session&) = delete;
+        
+        SpeechToText& owner;
+        void* state_handle;         // Opaque pointer to the engine's per-stream state
+        int n_threads;
+        std::vector<float> pcmf32;  // Reused across calls, only grows
+        
+        // With `samples` null, decodes the mel already set on the state.
+        // A positive `duration_ms` stops decoding there.
+        bool runWhisper(const float* samples, size_t count,
+                        const std::vector<int32_t>& prompt,
+                        std::vector<int32_t>* tokens, int audio_ctx, int duration_ms,
+                        std::string& result);
+    };
+    
     enum Engine {
         WHISPER,
         VOSK,
@@ -15,15 +71,41 @@ public:
     SpeechToText(const std::string& engine_name = "whisper");
     ~SpeechToText();
     
+    // Whisper calls go through a built-in default session, created by the
+    // first call
     std::string transcribe(const AudioBuffer& audio);
+    
+    // Decodes 16 kHz mono float samples with the given prompt tokens as
+    // context. The decoded text tokens are stored in `tokens` when it is
+    // non-null. A non-zero `audio_ctx` limits the encoder to that many
+    // frames (50 per second of audio) instead of a full 30 s window.
+    // Only supported by the Whisper engine.
+    std::string transcribeSamples(const float* samples, size_t count,
+                                  const std::vector<int32_t>& prompt,
+                                  std::vector<int32_t>* tokens = nullptr,
+                                  int audio_ctx = 0);
+    
+    // Creates another session over the same model; nullptr if the engine
+    // has no per-stream state
+    std::unique_ptr<Session> createSession();
+    
+    // Mel bands the loaded Whisper model expects (80, or 128 for large-v3);
+    // 0 for other engines
+    int getMelBands() const;
+    
     void setEngine(const std::string& engine_name);
+    // Not safe while another thread is transcribing
     void setLanguage(const std::string& language_code);
+    void setThreads(int n_threads);
     
 private:
     Engine engine;
     std::string language;
     void* engine_handle;  // Opaque pointer to engine-specific data
+    struct whisper_full_params* whisper_params;  // Cached, refreshed by setLanguage
+    Session* default_session;  // Created lazily by defaultSession()
     
+    Session* defaultSession();
     bool initializeEngine();
     void cleanupEngine();
     
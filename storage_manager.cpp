@@ -0,0 +1,906 @@
+#include "storage_manager.h"
+#include <iostream>
+#include <stdexcept>
+#include <algorithm>
+#include <cstring>
+#include <cstdio>
+#include <cerrno>
+#include <ctime>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include "file_io.h"
+
+// On-disk record:
+//   u32 payload length | u32 crc32 of the rest | u8 type | u64 sequence |
+//   i64 time (us since epoch) | payload
+// All integers little-endian.
+static const size_t kHeaderBytes = 4 + 4 + 1 + 8 + 8;
+static const size_t kMaxPayloadBytes = 1024 * 1024;
+
+enum RecordType {
+    RECORD_CHECKPOINT = 1,      // First record of every segment; `sequence` is the last one before it
+    RECORD_TRANSCRIPTION = 2    // Payload is the UTF-8 text
+};
+
+static const char kSegmentPrefix[] = "transcripts-";
+static const char kSegmentSuffix[] = ".wal";
+static const char kIndexSuffix[] = ".idx";
+static const char kCursorFile[] = "sync.cursor";
+
+// One index entry per this many records; a lookup scans at most this many
+static const size_t kIndexInterval = 16;
+
+// Index entry: u64 sequence | i64 time (us since epoch) | u64 record offset,
+// little-endian like the records
+static const size_t kIndexEntryBytes = 24;
+
+// The cursor file holds two slots written alternately, so a torn write
+// leaves the previous value readable: u64 generation | u64 sequence | u32 crc
+static const size_t kCursorSlotBytes = 32;
+
+// Records read per step when catching the search index up with the log
+static const size_t kReindexBatch = 256;
+
+struct Crc32Table {
+    uint32_t entries[256];
+
+    Crc32Table() {
+        for (uint32_t i = 0; i < 256; i++) {
+            uint32_t c = i;
+            for (int k = 0; k < 8; k++) {
+                c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            }
+            entries[i] = c;
+        }
+    }
+};
+
+static uint32_t crc32Update(uint32_t crc, const char* data, size_t length) {
+    static const Crc32Table table;
+    crc = ~crc;
+    for (size_t i = 0; i < length; i++) {
+        crc = table.entries[(crc ^ static_cast<unsigned char>(data[i])) & 0xFF] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
+static void putU32(char* out, uint32_t value) {
+    for (int i = 0; i < 4; i++) {
+        out[i] = static_cast<char>(value >> (8 * i));
+    }
+}
+
+static void putU64(char* out, uint64_t value) {
+    for (int i = 0; i < 8; i++) {
+        out[i] = static_cast<char>(value >> (8 * i));
+    }
+}
+
+static uint32_t getU32(const char* in) {
+    uint32_t value = 0;
+    for (int i = 0; i < 4; i++) {
+        value |= static_cast<uint32_t>(static_cast<unsigned char>(in[i])) << (8 * i);
+    }
+    return value;
+}
+
+static uint64_t getU64(const char* in) {
+    uint64_t value = 0;
+    for (int i = 0; i < 8; i++) {
+        value |= static_cast<uint64_t>(static_cast<unsigned char>(in[i])) << (8 * i);
+    }
+    return value;
+}
+
+static bool hostIsLittleEndian() {
+    const uint16_t one = 1;
+    return *reinterpret_cast<const uint8_t*>(&one) == 1;
+}
+
+static std::string formatTime(int64_t time_us) {
+    std::time_t seconds = static_cast<std::time_t>(time_us / 1000000);
+    std::tm local;
+    localtime_r(&seconds, &local);
+    char text[32];
+    std::strftime(text, sizeof(text), "%Y-%m-%d %H:%M:%S", &local);
+    return text;
+}
+
+static bool readFile(const std::string& path, std::vector<char>& data) {
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat info;
+    if (fstat(fd, &info) != 0) {
+        close(fd);
+        return false;
+    }
+    data.resize(static_cast<size_t>(info.st_size));
+    size_t done = 0;
+    while (done < data.size()) {
+        ssize_t count = read(fd, &data[done], data.size() - done);
+        if (count < 0 && errno == EINTR) {
+            continue;
+        }
+        if (count <= 0) {
+            break;
+        }
+        done += static_cast<size_t>(count);
+    }
+    data.resize(done);
+    close(fd);
+    return true;
+}
+
+// Returns the size of the next valid record at `offset`, or 0 if the data
+// there is truncated or corrupt
+static size_t parseRecord(const char* data, size_t size, size_t offset, uint8_t& type,
+                          uint64_t& sequence, int64_t& time_us, const char*& payload,
+                          size_t& length) {
+    if (size - offset < kHeaderBytes) {
+        return 0;
+    }
+    const char* header = data + offset;
+    length = getU32(header);
+    if (length > kMaxPayloadBytes || size - offset - kHeaderBytes < length) {
+        return 0;
+    }
+    uint32_t crc = getU32(header + 4);
+    if (crc32Update(0, header + 8, kHeaderBytes - 8 + length) != crc) {
+        return 0;
+    }
+    type = static_cast<uint8_t>(header[8]);
+    sequence = getU64(header + 9);
+    time_us = static_cast<int64_t>(getU64(header + 17));
+    payload = header + kHeaderBytes;
+    return kHeaderBytes + length;
+}
+
+static void encodeRecord(std::vector<char>& out, uint8_t type, uint64_t sequence,
+                         int64_t time_us, const char* payload, size_t length) {
+    size_t offset = out.size();
+    out.resize(offset + kHeaderBytes + length);
+    char* record = &out[offset];
+    putU32(record, static_cast<uint32_t>(length));
+    record[8] = static_cast<char>(type);
+    putU64(record + 9, sequence);
+    putU64(record + 17, static_cast<uint64_t>(time_us));
+    if (length > 0) {
+        std::memcpy(record + kHeaderBytes, payload, length);
+    }
+    putU32(record + 4, crc32Update(0, record + 8, kHeaderBytes - 8 + length));
+}
+
+static std::string segmentName(uint64_t first_sequence, const char* suffix) {
+    char name[64];
+    std::snprintf(name, sizeof(name), "%s%016llx%s", kSegmentPrefix,
+                  static_cast<unsigned long long>(first_sequence), suffix);
+    return name;
+}
+
+StorageManager::MappedFile::MappedFile() : address(nullptr), length(0) {
+}
+
+StorageManager::MappedFile::~MappedFile() {
+    unmap();
+}
+
+bool StorageManager::MappedFile::map(const std::string& path, size_t bytes) {
+    unmap();
+    int file = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (file < 0) {
+        return false;
+    }
+    if (bytes == 0) {
+        struct stat info;
+        if (fstat(file, &info) != 0) {
+            close(file);
+            return false;
+        }
+        bytes = static_cast<size_t>(info.st_size);
+    }
+    if (bytes > 0) {
+        void* mapped = mmap(nullptr, bytes, PROT_READ, MAP_SHARED, file, 0);
+        if (mapped == MAP_FAILED) {
+            close(file);
+            return false;
+        }
+        address = mapped;
+    }
+    length = bytes;
+    close(file);
+    return true;
+}
+
+void StorageManager::MappedFile::unmap() {
+    if (address != nullptr) {
+        munmap(address, length);
+    }
+    address = nullptr;
+    length = 0;
+}
+
+StorageManager::StorageManager(const std::string& directory, size_t segment_bytes,
+                               size_t group_commit_bytes)
+    : directory(directory), segment_bytes(segment_bytes),
+      group_commit_bytes(group_commit_bytes), fd(-1), index_fd(-1), cursor_fd(-1),
+      tail_bytes(0), tail_records(0), staged_records(0), next_sequence(1), sync_cursor(0),
+      cursor_generation(0), listed_through(0), commits(0) {
+    if (mkdir(directory.c_str(), 0755) != 0 && errno != EEXIST) {
+        throw std::runtime_error("Cannot create storage directory " + directory + ": " +
+                                 std::strerror(errno));
+    }
+    if (!loadSyncCursor()) {
+        throw std::runtime_error("Cannot open sync cursor in " + directory);
+    }
+
+    listSegments();
+    for (size_t i = 0; i + 1 < segments.size(); i++) {
+        if (!loadSealedIndex(i)) {
+            throw std::runtime_error("Cannot index log segment " + segments[i].path);
+        }
+    }
+    if (!recoverTail()) {
+        throw std::runtime_error("Cannot open transcription log in " + directory);
+    }
+    listed_through = sync_cursor;
+
+    // Catch the search index up with whatever it lost in a crash, or build
+    // it from scratch over an existing log, a batch at a time
+    search_index.reset(new TranscriptIndex(directory + "/index"));
+    std::vector<Record> batch;
+    uint64_t indexed = search_index->getIndexedThrough();
+    while (sinceLocked(indexed, batch, kReindexBatch) > 0) {
+        for (const Record& record : batch) {
+            search_index->add(record.sequence, record.text);
+        }
+        indexed = batch.back().sequence;
+        batch.clear();
+    }
+}
+
+StorageManager::~StorageManager() {
+    std::lock_guard<std::mutex> lock(mutex);
+    commitLocked();
+    if (fd >= 0) {
+        close(fd);
+    }
+    if (index_fd >= 0) {
+        close(index_fd);
+    }
+    if (cursor_fd >= 0) {
+        close(cursor_fd);
+    }
+}
+
+void StorageManager::listSegments() {
+    segments.clear();
+    DIR* dir = opendir(directory.c_str());
+    if (dir == nullptr) {
+        return;
+    }
+
+    const size_t prefix = sizeof(kSegmentPrefix) - 1;
+    const size_t suffix = sizeof(kSegmentSuffix) - 1;
+    while (struct dirent* entry = readdir(dir)) {
+        std::string name = entry->d_name;
+        if (name.size() != prefix + 16 + suffix || name.compare(0, prefix, kSegmentPrefix) != 0 ||
+            name.compare(prefix + 16, suffix, kSegmentSuffix) != 0) {
+            continue;
+        }
+        Segment segment;
+        segment.first_sequence = std::strtoull(name.substr(prefix, 16).c_str(), nullptr, 16);
+        segment.path = directory + "/" + name;
+        segment.index_path = directory + "/" + segmentName(segment.first_sequence, kIndexSuffix);
+        segments.push_back(std::move(segment));
+    }
+    closedir(dir);
+
+    std::sort(segments.begin(), segments.end(), [](const Segment& a, const Segment& b) {
+        return a.first_sequence < b.first_sequence;
+    });
+}
+
+bool StorageManager::rebuildIndex(const char* data, size_t size, std::vector<IndexEntry>& index,
+                                  uint64_t& last_sequence, size_t& valid_bytes,
+                                  size_t& records) const {
+    index.clear();
+    valid_bytes = 0;
+    records = 0;
+    last_sequence = 0;
+
+    bool has_checkpoint = false;
+    size_t offset = 0;
+    while (offset < size) {
+        uint8_t type;
+        uint64_t sequence;
+        int64_t time_us;
+        const char* payload;
+        size_t length;
+        size_t record_size = parseRecord(data, size, offset, type, sequence, time_us, payload, length);
+        if (record_size == 0 || (offset == 0 && type != RECORD_CHECKPOINT)) {
+            break;
+        }
+        if (type == RECORD_CHECKPOINT) {
+            has_checkpoint = true;
+            last_sequence = sequence;
+        } else if (type == RECORD_TRANSCRIPTION) {
+            if (records % kIndexInterval == 0) {
+                IndexEntry entry;
+                entry.sequence = sequence;
+                entry.time_us = time_us;
+                entry.offset = offset;
+                index.push_back(entry);
+            }
+            records++;
+            last_sequence = sequence;
+        }
+        offset += record_size;
+    }
+    valid_bytes = offset;
+    return has_checkpoint;
+}
+
+bool StorageManager::writeIndex(int file, const IndexEntry* entries, size_t count) {
+    static_assert(sizeof(IndexEntry) == kIndexEntryBytes, "IndexEntry must not be padded");
+    if (hostIsLittleEndian()) {
+        return writeAll(file, reinterpret_cast<const char*>(entries), count * kIndexEntryBytes);
+    }
+    std::vector<char> encoded(count * kIndexEntryBytes);
+    for (size_t i = 0; i < count; i++) {
+        char* out = &encoded[i * kIndexEntryBytes];
+        putU64(out, entries[i].sequence);
+        putU64(out + 8, static_cast<uint64_t>(entries[i].time_us));
+        putU64(out + 16, entries[i].offset);
+    }
+    return writeAll(file, encoded.data(), encoded.size());
+}
+
+bool StorageManager::mapSealedIndex(Segment& segment) {
+    segment.index_map.reset(new MappedFile());
+    segment.decoded_index.clear();
+    if (!segment.index_map->map(segment.index_path)) {
+        return false;
+    }
+    if (!hostIsLittleEndian()) {
+        const char* data = segment.index_map->data();
+        size_t count = segment.index_map->size() / kIndexEntryBytes;
+        segment.decoded_index.resize(count);
+        for (size_t i = 0; i < count; i++) {
+            const char* in = data + i * kIndexEntryBytes;
+            segment.decoded_index[i].sequence = getU64(in);
+            segment.decoded_index[i].time_us = static_cast<int64_t>(getU64(in + 8));
+            segment.decoded_index[i].offset = getU64(in + 16);
+        }
+        segment.index_map->unmap();
+    }
+    return true;
+}
+
+bool StorageManager::sealedIndexValid(size_t segment, uint64_t data_bytes) const {
+    const MappedFile* map = segments[segment].index_map.get();
+    if (map != nullptr && map->size() % kIndexEntryBytes != 0) {
+        return false;
+    }
+
+    // Sequences are contiguous across segments, so the next segment's first
+    // sequence says how many records this one holds
+    uint64_t first = segments[segment].first_sequence;
+    uint64_t records = segments[segment + 1].first_sequence - first;
+    const IndexEntry* entries;
+    size_t count;
+    segmentIndex(segment, entries, count);
+    if (count != (records + kIndexInterval - 1) / kIndexInterval) {
+        return false;
+    }
+    if (count == 0) {
+        return true;
+    }
+    const IndexEntry& last = entries[count - 1];
+    return entries[0].sequence == first &&
+           last.sequence == first + (count - 1) * kIndexInterval &&
+           last.offset + kHeaderBytes <= data_bytes;
+}
+
+bool StorageManager::loadSealedIndex(size_t index) {
+    Segment& segment = segments[index];
+    struct stat info;
+    if (stat(segment.path.c_str(), &info) != 0) {
+        return false;
+    }
+    if (mapSealedIndex(segment) && sealedIndexValid(index, static_cast<uint64_t>(info.st_size))) {
+        return true;
+    }
+
+    // The index is missing, short or stale (e.g. a crash while sealing);
+    // rebuild it from the segment
+    std::cerr << "Rebuilding index " << segment.index_path << std::endl;
+    MappedFile data;
+    if (!data.map(segment.path)) {
+        return false;
+    }
+    std::vector<IndexEntry> entries;
+    uint64_t last_sequence;
+    size_t valid_bytes;
+    size_t records;
+    rebuildIndex(data.data(), data.size(), entries, last_sequence, valid_bytes, records);
+
+    int file = open(segment.index_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (file < 0) {
+        return false;
+    }
+    bool written = writeIndex(file, entries.data(), entries.size()) && fdatasync(file) == 0;
+    close(file);
+    return written && mapSealedIndex(segment);
+}
+
+bool StorageManager::recoverTail() {
+    // Only the newest segment is scanned. Its checkpoint carries the last
+    // sequence before it, so older segments never need reading at startup.
+    while (!segments.empty()) {
+        Segment& tail = segments.back();
+        tail.index_map.reset();
+
+        std::vector<char> data;
+        if (!readFile(tail.path, data)) {
+            std::cerr << "Cannot read log segment " << tail.path << std::endl;
+            return false;
+        }
+
+        uint64_t last_sequence;
+        size_t valid_bytes;
+        size_t records;
+        if (!rebuildIndex(data.data(), data.size(), tail_index, last_sequence, valid_bytes,
+                          records)) {
+            // Rotation crashed before the checkpoint reached the card; the
+            // segment holds nothing
+            std::cerr << "Discarding empty log segment " << tail.path << std::endl;
+            unlink(tail.path.c_str());
+            unlink(tail.index_path.c_str());
+            segments.pop_back();
+            continue;
+        }
+
+        fd = open(tail.path.c_str(), O_WRONLY | O_CLOEXEC);
+        if (fd < 0) {
+            std::cerr << "Cannot open log segment " << tail.path << ": "
+                      << std::strerror(errno) << std::endl;
+            return false;
+        }
+        if (valid_bytes < data.size()) {
+            std::cerr << "Truncating torn log tail: " << (data.size() - valid_bytes)
+                      << " bytes in " << tail.path << std::endl;
+            if (ftruncate(fd, static_cast<off_t>(valid_bytes)) != 0 || fdatasync(fd) != 0) {
+                std::cerr << "Cannot truncate " << tail.path << std::endl;
+                return false;
+            }
+        }
+        lseek(fd, static_cast<off_t>(valid_bytes), SEEK_SET);
+
+        // The tail's index file is not synced on commit; the scan above is
+        // authoritative, so rewrite it
+        index_fd = open(tail.index_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if (index_fd < 0 ||
+            !writeIndex(index_fd, tail_index.data(), tail_index.size()) ||
+            fdatasync(index_fd) != 0) {
+            std::cerr << "Cannot write index " << tail.index_path << std::endl;
+            return false;
+        }
+
+        tail_bytes = valid_bytes;
+        tail_records = records;
+        next_sequence = last_sequence + 1;
+        return true;
+    }
+
+    return openSegment(next_sequence);
+}
+
+bool StorageManager::openSegment(uint64_t first_sequence) {
+    // Seal the old tail's index before a newer segment exists: recovery only
+    // rebuilds the newest segment's index, so a crash after the new one is
+    // created must find this one complete
+    if (index_fd >= 0) {
+        if (fdatasync(index_fd) != 0) {
+            std::cerr << "Cannot sync index " << segments.back().index_path << ": "
+                      << std::strerror(errno) << std::endl;
+            return false;
+        }
+        close(index_fd);
+        index_fd = -1;
+    }
+
+    Segment segment;
+    segment.first_sequence = first_sequence;
+    segment.path = directory + "/" + segmentName(first_sequence, kSegmentSuffix);
+    segment.index_path = directory + "/" + segmentName(first_sequence, kIndexSuffix);
+
+    int new_fd = open(segment.path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (new_fd < 0) {
+        std::cerr << "Cannot create log segment " << segment.path << ": "
+                  << std::strerror(errno) << std::endl;
+        reopenTailIndex();
+        return false;
+    }
+
+    // The checkpoint makes the segment self-describing for recovery
+    std::vector<char> checkpoint;
+    encodeRecord(checkpoint, RECORD_CHECKPOINT, first_sequence - 1, 0, nullptr, 0);
+    if (!writeAll(new_fd, checkpoint.data(), checkpoint.size()) || fdatasync(new_fd) != 0) {
+        std::cerr << "Cannot initialize log segment " << segment.path << std::endl;
+        close(new_fd);
+        unlink(segment.path.c_str());
+        reopenTailIndex();
+        return false;
+    }
+
+    int new_index_fd = open(segment.index_path.c_str(),
+                            O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (new_index_fd < 0) {
+        std::cerr << "Cannot create index " << segment.index_path << std::endl;
+        close(new_fd);
+        unlink(segment.path.c_str());
+        reopenTailIndex();
+        return false;
+    }
+
+    // Make the new files' directory entries durable too
+    syncDirectory(directory);
+
+    if (fd >= 0) {
+        // The old tail is sealed; map its index
+        close(fd);
+        Segment& sealed = segments.back();
+        if (!mapSealedIndex(sealed)) {
+            std::cerr << "Cannot map index " << sealed.index_path << std::endl;
+        }
+    }
+
+    fd = new_fd;
+    index_fd = new_index_fd;
+    tail_bytes = checkpoint.size();
+    tail_records = 0;
+    tail_index.clear();
+    segments.push_back(std::move(segment));
+    return true;
+}
+
+void StorageManager::reopenTailIndex() {
+    // A failed rotation keeps appending to the old tail
+    if (fd >= 0 && index_fd < 0) {
+        index_fd = open(segments.back().index_path.c_str(), O_WRONLY | O_APPEND | O_CLOEXEC);
+    }
+}
+
+bool StorageManager::saveTranscription(int64_t capture_time_us, const std::string& text) {
+    if (text.size() > kMaxPayloadBytes) {
+        std::cerr << "Transcription of " << text.size() << " bytes is too large to store" << std::endl;
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    if ((tail_records + staged_records) % kIndexInterval == 0) {
+        IndexEntry entry;
+        entry.sequence = next_sequence;
+        entry.time_us = capture_time_us;
+        entry.offset = tail_bytes + staged.size();
+        staged_index.push_back(entry);
+    }
+    encodeRecord(staged, RECORD_TRANSCRIPTION, next_sequence++, capture_time_us,
+                 text.data(), text.size());
+    staged_records++;
+
+    if (staged.size() >= group_commit_bytes) {
+        return commitLocked();
+    }
+    return true;
+}
+
+bool StorageManager::commit() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return commitLocked();
+}
+
+bool StorageManager::commitLocked() {
+    if (staged.empty()) {
+        return true;
+    }
+    if (fd < 0) {
+        return false;
+    }
+
+    if (!writeAll(fd, staged.data(), staged.size()) || fdatasync(fd) != 0) {
+        std::cerr << "Failed to commit transcription log: " << std::strerror(errno) << std::endl;
+        // Drop whatever part made it out so the next commit starts on a
+        // record boundary; the staged records are kept for a retry
+        if (ftruncate(fd, static_cast<off_t>(tail_bytes)) == 0) {
+            lseek(fd, static_cast<off_t>(tail_bytes), SEEK_SET);
+        }
+        return false;
+    }
+
+    // The index is derived data: recovery rebuilds the tail's, so it is
+    // written without a sync of its own
+    if (!staged_index.empty() &&
+        !writeIndex(index_fd, staged_index.data(), staged_index.size())) {
+        std::cerr << "Failed to append to log index" << std::endl;
+    }
+    tail_index.insert(tail_index.end(), staged_index.begin(), staged_index.end());
+
+    // Only durable records go into the search index
+    if (search_index) {
+        size_t offset = 0;
+        uint8_t type;
+        uint64_t sequence;
+        int64_t time_us;
+        const char* payload;
+        size_t length;
+        while (size_t size = parseRecord(staged.data(), staged.size(), offset, type, sequence,
+                                         time_us, payload, length)) {
+            search_index->add(sequence, std::string(payload, length));
+            offset += size;
+        }
+    }
+
+    tail_bytes += staged.size();
+    tail_records += staged_records;
+    staged.clear();
+    staged_index.clear();
+    staged_records = 0;
+    commits++;
+
+    if (tail_bytes >= segment_bytes) {
+        openSegment(next_sequence);
+    }
+    return true;
+}
+
+void StorageManager::segmentIndex(size_t segment, const IndexEntry*& entries,
+                                  size_t& count) const {
+    if (segment + 1 == segments.size()) {
+        entries = tail_index.data();
+        count = tail_index.size();
+        return;
+    }
+    const Segment& sealed = segments[segment];
+    if (!hostIsLittleEndian()) {
+        entries = sealed.decoded_index.data();
+        count = sealed.decoded_index.size();
+        return;
+    }
+    const MappedFile* map = sealed.index_map.get();
+    entries = map ? reinterpret_cast<const IndexEntry*>(map->data()) : nullptr;
+    count = map ? map->size() / kIndexEntryBytes : 0;
+}
+
+size_t StorageManager::scanSegment(size_t segment, uint64_t start_offset, uint64_t after,
+                                   int64_t from_us, int64_t to_us, std::vector<Record>& out,
+                                   size_t max_records, bool& past_end) const {
+    // The tail may hold a partial write past the committed size; only map
+    // what is known to be good
+    bool is_tail = segment + 1 == segments.size();
+    MappedFile data;
+    if (!data.map(segments[segment].path, is_tail ? tail_bytes : 0)) {
+        std::cerr << "Cannot map log segment " << segments[segment].path << std::endl;
+        return 0;
+    }
+
+    size_t added = 0;
+    size_t offset = static_cast<size_t>(start_offset);
+    while (offset < data.size() && added < max_records) {
+        uint8_t type;
+        uint64_t sequence;
+        int64_t time_us;
+        const char* payload;
+        size_t length;
+        size_t size = parseRecord(data.data(), data.size(), offset, type, sequence, time_us,
+                                  payload, length);
+        if (size == 0) {
+            break;
+        }
+        offset += size;
+        if (type != RECORD_TRANSCRIPTION || sequence <= after || time_us < from_us) {
+            continue;
+        }
+        if (time_us > to_us) {
+            past_end = true;
+            break;
+        }
+
+        Record record;
+        record.sequence = sequence;
+        record.captureTimeUs = time_us;
+        record.text.assign(payload, length);
+        out.push_back(std::move(record));
+        added++;
+    }
+    return added;
+}
+
+size_t StorageManager::sinceLocked(uint64_t after, std::vector<Record>& out,
+                                   size_t max_records) const {
+    // Segments are named by their first sequence
+    size_t first = std::upper_bound(segments.begin(), segments.end(), after + 1,
+                                    [](uint64_t sequence, const Segment& segment) {
+                                        return sequence < segment.first_sequence;
+                                    }) - segments.begin();
+    first = first > 0 ? first - 1 : 0;
+
+    size_t added = 0;
+    for (size_t i = first; i < segments.size() && added < max_records; i++) {
+        const IndexEntry* entries;
+        size_t count;
+        segmentIndex(i, entries, count);
+        if (count == 0) {
+            continue;
+        }
+
+        // Start at the last indexed record at or before the one we want
+        const IndexEntry* it = std::upper_bound(entries, entries + count, after + 1,
+                                                [](uint64_t sequence, const IndexEntry& entry) {
+                                                    return sequence < entry.sequence;
+                                                });
+        uint64_t offset = it == entries ? entries[0].offset : (it - 1)->offset;
+
+        bool past_end = false;
+        added += scanSegment(i, offset, after, INT64_MIN, INT64_MAX, out,
+                             max_records - added, past_end);
+    }
+    return added;
+}
+
+size_t StorageManager::getSince(uint64_t after, std::vector<Record>& out, size_t max_records) {
+    std::lock_guard<std::mutex> lock(mutex);
+    return sinceLocked(after, out, max_records);
+}
+
+size_t StorageManager::getRange(int64_t from_us, int64_t to_us, std::vector<Record>& out,
+                                size_t max_records) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (from_us > to_us) {
+        return 0;
+    }
+
+    // Last segment whose first record was captured before `from_us`; only
+    // the tail can have no records, and it sorts last
+    size_t low = 0;
+    size_t high = segments.size();
+    while (low < high) {
+        size_t middle = (low + high) / 2;
+        const IndexEntry* entries;
+        size_t count;
+        segmentIndex(middle, entries, count);
+        if (count > 0 && entries[0].time_us < from_us) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+    size_t first = low > 0 ? low - 1 : 0;
+
+    size_t added = 0;
+    bool past_end = false;
+    for (size_t i = first; i < segments.size() && added < max_records && !past_end; i++) {
+        const IndexEntry* entries;
+        size_t count;
+        segmentIndex(i, entries, count);
+        if (count == 0) {
+            continue;
+        }
+
+        // Records tied with an indexed time may sit before it, so start one
+        // index entry earlier than the first at or after `from_us`
+        const IndexEntry* it = std::lower_bound(entries, entries + count, from_us,
+                                                [](const IndexEntry& entry, int64_t time) {
+                                                    return entry.time_us < time;
+                                                });
+        uint64_t offset = it == entries ? entries[0].offset : (it - 1)->offset;
+
+        added += scanSegment(i, offset, 0, from_us, to_us, out, max_records - added, past_end);
+    }
+    return added;
+}
+
+bool StorageManager::loadSyncCursor() {
+    std::string path = directory + "/" + kCursorFile;
+    cursor_fd = open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (cursor_fd < 0) {
+        return false;
+    }
+
+    char slots[2 * kCursorSlotBytes];
+    ssize_t count = pread(cursor_fd, slots, sizeof(slots), 0);
+    for (int i = 0; i < 2 && count > 0; i++) {
+        if (static_cast<size_t>(count) < (i + 1) * kCursorSlotBytes) {
+            break;
+        }
+        const char* slot = slots + i * kCursorSlotBytes;
+        if (crc32Update(0, slot, 16) != getU32(slot + 16)) {
+            continue;
+        }
+        uint64_t generation = getU64(slot);
+        if (generation > cursor_generation) {
+            cursor_generation = generation;
+            sync_cursor = getU64(slot + 8);
+        }
+    }
+    return true;
+}
+
+bool StorageManager::writeSyncCursor(uint64_t sequence) {
+    uint64_t generation = cursor_generation + 1;
+    char slot[kCursorSlotBytes] = {};
+    putU64(slot, generation);
+    putU64(slot + 8, sequence);
+    putU32(slot + 16, crc32Update(0, slot, 16));
+
+    off_t position = static_cast<off_t>((generation % 2) * kCursorSlotBytes);
+    if (pwrite(cursor_fd, slot, sizeof(slot), position) != static_cast<ssize_t>(sizeof(slot)) ||
+        fdatasync(cursor_fd) != 0) {
+        std::cerr << "Failed to persist sync cursor: " << std::strerror(errno) << std::endl;
+        return false;
+    }
+    cursor_generation = generation;
+    sync_cursor = sequence;
+    return true;
+}
+
+std::vector<std::string> StorageManager::getUnsyncedTranscriptions() {
+    std::lock_guard<std::mutex> lock(mutex);
+    commitLocked();
+
+    std::vector<Record> records;
+    sinceLocked(sync_cursor, records, SIZE_MAX);
+
+    std::vector<std::string> result;
+    result.reserve(records.size());
+    for (const Record& record : records) {
+        result.push_back(formatTime(record.captureTimeUs) + "\t" + record.text);
+    }
+    listed_through = records.empty() ? sync_cursor : records.back().sequence;
+    return result;
+}
+
+void StorageManager::markTranscriptionsAsSynced() {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (listed_through > sync_cursor) {
+        writeSyncCursor(listed_through);
+    }
+}
+
+size_t StorageManager::search(const std::string& query, std::vector<Record>& out,
+                              size_t max_records, TranscriptIndex::MatchMode mode) {
+    std::vector<uint64_t> sequences;
+    search_index->search(query, sequences, max_records, mode);
+
+    std::lock_guard<std::mutex> lock(mutex);
+    size_t added = 0;
+    for (uint64_t sequence : sequences) {
+        added += sinceLocked(sequence - 1, out, 1);
+    }
+    return added;
+}
+
+uint64_t StorageManager::getSyncCursor() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return sync_cursor;
+}
+
+bool StorageManager::setSyncCursor(uint64_t sequence) {
+    std::lock_guard<std::mutex> lock(mutex);
+    return writeSyncCursor(sequence);
+}
+
+uint64_t StorageManager::getLastSequence() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return next_sequence - 1;
+}
+
+uint64_t StorageManager::getCommitCount() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return commits;
+}
@@ -0,0 +1,151 @@
+#ifndef STORAGE_MANAGER_H
+#define STORAGE_MANAGER_H
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <cstdint>
+#include "transcript_index.h"
+
+// Transcriptions are kept in a segmented, append-only log under a directory.
+// Records are length-prefixed and CRC-checked. saveTranscription() only
+// stages a record in memory; commit() writes every staged record with one
+// write and one fdatasync, so the SD card sees few, larger synced writes.
+// Segments rotate by size and each one starts with a checkpoint of the log
+// state, so recovery only scans the newest segment and cuts off a torn tail.
+//
+// Every segment has a sparse index file next to it, one entry every
+// 16 records, mapping sequence numbers and capture times to file
+// offsets. Sealed segments' indexes and data are mmap'd, so lookups by
+// sequence or time are a binary search plus a short forward scan. At
+// startup a sealed index that doesn't cover its segment is rebuilt. The sync
+// cursor is a sequence number persisted in its own small file.
+//
+// Committed records also feed a full-text index (see TranscriptIndex)
+// kept in an index/ subdirectory.
+class StorageManager {
+public:
+    struct Record {
+        uint64_t sequence = 0;
+        int64_t captureTimeUs = 0;   // Wall-clock, microseconds since epoch
+        std::string text;
+    };
+
+    StorageManager(const std::string& directory, size_t segment_bytes = 4 * 1024 * 1024,
+                   size_t group_commit_bytes = 64 * 1024);
+    ~StorageManager();
+
+    // Stages a transcription with the time its speech was captured
+    // (microseconds since epoch). Commits on its own once the staged
+    // records reach the group commit size.
+    bool saveTranscription(int64_t capture_time_us, const std::string& text);
+
+    // Writes and syncs everything staged; one fdatasync per call
+    bool commit();
+
+    // Committed records with sequence > `after`, oldest first
+    size_t getSince(uint64_t after, std::vector<Record>& out, size_t max_records = SIZE_MAX);
+
+    // Committed records captured in [from_us, to_us]. Capture times are
+    // expected to be non-decreasing in sequence order.
+    size_t getRange(int64_t from_us, int64_t to_us, std::vector<Record>& out,
+                    size_t max_records = SIZE_MAX);
+
+    // Committed records matching `query`, newest first
+    size_t search(const std::string& query, std::vector<Record>& out, size_t max_records = 20,
+                  TranscriptIndex::MatchMode mode = TranscriptIndex::ALL_TERMS);
+
+    // Committed transcriptions after the sync cursor, oldest first, as
+    // "YYYY-MM-DD HH:MM:SS<TAB>text"
+    std::vector<std::string> getUnsyncedTranscriptions();
+
+    // Advances the sync cursor past everything the last
+    // getUnsyncedTranscriptions() returned
+    void markTranscriptionsAsSynced();
+
+    uint64_t getSyncCursor() const;
+    bool setSyncCursor(uint64_t sequence);
+
+    uint64_t getLastSequence() const;
+    uint64_t getCommitCount() const;
+
+private:
+    // Stored as three little-endian u64s, so on a little-endian host the
+    // mapped file is read in place
+    struct IndexEntry {
+        uint64_t sequence;
+        int64_t time_us;
+        uint64_t offset;
+    };
+
+    // Read-only mapping of a whole file, or of its first `length` bytes
+    class MappedFile {
+    public:
+        MappedFile();
+        ~MappedFile();
+        bool map(const std::string& path, size_t length = 0);
+        void unmap();
+        const char* data() const { return static_cast<const char*>(address); }
+        size_t size() const { return length; }
+
+    private:
+        MappedFile(const MappedFile&) = delete;
+        MappedFile& operator=(const MappedFile&) = delete;
+        void* address;
+        size_t length;
+    };
+
+    struct Segment {
+        uint64_t first_sequence;
+        std::string path;
+        std::string index_path;
+        std::unique_ptr<MappedFile> index_map;   // Sealed segments only
+        std::vector<IndexEntry> decoded_index;   // Sealed, on big-endian hosts
+    };
+
+    std::string directory;
+    size_t segment_bytes;
+    size_t group_commit_bytes;
+
+    mutable std::mutex mutex;
+    std::vector<Segment> segments;     // Oldest first; the last one is open
+    int fd;
+    int index_fd;
+    int cursor_fd;
+    size_t tail_bytes;                 // Committed size of the open segment
+    size_t tail_records;
+    std::vector<IndexEntry> tail_index;
+    std::vector<char> staged;          // Encoded records waiting for commit
+    std::vector<IndexEntry> staged_index;
+    size_t staged_records;
+
+    uint64_t next_sequence;
+    uint64_t sync_cursor;
+    uint64_t cursor_generation;
+    uint64_t listed_through;           // Highest sequence handed out for syncing
+    uint64_t commits;
+
+    std::unique_ptr<TranscriptIndex> search_index;
+
+    void listSegments();
+    bool recoverTail();
+    bool loadSealedIndex(size_t segment);
+    bool mapSealedIndex(Segment& segment);
+    bool sealedIndexValid(size_t segment, uint64_t data_bytes) const;
+    static bool writeIndex(int file, const IndexEntry* entries, size_t count);
+    bool rebuildIndex(const char* data, size_t size, std::vector<IndexEntry>& index,
+                      uint64_t& last_sequence, size_t& valid_bytes, size_t& records) const;
+    bool openSegment(uint64_t first_sequence);
+    void reopenTailIndex();
+    bool commitLocked();
+    bool loadSyncCursor();
+    bool writeSyncCursor(uint64_t sequence);
+    void segmentIndex(size_t segment, const IndexEntry*& entries, size_t& count) const;
+    size_t scanSegment(size_t segment, uint64_t start_offset, uint64_t after, int64_t from_us,
+                       int64_t to_us, std::vector<Record>& out, size_t max_records,
+                       bool& past_end) const;
+    size_t sinceLocked(uint64_t after, std::vector<Record>& out, size_t max_records) const;
+};
+
+#endif // STORAGE_MANAGER_H
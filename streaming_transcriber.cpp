@@ -0,0 +1,322 @@
+#include "streaming_transcriber.h"
+#include <iostream>
+#include <stdexcept>
+#include <algorithm>
+#include <sstream>
+#include <cctype>
+#include "dsp_kernels.h"
+#include "tracer.h"
+
+static const int kSampleRate = 16000;
+
+// Whisper's encoder sees 1500 frames for 30 s of audio
+static const int kEncoderFramesPerSecond = 50;
+static const int kMaxAudioCtx = 1500;
+
+// Whisper's decoder keeps at most half its 448-token text context as prompt
+static const size_t kMaxPromptTokens = 224;
+
+// Whisper appends 30 s of silence to the samples before its STFT; the mel
+// path pads the same way
+static const int kMelPaddingFrames = 3000;
+
+// The last frames of a window need audio past its end, which the feature
+// source only sees with the next chunk
+static const int kMaxMissingMelFrames = 2;
+
+// Stream positions within this many samples (half a mel hop) still line up
+static const int64_t kPositionSlack = 80;
+
+// The carried-over audio is short; only this many of the previous window's
+// last words can fall in it
+static const size_t kMaxCarriedWords = 4;
+
+static void splitWords(const std::string& text, std::vector<std::string>& words) {
+    words.clear();
+    std::istringstream stream(text);
+    std::string word;
+    while (stream >> word) {
+        words.push_back(word);
+    }
+}
+
+// Case and punctuation vary between decodes of the same word
+static std::string normalizeWord(const std::string& word) {
+    std::string out;
+    for (char c : word) {
+        if (std::isalnum(static_cast<unsigned char>(c))) {
+            out += static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+        }
+    }
+    return out;
+}
+
+// Longest k <= limit such that the first k words of `words` repeat the last
+// k of `carried`
+static size_t repeatedPrefix(const std::vector<std::string>& words,
+                             const std::vector<std::string>& carried, size_t limit) {
+    for (size_t k = std::min(limit, carried.size()); k > 0; k--) {
+        size_t offset = carried.size() - k;
+        size_t i = 0;
+        while (i < k && normalizeWord(words[i]) == normalizeWord(carried[offset + i])) {
+            i++;
+        }
+        if (i == k) {
+            return k;
+        }
+    }
+    return 0;
+}
+
+static void appendWords(std::string& out, const std::vector<std::string>& words,
+                        size_t from, size_t to) {
+    for (size_t i = from; i < to; i++) {
+        if (!out.empty()) {
+            out += " ";
+        }
+        out += words[i];
+    }
+}
+
+StreamingTranscriber::StreamingTranscriber(SpeechToText& stt, int step_ms, int length_ms,
+                                           int keep_ms)
+    : session(stt.createSession()), model_mel_bands(stt.getMelBands()), feature_source(nullptr),
+      step_samples(static_cast<size_t>(kSampleRate) * step_ms / 1000),
+      length_samples(static_cast<size_t>(kSampleRate) * length_ms / 1000),
+      keep_samples(static_cast<size_t>(kSampleRate) * keep_ms / 1000),
+      trim_audio_ctx(true), window_fill(0), pending_samples(0), window_start(0),
+      window_contiguous(false), committed_words(0) {
+    if (step_ms <= 0 || keep_ms < 0 || length_ms < step_ms || keep_ms >= length_ms ||
+        length_ms > 30000) {
+        throw std::invalid_argument("Invalid streaming transcription window");
+    }
+    if (!session) {
+        throw std::runtime_error("Streaming transcription needs a Whisper session");
+    }
+    window.assign(length_samples, 0.0f);
+}
+
+void StreamingTranscriber::setAudioContextTrimming(bool enable) {
+    trim_audio_ctx = enable;
+}
+
+void StreamingTranscriber::setThreads(int n_threads) {
+    session->setThreads(n_threads);
+}
+
+void StreamingTranscriber::setFeatureSource(const FeatureExtractor* features) {
+    if (features != nullptr && (features->getMelBands() != model_mel_bands ||
+                                features->getSampleRate() != kSampleRate)) {
+        std::cerr << "Feature source has " << features->getMelBands() << " mel bands at "
+                  << features->getSampleRate() << " Hz, the model expects " << model_mel_bands
+                  << " at " << kSampleRate << " Hz; decoding from samples" << std::endl;
+        features = nullptr;
+    }
+    feature_source = features;
+}
+
+void StreamingTranscriber::reset() {
+    window_fill = 0;
+    pending_samples = 0;
+    prompt_tokens.clear();
+    hypothesis.clear();
+    previous.clear();
+    committed_words = 0;
+    carried_words.clear();
+}
+
+int StreamingTranscriber::audioContextFor(size_t samples) const {
+    if (!trim_audio_ctx) {
+        return 0;
+    }
+    // Round up to a multiple of 64 so small fill changes reuse the same
+    // encoder graph size
+    size_t frames = (samples * kEncoderFramesPerSecond + kSampleRate - 1) / kSampleRate;
+    int ctx = static_cast<int>((frames + 63) / 64 * 64);
+    return std::min(ctx, kMaxAudioCtx);
+}
+
+bool StreamingTranscriber::push(const AudioBuffer& audio, Update& update) {
+    update = Update();
+    if (!audio.valid() || audio.empty()) {
+        return false;
+    }
+    if (audio.sampleRate != static_cast<size_t>(kSampleRate) || audio.channels != 1) {
+        std::cerr << "Streaming transcription expects 16 kHz mono audio" << std::endl;
+        return false;
+    }
+
+    // Audio was lost: finish the words heard before the gap rather than
+    // decoding them joined to what follows
+    bool produced = false;
+    if (audio.discontinuity && window_fill > 0) {
+        decode(update, true);
+        window_fill = 0;
+        produced = true;
+    }
+
+    if (window_fill == 0) {
+        window_start = audio.startFrame;
+        window_contiguous = true;
+        carried_words.clear();
+    } else {
+        int64_t jump = static_cast<int64_t>(audio.startFrame - (window_start + window_fill));
+        if (jump > kPositionSlack || jump < -kPositionSlack) {
+            window_contiguous = false;
+        }
+    }
+
+    const int16_t* samples = audio.data();
+    size_t remaining = audio.size();
+    stats.input_samples += remaining;
+
+    while (remaining > 0) {
+        size_t count = std::min(remaining, length_samples - window_fill);
+        convertS16ToF32(samples, &window[window_fill], count);
+        window_fill += count;
+        pending_samples += count;
+        samples += count;
+        remaining -= count;
+
+        if (window_fill == length_samples) {
+            decode(update, true);
+            produced = true;
+        }
+    }
+
+    if (pending_samples >= step_samples) {
+        decode(update, false);
+        produced = true;
+    }
+    return produced;
+}
+
+bool StreamingTranscriber::flush(Update& update) {
+    update = Update();
+    if (window_fill == 0 || (pending_samples == 0 && committed_words == hypothesis.size())) {
+        window_fill = 0;
+        return false;
+    }
+
+    decode(update, true);
+
+    // The speaker paused; the next segment starts from a clean window but
+    // keeps the text context
+    window_fill = 0;
+    return true;
+}
+
+void StreamingTranscriber::decode(Update& update, bool final) {
+    if (pending_samples > 0) {
+        int audio_ctx = audioContextFor(window_fill);
+        hypothesis.swap(previous);
+        std::string text;
+        TRACE_SCOPE("whisper.decode");
+        if (decodeFromFeatures(audio_ctx, text)) {
+            stats.mel_decodes++;
+        } else {
+            text = session->transcribeSamples(window.data(), window_fill, prompt_tokens,
+                                              &tokens, audio_ctx);
+        }
+        splitWords(text, hypothesis);
+
+        stats.decodes++;
+        stats.decoded_samples += window_fill;
+        stats.encoder_frames += audio_ctx > 0 ? audio_ctx : kMaxAudioCtx;
+        pending_samples = 0;
+    }
+
+    // Local agreement: commit the words both of the last two decodes produced
+    size_t stable = committed_words;
+    if (final) {
+        stable = std::max(stable, hypothesis.size());
+    } else {
+        size_t limit = std::min(hypothesis.size(), previous.size());
+        while (stable < limit && hypothesis[stable] == previous[stable]) {
+            stable++;
+        }
+    }
+
+    // The window opens with audio whose words were committed at the end of
+    // the last one; skip them instead of emitting them twice
+    if (!carried_words.empty() && stable > committed_words) {
+        committed_words = std::max(committed_words,
+                                   repeatedPrefix(hypothesis, carried_words,
+                                                  std::min(stable, hypothesis.size())));
+        carried_words.clear();
+    }
+
+    if (stable > committed_words && stable <= hypothesis.size()) {
+        appendWords(update.committed, hypothesis, committed_words, stable);
+        committed_words = stable;
+    }
+
+    update.partial.clear();
+    if (committed_words < hypothesis.size()) {
+        appendWords(update.partial, hypothesis, committed_words, hypothesis.size());
+    }
+
+    if (!final) {
+        return;
+    }
+
+    update.final = true;
+
+    // The finished window's tokens become the context for the next one
+    prompt_tokens.swap(tokens);
+    if (prompt_tokens.size() > kMaxPromptTokens) {
+        prompt_tokens.erase(prompt_tokens.begin(),
+                            prompt_tokens.end() - kMaxPromptTokens);
+    }
+
+    // Carry a little audio over so a word straddling the boundary is not cut
+    size_t keep = std::min(keep_samples, window_fill);
+    std::copy(window.begin() + (window_fill - keep), window.begin() + window_fill, window.begin());
+    window_start += window_fill - keep;
+    window_fill = keep;
+    carried_words.clear();
+    if (keep > 0) {
+        carried_words.assign(hypothesis.end() - std::min(hypothesis.size(), kMaxCarriedWords),
+                             hypothesis.end());
+    }
+    hypothesis.clear();
+    previous.clear();
+    committed_words = 0;
+}
+
+bool StreamingTranscriber::decodeFromFeatures(int audio_ctx, std::string& text) {
+    if (feature_source == nullptr || !window_contiguous) {
+        return false;
+    }
+
+    // Whisper's frame t is centred on window sample t * hop
+    int hop = feature_source->getHopLength();
+    int frames = static_cast<int>(window_fill / hop);
+    int padded = frames + kMelPaddingFrames;
+    mel.resize(static_cast<size_t>(model_mel_bands) * padded);
+    int copied = feature_source->copyMel(window_start, frames, mel.data(), padded);
+    if (copied == 0 || copied < frames - kMaxMissingMelFrames) {
+        return false;
+    }
+
+    // Whisper's normalization, with the silence it would have padded
+    // (log10 of its 1e-10 floor) filling the missing and padding frames
+    float mmax = -10.0f;
+    for (int j = 0; j < model_mel_bands; j++) {
+        const float* row = &mel[static_cast<size_t>(j) * padded];
+        mmax = std::max(mmax, *std::max_element(row, row + copied));
+    }
+    float floor = std::max(mmax - 8.0f, -10.0f);
+    float silence = (floor + 4.0f) / 4.0f;
+    for (int j = 0; j < model_mel_bands; j++) {
+        float* row = &mel[static_cast<size_t>(j) * padded];
+        for (int t = 0; t < copied; t++) {
+            row[t] = (std::max(row[t], floor) + 4.0f) / 4.0f;
+        }
+        std::fill(row + copied, row + padded, silence);
+    }
+
+    text = session->transcribeMel(mel.data(), padded, frames, prompt_tokens, &tokens,
+                                 audio_ctx);
+    return true;
+}
@@ -0,0 +1,99 @@
+#ifndef STREAMING_TRANSCRIBER_H
+#define STREAMING_TRANSCRIBER_H
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <memory>
+#include "audio_buffer.h"
+#include "speech_to_text.h"
+#include "feature_extractor.h"
+
+// Incremental transcription over a sliding audio window. Every `step_ms` of
+// new audio the whole window (up to `length_ms`) is decoded again, with the
+// tokens of the previous window as the prompt. Words are committed once two
+// consecutive decodes agree on them; the rest is reported as a partial that
+// may still change. When the window is full its text is committed as final
+// and only the last `keep_ms` of audio are carried into the next window.
+class StreamingTranscriber {
+public:
+    struct Update {
+        std::string committed;   // Newly committed text, never revised
+        std::string partial;     // Tentative text after the committed part
+        bool final = false;      // The window closed; nothing is pending
+    };
+
+    struct Stats {
+        uint64_t decodes = 0;
+        uint64_t decoded_samples = 0;   // Window samples fed to the model
+        uint64_t input_samples = 0;     // New audio pushed by the caller
+        uint64_t encoder_frames = 0;    // Encoder context actually used
+        uint64_t mel_decodes = 0;       // Decodes fed from the shared log-mel
+    };
+
+    // Decodes on its own session of `stt`, so several transcribers can share
+    // one model. `stt` must outlive this object and use the Whisper engine.
+    StreamingTranscriber(SpeechToText& stt, int step_ms = 500, int length_ms = 5000,
+                         int keep_ms = 200);
+
+    // Appends 16 kHz mono speech; returns true when `update` holds a new
+    // result. However much audio is passed, the window is decoded at most
+    // once, plus once per window that fills up, so a caller that has fallen
+    // behind catches up by pushing larger chunks. Audio marked as a
+    // discontinuity first finalizes the window heard before the gap.
+    bool push(const AudioBuffer& audio, Update& update);
+
+    // Decodes and commits whatever is pending, e.g. at the end of a segment
+    bool flush(Update& update);
+
+    void reset();
+
+    // Shrink the encoder context to the window length instead of padding
+    // every decode to 30 s. On by default.
+    void setAudioContextTrimming(bool enable);
+    
+    // Inference threads per decode; 0 uses the engine default
+    void setThreads(int n_threads);
+
+    // Decode from the log-mel `features` already computed for the pushed
+    // audio instead of having Whisper transform the samples again. Needs a
+    // mel history covering the window and the model's mel band count;
+    // windows not (or no longer) in the history fall back to samples.
+    // `features` must outlive this object; nullptr turns it off.
+    void setFeatureSource(const FeatureExtractor* features);
+
+    const Stats& getStats() const { return stats; }
+
+private:
+    std::unique_ptr<SpeechToText::Session> session;
+    int model_mel_bands;
+    const FeatureExtractor* feature_source;
+    size_t step_samples;
+    size_t length_samples;
+    size_t keep_samples;
+    bool trim_audio_ctx;
+
+    std::vector<float> window;
+    size_t window_fill;
+    size_t pending_samples;        // Pushed since the last decode
+    uint64_t window_start;         // Stream position of window[0]
+    bool window_contiguous;        // Pushes since then had no gaps
+    std::vector<float> mel;        // Bands x frames, for the feature source path
+
+    std::vector<int32_t> prompt_tokens;
+    std::vector<int32_t> tokens;
+    std::vector<std::string> hypothesis;
+    std::vector<std::string> previous;
+    size_t committed_words;        // Leading words of this window already committed
+    // Last words committed from the previous window, whose audio this one
+    // starts with; matching leading words are not committed again
+    std::vector<std::string> carried_words;
+
+    Stats stats;
+
+    void decode(Update& update, bool final);
+    bool decodeFromFeatures(int audio_ctx, std::string& text);
+    int audioContextFor(size_t samples) const;
+};
+
+#endif // STREAMING_TRANSCRIBER_H
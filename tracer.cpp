@@ -0,0 +1,200 @@
+#include "tracer.h"
+#include <iostream>
+#include <fstream>
+#include <iomanip>
+#include <algorithm>
+#include <stdexcept>
+#include <cerrno>
+#include <signal.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+std::atomic<bool> Tracer::enabled(true);
+std::mutex Tracer::registry_mutex;
+std::vector<std::unique_ptr<Tracer::ThreadBuffer>> Tracer::buffers;
+
+// Written by the signal handler, read by the dumper thread
+static int g_dump_pipe[2] = {-1, -1};
+
+void Tracer::setEnabled(bool enable) {
+    enabled.store(enable, std::memory_order_relaxed);
+}
+
+Tracer::ThreadBuffer* Tracer::threadBuffer() {
+    static thread_local ThreadBuffer* buffer = nullptr;
+    if (buffer == nullptr) {
+        std::unique_ptr<ThreadBuffer> created(new ThreadBuffer());
+        created->head.store(0, std::memory_order_relaxed);
+        std::lock_guard<std::mutex> lock(registry_mutex);
+        created->tid = static_cast<int>(buffers.size()) + 1;
+        buffer = created.get();
+        buffers.push_back(std::move(created));
+    }
+    return buffer;
+}
+
+void Tracer::setThreadName(const std::string& name) {
+    ThreadBuffer* buffer = threadBuffer();
+    std::lock_guard<std::mutex> lock(registry_mutex);
+    buffer->name = name;
+}
+
+void Tracer::record(const char* name, int64_t start_ns, int64_t end_ns) {
+    ThreadBuffer* buffer = threadBuffer();
+    uint64_t head = buffer->head.load(std::memory_order_relaxed);
+    Slot& slot = buffer->slots[head % kEventsPerThread];
+    // The fence keeps the new fields from becoming visible before the slot
+    // is marked as being written, so a reader never accepts a mix of events
+    slot.seq.store(0, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    slot.name.store(name, std::memory_order_relaxed);
+    slot.start_ns.store(start_ns, std::memory_order_relaxed);
+    slot.duration_ns.store(end_ns - start_ns, std::memory_order_relaxed);
+    slot.seq.store(head + 1, std::memory_order_release);
+    buffer->head.store(head + 1, std::memory_order_release);
+}
+
+static void writeJsonString(std::ostream& out, const std::string& text) {
+    out << '"';
+    for (char c : text) {
+        if (c == '"' || c == '\\') {
+            out << '\\' << c;
+        } else if (static_cast<unsigned char>(c) >= 0x20) {
+            out << c;
+        }
+    }
+    out << '"';
+}
+
+bool Tracer::dump(const std::string& path) {
+    std::vector<ThreadBuffer*> threads;
+    std::vector<std::string> names;
+    {
+        std::lock_guard<std::mutex> lock(registry_mutex);
+        for (const std::unique_ptr<ThreadBuffer>& buffer : buffers) {
+            threads.push_back(buffer.get());
+            names.push_back(buffer->name);
+        }
+    }
+
+    std::ofstream out(path);
+    if (!out) {
+        std::cerr << "Cannot write trace to " << path << std::endl;
+        return false;
+    }
+
+    out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+    out << std::fixed << std::setprecision(3);
+    bool first = true;
+    std::vector<const char*> event_names(kEventsPerThread);
+    std::vector<int64_t> starts(kEventsPerThread), durations(kEventsPerThread);
+    std::vector<bool> intact(kEventsPerThread);
+
+    for (size_t b = 0; b < threads.size(); b++) {
+        ThreadBuffer& buffer = *threads[b];
+        if (!names[b].empty()) {
+            out << (first ? "" : ",\n") << "{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":1,\"tid\":"
+                << buffer.tid << ",\"args\":{\"name\":";
+            writeJsonString(out, names[b]);
+            out << "}}";
+            first = false;
+        }
+
+        // Each slot is read between two loads of its sequence stamp; a slot
+        // the writer touched meanwhile is left out
+        uint64_t end = buffer.head.load(std::memory_order_acquire);
+        uint64_t begin = end > kEventsPerThread ? end - kEventsPerThread : 0;
+        for (uint64_t i = begin; i < end; i++) {
+            const Slot& slot = buffer.slots[i % kEventsPerThread];
+            uint64_t seq = slot.seq.load(std::memory_order_acquire);
+            event_names[i - begin] = slot.name.load(std::memory_order_relaxed);
+            starts[i - begin] = slot.start_ns.load(std::memory_order_relaxed);
+            durations[i - begin] = slot.duration_ns.load(std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_acquire);
+            intact[i - begin] = seq == i + 1 && slot.seq.load(std::memory_order_relaxed) == seq;
+        }
+
+        for (uint64_t i = begin; i < end; i++) {
+            if (!intact[i - begin]) {
+                continue;
+            }
+            out << (first ? "" : ",\n") << "{\"ph\":\"X\",\"name\":";
+            writeJsonString(out, event_names[i - begin]);
+            out << ",\"pid\":1,\"tid\":" << buffer.tid
+                << ",\"ts\":" << starts[i - begin] / 1000.0
+                << ",\"dur\":" << durations[i - begin] / 1000.0 << "}";
+            first = false;
+        }
+    }
+    out << "\n]}\n";
+
+    if (!out) {
+        std::cerr << "Failed writing trace to " << path << std::endl;
+        return false;
+    }
+    return true;
+}
+
+static void dumpSignalHandler(int) {
+    int saved_errno = errno;
+    char request = 'd';
+    ssize_t written = write(g_dump_pipe[1], &request, 1);
+    (void)written;  // A full pipe already has a dump pending
+    errno = saved_errno;
+}
+
+TraceSignalDumper::TraceSignalDumper(int signum, const std::string& prefix)
+    : signum(signum), prefix(prefix) {
+    if (g_dump_pipe[0] >= 0) {
+        throw std::runtime_error("A trace signal dumper is already running");
+    }
+    if (pipe(g_dump_pipe) != 0) {
+        throw std::runtime_error("Cannot create trace dump pipe");
+    }
+    // The handler must never block on a full pipe
+    fcntl(g_dump_pipe[1], F_SETFL, fcntl(g_dump_pipe[1], F_GETFL) | O_NONBLOCK);
+
+    struct sigaction action = {};
+    action.sa_handler = dumpSignalHandler;
+    sigemptyset(&action.sa_mask);
+    action.sa_flags = SA_RESTART;
+    if (sigaction(signum, &action, nullptr) != 0) {
+        close(g_dump_pipe[0]);
+        close(g_dump_pipe[1]);
+        g_dump_pipe[0] = g_dump_pipe[1] = -1;
+        throw std::runtime_error("Cannot install trace dump signal handler");
+    }
+
+    thread = std::thread(&TraceSignalDumper::run, this);
+}
+
+TraceSignalDumper::~TraceSignalDumper() {
+    signal(signum, SIG_DFL);
+    char request = 'q';
+    ssize_t written = write(g_dump_pipe[1], &request, 1);
+    (void)written;
+    thread.join();
+    close(g_dump_pipe[0]);
+    close(g_dump_pipe[1]);
+    g_dump_pipe[0] = g_dump_pipe[1] = -1;
+}
+
+void TraceSignalDumper::run() {
+    Tracer::setThreadName("trace-dump");
+    int dumps = 0;
+    char request;
+    while (true) {
+        ssize_t got = read(g_dump_pipe[0], &request, 1);
+        if (got < 0 && errno == EINTR) {
+            continue;
+        }
+        if (got <= 0 || request == 'q') {
+            break;
+        }
+
+        std::string path = prefix + "-" + std::to_string(++dumps) + ".json";
+        if (Tracer::dump(path)) {
+            std::cout << "Trace written to " << path << std::endl;
+        }
+    }
+}
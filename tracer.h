@@ -0,0 +1,114 @@
+#ifndef TRACER_H
+#define TRACER_H
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <chrono>
+#include <cstdint>
+
+// Always-on latency tracing for finding stalls on the device. Each thread
+// records its scopes into its own fixed ring of the most recent events, so
+// a trace point is two clock reads and a few stores, with no locks and no
+// allocation after the thread's first event. dump() writes every
+// ring as Chrome trace JSON, which chrome://tracing and ui.perfetto.dev open.
+//
+// Build with -DDISABLE_TRACING to compile the trace points out entirely.
+class Tracer {
+public:
+    // Events kept per thread; older ones are overwritten
+    static const size_t kEventsPerThread = 4096;
+
+    // Names the calling thread in the trace
+    static void setThreadName(const std::string& name);
+
+    // Scopes started while disabled are not recorded
+    static void setEnabled(bool enabled);
+    static bool isEnabled() { return enabled.load(std::memory_order_relaxed); }
+
+    // `name` must be a string literal (TRACE_SCOPE enforces this)
+    static void record(const char* name, int64_t start_ns, int64_t end_ns);
+
+    static int64_t nowNanos() {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    // Writes every thread's events to `path`. Safe while threads are still
+    // recording; events overwritten during the dump are left out.
+    static bool dump(const std::string& path);
+
+private:
+    // A per-slot seqlock: `seq` is the event index + 1 once the event is
+    // complete and 0 while the writer is overwriting it
+    struct Slot {
+        std::atomic<uint64_t> seq;
+        std::atomic<const char*> name;
+        std::atomic<int64_t> start_ns;
+        std::atomic<int64_t> duration_ns;
+    };
+
+    // Single-writer ring owned by one thread
+    struct ThreadBuffer {
+        int tid;
+        std::string name;                 // Guarded by the registry mutex
+        std::atomic<uint64_t> head;       // Events ever recorded
+        Slot slots[kEventsPerThread];
+    };
+
+    static std::atomic<bool> enabled;
+    // Buffers outlive their threads so a dump still shows threads that exited
+    static std::mutex registry_mutex;
+    static std::vector<std::unique_ptr<ThreadBuffer>> buffers;
+
+    static ThreadBuffer* threadBuffer();
+};
+
+// Records the time from construction to the end of the enclosing scope
+class TraceScope {
+public:
+    explicit TraceScope(const char* name)
+        : name(name), start_ns(Tracer::isEnabled() ? Tracer::nowNanos() : 0) {}
+    ~TraceScope() {
+        if (start_ns != 0) {
+            Tracer::record(name, start_ns, Tracer::nowNanos());
+        }
+    }
+
+    TraceScope(const TraceScope&) = delete;
+    TraceScope& operator=(const TraceScope&) = delete;
+
+private:
+    const char* name;
+    int64_t start_ns;
+};
+
+// Dumps the trace to `<prefix>-<n>.json` each time `signum` arrives. The
+// signal handler only writes to a pipe; a background thread does the dump.
+// Throws std::runtime_error if the pipe or handler can't be set up.
+class TraceSignalDumper {
+public:
+    TraceSignalDumper(int signum, const std::string& prefix);
+    ~TraceSignalDumper();
+
+private:
+    int signum;
+    std::string prefix;
+    std::thread thread;
+
+    void run();
+};
+
+#ifdef DISABLE_TRACING
+#define TRACE_SCOPE(name) do {} while (0)
+#else
+#define TRACE_CONCAT_INNER(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_INNER(a, b)
+// The empty literal rejects anything that isn't a string literal
+#define TRACE_SCOPE(name) TraceScope TRACE_CONCAT(trace_scope_, __LINE__)("" name)
+#endif
+
+#endif // TRACER_H
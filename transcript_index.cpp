@@ -0,0 +1,841 @@
+#include "transcript_index.h"
+#include <iostream>
+#include <stdexcept>
+#include <algorithm>
+#include <deque>
+#include <cctype>
+#include <cstring>
+#include <cstdio>
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include "file_io.h"
+
+// Segment file layout:
+//   SegmentHeader | postings | term strings | DictionaryEntry[term_count]
+// The dictionary is sorted by term so lookups are a binary search on the
+// mapping. Integers are native-endian; the files never leave the device.
+//
+// Postings for one term: for each transcription, varint(sequence delta),
+// varint(word count), then varint(word offset delta) per occurrence. The
+// first sequence delta is taken from 0, so lists can be concatenated by
+// re-encoding only their first entry.
+static const char kSegmentMagic[8] = {'T', 'I', 'D', 'X', '0', '0', '0', '1'};
+static const char kSegmentPrefix[] = "index-";
+static const char kSegmentSuffix[] = ".tix";
+
+struct SegmentHeader {
+    char magic[8];
+    uint64_t first_sequence;
+    uint64_t last_sequence;
+    uint64_t term_count;
+    uint64_t strings_offset;
+    uint64_t dictionary_offset;
+};
+
+struct DictionaryEntry {
+    uint64_t postings_offset;
+    uint64_t last_sequence;
+    uint32_t postings_bytes;
+    uint32_t documents;
+    uint32_t term_offset;
+    uint32_t term_length;
+};
+
+static_assert(sizeof(DictionaryEntry) == 32, "DictionaryEntry is an on-disk layout");
+
+// Words longer than this are not indexed (URLs, garbage from the decoder)
+static const size_t kMaxTermBytes = 64;
+
+// Merge this many adjacent segments of the same size tier
+static const size_t kMergeFactor = 4;
+static const size_t kBaseTierBytes = 256 * 1024;
+
+// Postings are buffered and written out in chunks of this size
+static const size_t kWriteChunkBytes = 64 * 1024;
+
+static void putVarint(std::vector<uint8_t>& out, uint64_t value) {
+    while (value >= 0x80) {
+        out.push_back(static_cast<uint8_t>(value | 0x80));
+        value >>= 7;
+    }
+    out.push_back(static_cast<uint8_t>(value));
+}
+
+static bool getVarint(const uint8_t*& in, const uint8_t* end, uint64_t& value) {
+    value = 0;
+    for (int shift = 0; shift < 64 && in < end; shift += 7) {
+        uint8_t byte = *in++;
+        value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+        if ((byte & 0x80) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static int compareTerms(const char* a, size_t a_length, const char* b, size_t b_length) {
+    int order = std::memcmp(a, b, std::min(a_length, b_length));
+    if (order != 0) {
+        return order;
+    }
+    return a_length < b_length ? -1 : (a_length > b_length ? 1 : 0);
+}
+
+static int sizeTier(size_t bytes) {
+    int tier = 0;
+    for (size_t limit = kBaseTierBytes; bytes >= limit && tier < 30; limit *= kMergeFactor) {
+        tier++;
+    }
+    return tier;
+}
+
+// Walks one term's postings a transcription at a time
+class PostingCursor {
+public:
+    PostingCursor(const uint8_t* data, size_t bytes, uint32_t documents)
+        : in(data), end(data + bytes), remaining(documents), current(0), valid(false) {}
+
+    bool next() {
+        valid = false;
+        if (remaining == 0) {
+            return false;
+        }
+        uint64_t delta;
+        uint64_t count;
+        if (!getVarint(in, end, delta) || !getVarint(in, end, count) ||
+            count > static_cast<uint64_t>(end - in)) {
+            remaining = 0;
+            return false;
+        }
+        current += delta;
+        word_offsets.resize(static_cast<size_t>(count));
+        uint64_t offset = 0;
+        for (uint64_t& word : word_offsets) {
+            uint64_t step;
+            if (!getVarint(in, end, step)) {
+                remaining = 0;
+                return false;
+            }
+            offset += step;
+            word = offset;
+        }
+        remaining--;
+        valid = true;
+        return true;
+    }
+
+    // Moves to the first transcription at or after `target`
+    bool advanceTo(uint64_t target) {
+        while (!valid || current < target) {
+            if (!next()) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    uint64_t sequence() const { return current; }
+
+    bool hasWordAt(uint64_t offset) const {
+        return std::binary_search(word_offsets.begin(), word_offsets.end(), offset);
+    }
+
+    const std::vector<uint64_t>& wordOffsets() const { return word_offsets; }
+
+private:
+    const uint8_t* in;
+    const uint8_t* end;
+    uint32_t remaining;
+    uint64_t current;
+    bool valid;
+    std::vector<uint64_t> word_offsets;
+};
+
+struct PostingList {
+    const uint8_t* data = nullptr;
+    size_t bytes = 0;
+    uint32_t documents = 0;
+};
+
+// Finds the matches in one source (buffer or segment). `lists` holds one
+// posting list per distinct query term; `words` maps each query word to
+// its list. Keeps only the newest `max_results` matches, oldest first.
+static void matchPostings(const std::vector<PostingList>& lists, const std::vector<size_t>& words,
+                          TranscriptIndex::MatchMode mode, size_t max_results,
+                          std::deque<uint64_t>& matches) {
+    std::vector<PostingCursor> cursors;
+    cursors.reserve(lists.size());
+    for (const PostingList& list : lists) {
+        cursors.emplace_back(list.data, list.bytes, list.documents);
+    }
+
+    uint64_t target = 0;
+    while (true) {
+        // Leapfrog until every cursor sits on the same transcription
+        bool aligned = true;
+        for (PostingCursor& cursor : cursors) {
+            if (!cursor.advanceTo(target)) {
+                return;
+            }
+            if (cursor.sequence() != target) {
+                target = cursor.sequence();
+                aligned = false;
+            }
+        }
+        if (!aligned) {
+            continue;
+        }
+
+        bool match = true;
+        if (mode == TranscriptIndex::PHRASE) {
+            match = false;
+            for (uint64_t start : cursors[words[0]].wordOffsets()) {
+                size_t i = 1;
+                while (i < words.size() && cursors[words[i]].hasWordAt(start + i)) {
+                    i++;
+                }
+                if (i == words.size()) {
+                    match = true;
+                    break;
+                }
+            }
+        }
+        if (match) {
+            matches.push_back(target);
+            if (matches.size() > max_results) {
+                matches.pop_front();
+            }
+        }
+        target++;
+    }
+}
+
+// Writes one immutable segment file. Terms must be added in sorted order.
+class SegmentWriter {
+public:
+    SegmentWriter() : fd(-1), offset(0), failed(false) {}
+
+    ~SegmentWriter() {
+        if (fd >= 0) {
+            close(fd);
+            unlink(temp_path.c_str());
+        }
+    }
+
+    bool open(const std::string& final_path) {
+        path = final_path;
+        temp_path = path + ".tmp";
+        fd = ::open(temp_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if (fd < 0) {
+            return false;
+        }
+        // Header is filled in by finish()
+        pending.assign(sizeof(SegmentHeader), 0);
+        offset = 0;
+        return true;
+    }
+
+    void beginTerm(const char* term, size_t length) {
+        DictionaryEntry entry = {};
+        entry.postings_offset = offset + pending.size();
+        entry.term_offset = static_cast<uint32_t>(strings.size());
+        entry.term_length = static_cast<uint32_t>(length);
+        dictionary.push_back(entry);
+        strings.insert(strings.end(), term, term + length);
+    }
+
+    // Appends a posting list whose sequences all follow the ones already
+    // added for this term
+    void appendPostings(const uint8_t* data, size_t bytes, uint32_t documents,
+                        uint64_t last_sequence) {
+        DictionaryEntry& entry = dictionary.back();
+        size_t before = pending.size();
+        if (entry.documents == 0) {
+            pending.insert(pending.end(), data, data + bytes);
+        } else {
+            // Rebase the list's first sequence on this term's previous one
+            const uint8_t* in = data;
+            uint64_t first;
+            if (!getVarint(in, data + bytes, first)) {
+                failed = true;
+                return;
+            }
+            putVarint(pending, first - entry.last_sequence);
+            pending.insert(pending.end(), in, data + bytes);
+        }
+        entry.postings_bytes += static_cast<uint32_t>(pending.size() - before);
+        entry.documents += documents;
+        entry.last_sequence = last_sequence;
+
+        if (pending.size() >= kWriteChunkBytes) {
+            flushPending();
+        }
+    }
+
+    bool finish(uint64_t first_sequence, uint64_t last_sequence) {
+        flushPending();
+        // The dictionary is read in place, so align it
+        while ((offset + strings.size()) % alignof(DictionaryEntry) != 0) {
+            strings.push_back('\0');
+        }
+
+        SegmentHeader header = {};
+        std::memcpy(header.magic, kSegmentMagic, sizeof(header.magic));
+        header.first_sequence = first_sequence;
+        header.last_sequence = last_sequence;
+        header.term_count = dictionary.size();
+        header.strings_offset = offset;
+        header.dictionary_offset = offset + strings.size();
+
+        if (failed || !writeAll(fd, strings.data(), strings.size()) ||
+            !writeAll(fd, dictionary.data(), dictionary.size() * sizeof(DictionaryEntry)) ||
+            pwrite(fd, &header, sizeof(header), 0) != static_cast<ssize_t>(sizeof(header)) ||
+            fdatasync(fd) != 0) {
+            return false;
+        }
+        close(fd);
+        fd = -1;
+
+        if (rename(temp_path.c_str(), path.c_str()) != 0) {
+            unlink(temp_path.c_str());
+            return false;
+        }
+        syncDirectory(path.substr(0, path.rfind('/')));
+        return true;
+    }
+
+private:
+    int fd;
+    std::string path;
+    std::string temp_path;
+    std::vector<uint8_t> pending;
+    uint64_t offset;                  // File offset of pending[0]
+    std::vector<char> strings;
+    std::vector<DictionaryEntry> dictionary;
+    bool failed;
+
+    void flushPending() {
+        if (!failed && !writeAll(fd, pending.data(), pending.size())) {
+            failed = true;
+        }
+        offset += pending.size();
+        pending.clear();
+    }
+};
+
+// An mmap'd, immutable segment file
+class TranscriptIndex::Segment {
+public:
+    static std::shared_ptr<const Segment> open(const std::string& path) {
+        std::shared_ptr<Segment> segment(new Segment(path));
+        if (!segment->map()) {
+            return nullptr;
+        }
+        return segment;
+    }
+
+    ~Segment() {
+        if (address != nullptr) {
+            munmap(address, length);
+        }
+    }
+
+    bool find(const std::string& term, PostingList& list) const {
+        const DictionaryEntry* first = dictionary;
+        const DictionaryEntry* last = dictionary + term_count;
+        const DictionaryEntry* it = std::lower_bound(
+            first, last, term, [this](const DictionaryEntry& entry, const std::string& key) {
+                return compareTerms(termData(entry), entry.term_length, key.data(), key.size()) < 0;
+            });
+        if (it == last ||
+            compareTerms(termData(*it), it->term_length, term.data(), term.size()) != 0) {
+            return false;
+        }
+        list.data = postings(*it);
+        list.bytes = it->postings_bytes;
+        list.documents = it->documents;
+        return true;
+    }
+
+    size_t termCount() const { return term_count; }
+    const DictionaryEntry& entry(size_t i) const { return dictionary[i]; }
+    const char* termData(const DictionaryEntry& entry) const { return strings + entry.term_offset; }
+    const uint8_t* postings(const DictionaryEntry& entry) const {
+        return reinterpret_cast<const uint8_t*>(base()) + entry.postings_offset;
+    }
+
+    std::string path;
+    uint64_t first_sequence;
+    uint64_t last_sequence;
+    size_t length;
+
+private:
+    explicit Segment(const std::string& path)
+        : path(path), first_sequence(0), last_sequence(0), length(0), address(nullptr),
+          strings(nullptr), dictionary(nullptr), term_count(0) {}
+    Segment(const Segment&) = delete;
+    Segment& operator=(const Segment&) = delete;
+
+    void* address;
+    const char* strings;
+    const DictionaryEntry* dictionary;
+    size_t term_count;
+
+    const char* base() const { return static_cast<const char*>(address); }
+
+    bool map() {
+        int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            return false;
+        }
+        struct stat info;
+        if (fstat(fd, &info) != 0 || static_cast<size_t>(info.st_size) < sizeof(SegmentHeader)) {
+            close(fd);
+            return false;
+        }
+        length = static_cast<size_t>(info.st_size);
+        void* mapped = mmap(nullptr, length, PROT_READ, MAP_SHARED, fd, 0);
+        close(fd);
+        if (mapped == MAP_FAILED) {
+            return false;
+        }
+        address = mapped;
+
+        const SegmentHeader* header = static_cast<const SegmentHeader*>(address);
+        if (std::memcmp(header->magic, kSegmentMagic, sizeof(kSegmentMagic)) != 0 ||
+            header->strings_offset < sizeof(SegmentHeader) ||
+            header->dictionary_offset < header->strings_offset ||
+            header->dictionary_offset % alignof(DictionaryEntry) != 0 ||
+            header->term_count > (length - std::min<uint64_t>(header->dictionary_offset, length)) /
+                                     sizeof(DictionaryEntry)) {
+            return false;
+        }
+        first_sequence = header->first_sequence;
+        last_sequence = header->last_sequence;
+        term_count = static_cast<size_t>(header->term_count);
+        strings = base() + header->strings_offset;
+        dictionary = reinterpret_cast<const DictionaryEntry*>(base() + header->dictionary_offset);
+
+        // Check every entry once so lookups can trust the offsets
+        uint64_t strings_bytes = header->dictionary_offset - header->strings_offset;
+        for (size_t i = 0; i < term_count; i++) {
+            const DictionaryEntry& entry = dictionary[i];
+            if (static_cast<uint64_t>(entry.term_offset) + entry.term_length > strings_bytes ||
+                entry.postings_offset < sizeof(SegmentHeader) ||
+                entry.postings_offset + entry.postings_bytes > header->strings_offset) {
+                return false;
+            }
+        }
+        return true;
+    }
+};
+
+TranscriptIndex::TranscriptIndex(const std::string& directory, size_t memory_budget_bytes)
+    : directory(directory), memory_budget(memory_budget_bytes), active(new MemoryBuffer()),
+      indexed_through(0), stopping(false) {
+    if (mkdir(directory.c_str(), 0755) != 0 && errno != EEXIST) {
+        throw std::runtime_error("Cannot create index directory " + directory + ": " +
+                                 std::strerror(errno));
+    }
+    loadSegments();
+    worker = std::thread(&TranscriptIndex::workerLoop, this);
+}
+
+TranscriptIndex::~TranscriptIndex() {
+    flush();
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    work_ready.notify_all();
+    worker.join();
+}
+
+void TranscriptIndex::loadSegments() {
+    struct Found {
+        uint64_t first;
+        uint64_t last;
+        std::string path;
+    };
+    std::vector<Found> found;
+
+    DIR* dir = opendir(directory.c_str());
+    if (dir == nullptr) {
+        return;
+    }
+    while (struct dirent* entry = readdir(dir)) {
+        std::string name = entry->d_name;
+        std::string path = directory + "/" + name;
+        if (name.size() > 4 && name.compare(name.size() - 4, 4, ".tmp") == 0) {
+            // Left behind by a write that never finished
+            unlink(path.c_str());
+            continue;
+        }
+        unsigned long long first;
+        unsigned long long last;
+        char suffix[8];
+        if (std::sscanf(name.c_str(), "index-%16llx-%16llx%7s", &first, &last, suffix) == 3 &&
+            std::strcmp(suffix, kSegmentSuffix) == 0) {
+            found.push_back({first, last, path});
+        }
+    }
+    closedir(dir);
+
+    std::sort(found.begin(), found.end(), [](const Found& a, const Found& b) {
+        return a.first != b.first ? a.first < b.first : a.last > b.last;
+    });
+
+    for (const Found& candidate : found) {
+        if (indexed_through > 0 && candidate.last <= indexed_through) {
+            // Input of a merge that finished, but was not yet deleted
+            unlink(candidate.path.c_str());
+            continue;
+        }
+        std::shared_ptr<const Segment> segment;
+        if ((indexed_through == 0 || candidate.first == indexed_through + 1)) {
+            segment = Segment::open(candidate.path);
+        }
+        if (!segment) {
+            // A damaged segment or a gap; drop it and let the log replay
+            // from here
+            std::cerr << "Discarding index segment " << candidate.path << std::endl;
+            unlink(candidate.path.c_str());
+            continue;
+        }
+        indexed_through = segment->last_sequence;
+        segments.push_back(segment);
+    }
+}
+
+void TranscriptIndex::tokenize(const std::string& text, std::vector<std::string>& terms) {
+    terms.clear();
+    std::string word;
+    size_t length = text.size();
+    for (size_t i = 0; i <= length; i++) {
+        unsigned char c = i < length ? static_cast<unsigned char>(text[i]) : ' ';
+        bool word_char = std::isalnum(c) || c >= 0x80;
+        // Keep contractions like "don't" together
+        if (c == '\'' && !word.empty() && i + 1 < length &&
+            std::isalnum(static_cast<unsigned char>(text[i + 1]))) {
+            word_char = true;
+        }
+        if (word_char) {
+            word.push_back(static_cast<char>(c < 0x80 ? std::tolower(c) : c));
+            continue;
+        }
+        if (!word.empty()) {
+            // Over-long words still take up an offset, so phrases can't
+            // match across them
+            terms.push_back(word.size() <= kMaxTermBytes ? word : std::string());
+            word.clear();
+        }
+    }
+}
+
+void TranscriptIndex::add(uint64_t sequence, const std::string& text) {
+    std::vector<std::string> words;
+    tokenize(text, words);
+
+    // Word offsets per distinct term, in order of first appearance
+    std::vector<std::pair<std::string, std::vector<uint32_t>>> occurrences;
+    for (size_t offset = 0; offset < words.size(); offset++) {
+        if (words[offset].empty()) {
+            continue;
+        }
+        auto it = std::find_if(occurrences.begin(), occurrences.end(),
+                               [&](const std::pair<std::string, std::vector<uint32_t>>& term) {
+                                   return term.first == words[offset];
+                               });
+        if (it == occurrences.end()) {
+            occurrences.emplace_back(words[offset], std::vector<uint32_t>());
+            it = occurrences.end() - 1;
+        }
+        it->second.push_back(static_cast<uint32_t>(offset));
+    }
+
+    std::unique_lock<std::mutex> lock(mutex);
+    if (sequence <= indexed_through) {
+        return;
+    }
+    if (active->first_sequence == 0) {
+        active->first_sequence = sequence;
+    }
+    for (const auto& term : occurrences) {
+        auto inserted = active->terms.emplace(term.first, TermPostings());
+        TermPostings& postings = inserted.first->second;
+        if (inserted.second) {
+            // Node, key and bookkeeping, roughly
+            active->bytes += term.first.size() + 96;
+        }
+        size_t before = postings.bytes.size();
+        putVarint(postings.bytes, sequence - postings.last_sequence);
+        putVarint(postings.bytes, term.second.size());
+        uint32_t previous = 0;
+        for (uint32_t offset : term.second) {
+            putVarint(postings.bytes, offset - previous);
+            previous = offset;
+        }
+        active->bytes += postings.bytes.size() - before;
+        postings.last_sequence = sequence;
+        postings.documents++;
+    }
+    active->last_sequence = sequence;
+    indexed_through = sequence;
+
+    if (active->bytes >= memory_budget) {
+        // Only one buffer is written at a time; if the worker is still busy
+        // with the previous one, wait rather than grow without bound
+        flush_done.wait(lock, [this] { return !frozen; });
+        frozen = std::move(active);
+        active.reset(new MemoryBuffer());
+        work_ready.notify_one();
+    }
+}
+
+void TranscriptIndex::flush() {
+    std::unique_lock<std::mutex> lock(mutex);
+    flush_done.wait(lock, [this] { return !frozen; });
+    if (active->terms.empty()) {
+        return;
+    }
+    frozen = std::move(active);
+    active.reset(new MemoryBuffer());
+    work_ready.notify_one();
+    flush_done.wait(lock, [this] { return !frozen; });
+}
+
+size_t TranscriptIndex::search(const std::string& query, std::vector<uint64_t>& sequences,
+                               size_t max_results, MatchMode mode) const {
+    std::vector<std::string> words;
+    tokenize(query, words);
+    words.erase(std::remove(words.begin(), words.end(), std::string()), words.end());
+    if (words.empty() || max_results == 0) {
+        return 0;
+    }
+
+    std::vector<std::string> terms;
+    std::vector<size_t> word_terms;
+    for (const std::string& word : words) {
+        auto it = std::find(terms.begin(), terms.end(), word);
+        word_terms.push_back(it - terms.begin());
+        if (it == terms.end()) {
+            terms.push_back(word);
+        }
+    }
+
+    size_t added = 0;
+    std::deque<uint64_t> matches;
+    std::vector<PostingList> lists(terms.size());
+    auto collect = [&]() {
+        while (!matches.empty() && added < max_results) {
+            sequences.push_back(matches.back());
+            matches.pop_back();
+            added++;
+        }
+        matches.clear();
+    };
+    auto searchBuffer = [&](const MemoryBuffer& buffer) {
+        for (size_t i = 0; i < terms.size(); i++) {
+            auto it = buffer.terms.find(terms[i]);
+            if (it == buffer.terms.end()) {
+                return;
+            }
+            lists[i].data = it->second.bytes.data();
+            lists[i].bytes = it->second.bytes.size();
+            lists[i].documents = it->second.documents;
+        }
+        matchPostings(lists, word_terms, mode, max_results - added, matches);
+        collect();
+    };
+
+    // Newest first: the active buffer, the one being written, then segments
+    std::shared_ptr<const MemoryBuffer> writing;
+    std::vector<std::shared_ptr<const Segment>> snapshot;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        searchBuffer(*active);
+        writing = frozen;
+        snapshot = segments;
+    }
+    if (writing && added < max_results) {
+        searchBuffer(*writing);
+    }
+    for (auto it = snapshot.rbegin(); it != snapshot.rend() && added < max_results; ++it) {
+        bool found = true;
+        for (size_t i = 0; i < terms.size() && found; i++) {
+            found = (*it)->find(terms[i], lists[i]);
+        }
+        if (found) {
+            matchPostings(lists, word_terms, mode, max_results - added, matches);
+            collect();
+        }
+    }
+    return added;
+}
+
+uint64_t TranscriptIndex::getIndexedThrough() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return indexed_through;
+}
+
+size_t TranscriptIndex::getSegmentCount() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return segments.size();
+}
+
+std::string TranscriptIndex::segmentPath(uint64_t first_sequence, uint64_t last_sequence) const {
+    char name[64];
+    std::snprintf(name, sizeof(name), "%s%016llx-%016llx%s", kSegmentPrefix,
+                  static_cast<unsigned long long>(first_sequence),
+                  static_cast<unsigned long long>(last_sequence), kSegmentSuffix);
+    return directory + "/" + name;
+}
+
+std::shared_ptr<const TranscriptIndex::Segment>
+TranscriptIndex::writeBuffer(const MemoryBuffer& buffer) const {
+    std::vector<const std::pair<const std::string, TermPostings>*> sorted;
+    sorted.reserve(buffer.terms.size());
+    for (const auto& term : buffer.terms) {
+        sorted.push_back(&term);
+    }
+    std::sort(sorted.begin(), sorted.end(), [](const std::pair<const std::string, TermPostings>* a,
+                                               const std::pair<const std::string, TermPostings>* b) {
+        return compareTerms(a->first.data(), a->first.size(), b->first.data(), b->first.size()) < 0;
+    });
+
+    std::string path = segmentPath(buffer.first_sequence, buffer.last_sequence);
+    SegmentWriter writer;
+    if (!writer.open(path)) {
+        return nullptr;
+    }
+    for (const auto* term : sorted) {
+        writer.beginTerm(term->first.data(), term->first.size());
+        writer.appendPostings(term->second.bytes.data(), term->second.bytes.size(),
+                              term->second.documents, term->second.last_sequence);
+    }
+    if (!writer.finish(buffer.first_sequence, buffer.last_sequence)) {
+        return nullptr;
+    }
+    return Segment::open(path);
+}
+
+bool TranscriptIndex::mergeOnce() {
+    // Only the worker changes the segment list, so reading it under the
+    // lock and merging outside it is safe
+    std::vector<std::shared_ptr<const Segment>> inputs;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (segments.size() < kMergeFactor) {
+            return false;
+        }
+        inputs.assign(segments.end() - kMergeFactor, segments.end());
+    }
+    int tier = sizeTier(inputs[0]->length);
+    for (const auto& input : inputs) {
+        if (sizeTier(input->length) != tier) {
+            return false;
+        }
+    }
+
+    uint64_t first_sequence = inputs.front()->first_sequence;
+    uint64_t last_sequence = inputs.back()->last_sequence;
+    std::string path = segmentPath(first_sequence, last_sequence);
+    SegmentWriter writer;
+    if (!writer.open(path)) {
+        return false;
+    }
+
+    // K-way merge of the sorted dictionaries; for each term the inputs'
+    // lists are concatenated oldest first
+    std::vector<size_t> positions(inputs.size(), 0);
+    while (true) {
+        const char* smallest = nullptr;
+        size_t smallest_length = 0;
+        for (size_t i = 0; i < inputs.size(); i++) {
+            if (positions[i] == inputs[i]->termCount()) {
+                continue;
+            }
+            const DictionaryEntry& entry = inputs[i]->entry(positions[i]);
+            const char* term = inputs[i]->termData(entry);
+            if (!smallest ||
+                compareTerms(term, entry.term_length, smallest, smallest_length) < 0) {
+                smallest = term;
+                smallest_length = entry.term_length;
+            }
+        }
+        if (!smallest) {
+            break;
+        }
+
+        std::string term(smallest, smallest_length);
+        writer.beginTerm(term.data(), term.size());
+        for (size_t i = 0; i < inputs.size(); i++) {
+            if (positions[i] == inputs[i]->termCount()) {
+                continue;
+            }
+            const DictionaryEntry& entry = inputs[i]->entry(positions[i]);
+            if (compareTerms(inputs[i]->termData(entry), entry.term_length,
+                             term.data(), term.size()) == 0) {
+                writer.appendPostings(inputs[i]->postings(entry), entry.postings_bytes,
+                                      entry.documents, entry.last_sequence);
+                positions[i]++;
+            }
+        }
+    }
+
+    std::shared_ptr<const Segment> merged;
+    if (writer.finish(first_sequence, last_sequence)) {
+        merged = Segment::open(path);
+    }
+    if (!merged) {
+        std::cerr << "Failed to merge index segments into " << path << std::endl;
+        return false;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        segments.erase(segments.end() - kMergeFactor, segments.end());
+        segments.push_back(merged);
+    }
+    // Searches still holding the old segments keep their mappings alive
+    for (const auto& input : inputs) {
+        unlink(input->path.c_str());
+    }
+    return true;
+}
+
+void TranscriptIndex::workerLoop() {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+        work_ready.wait(lock, [this] { return stopping || frozen; });
+        if (!frozen) {
+            return;
+        }
+
+        std::shared_ptr<const MemoryBuffer> buffer = frozen;
+        lock.unlock();
+        std::shared_ptr<const Segment> segment = writeBuffer(*buffer);
+        if (!segment) {
+            std::cerr << "Failed to write index segment for sequences " << buffer->first_sequence
+                      << "-" << buffer->last_sequence << std::endl;
+        }
+        lock.lock();
+
+        if (segment) {
+            segments.push_back(segment);
+        }
+        // On failure the postings are dropped; they are rebuilt from the
+        // log on the next start, since the segments now end before them
+        frozen.reset();
+        flush_done.notify_all();
+
+        lock.unlock();
+        while (mergeOnce()) {
+        }
+        lock.lock();
+    }
+}
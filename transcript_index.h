@@ -0,0 +1,92 @@
+#ifndef TRANSCRIPT_INDEX_H
+#define TRANSCRIPT_INDEX_H
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <cstdint>
+
+// Inverted full-text index over stored transcriptions: term -> postings of
+// (sequence number, word offsets in the transcription).
+//
+// New postings go into an in-memory buffer. Once the buffer reaches its
+// memory budget it is frozen and a background thread writes it out as an
+// immutable segment file, which is then mmap'd. Postings are delta/varint
+// coded. The same thread merges runs of similar-sized segments so there are
+// only O(log n) of them. A merge streams postings without decoding them,
+// so memory stays bounded by the vocabulary, not by the amount of history.
+//
+// Everything here can be rebuilt from the log. A crash loses at most the
+// unflushed buffer, and the owner replays the records after
+// getIndexedThrough().
+class TranscriptIndex {
+public:
+    enum MatchMode {
+        ALL_TERMS,   // Every query term appears somewhere in the transcription
+        PHRASE       // The query terms appear consecutively, in order
+    };
+
+    TranscriptIndex(const std::string& directory, size_t memory_budget_bytes = 256 * 1024);
+    ~TranscriptIndex();
+
+    // Sequences must be added in increasing order
+    void add(uint64_t sequence, const std::string& text);
+
+    // Sequences of matching transcriptions, newest first. Returns how many
+    // were appended to `sequences`.
+    size_t search(const std::string& query, std::vector<uint64_t>& sequences,
+                  size_t max_results = SIZE_MAX, MatchMode mode = ALL_TERMS) const;
+
+    // Highest sequence added so far, whether or not it is on disk yet
+    uint64_t getIndexedThrough() const;
+
+    // Writes the in-memory buffer out and waits for it
+    void flush();
+
+    size_t getSegmentCount() const;
+
+    // Lower-cased words in order, as the index sees them; a word's offset
+    // is its position in `terms`
+    static void tokenize(const std::string& text, std::vector<std::string>& terms);
+
+private:
+    struct TermPostings {
+        std::vector<uint8_t> bytes;   // Encoded postings, first sequence absolute
+        uint64_t last_sequence = 0;
+        uint32_t documents = 0;
+    };
+
+    struct MemoryBuffer {
+        std::unordered_map<std::string, TermPostings> terms;
+        uint64_t first_sequence = 0;
+        uint64_t last_sequence = 0;
+        size_t bytes = 0;             // Rough memory footprint
+    };
+
+    class Segment;
+
+    std::string directory;
+    size_t memory_budget;
+
+    mutable std::mutex mutex;
+    std::condition_variable work_ready;
+    std::condition_variable flush_done;
+    std::unique_ptr<MemoryBuffer> active;
+    std::shared_ptr<const MemoryBuffer> frozen;     // Being written by the worker
+    std::vector<std::shared_ptr<const Segment>> segments;   // Oldest first
+    uint64_t indexed_through;
+    bool stopping;
+    std::thread worker;
+
+    void loadSegments();
+    void workerLoop();
+    std::shared_ptr<const Segment> writeBuffer(const MemoryBuffer& buffer) const;
+    bool mergeOnce();
+    std::string segmentPath(uint64_t first_sequence, uint64_t last_sequence) const;
+};
+
+#endif // TRANSCRIPT_INDEX_H
@@ -0,0 +1,114 @@
+#include "transcription_history.h"
+#include <stdexcept>
+#include <algorithm>
+#include <cstring>
+
+// Readers racing with a writer retry; after this many they give up on the
+// slot, which can only happen if the writer laps them repeatedly
+static const int kMaxReadRetries = 16;
+
+TranscriptionHistory::TranscriptionHistory(size_t capacity, size_t max_text_bytes)
+    : slot_count(capacity), max_text(max_text_bytes), slots(capacity),
+      text_storage(capacity * max_text_bytes), latest(0) {
+    if (capacity == 0 || max_text_bytes == 0) {
+        throw std::invalid_argument("Transcription history needs capacity and text space");
+    }
+    for (Slot& slot : slots) {
+        slot.version.store(0, std::memory_order_relaxed);
+        slot.sequence = 0;
+        slot.timeUs = 0;
+        slot.length = 0;
+        slot.truncated = false;
+    }
+}
+
+uint64_t TranscriptionHistory::append(const std::string& text, int64_t time_us) {
+    uint64_t sequence = latest.load(std::memory_order_relaxed) + 1;
+    Slot& slot = slots[sequence % slot_count];
+    char* storage = &text_storage[(sequence % slot_count) * max_text];
+
+    size_t length = std::min(text.size(), max_text);
+    bool truncated = length < text.size();
+    if (truncated) {
+        // Don't cut a UTF-8 sequence in half
+        while (length > 0 && (static_cast<unsigned char>(text[length]) & 0xC0) == 0x80) {
+            length--;
+        }
+    }
+
+    uint32_t version = slot.version.load(std::memory_order_relaxed);
+    slot.version.store(version + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    slot.sequence = sequence;
+    slot.timeUs = time_us;
+    slot.length = static_cast<uint32_t>(length);
+    slot.truncated = truncated;
+    std::memcpy(storage, text.data(), length);
+
+    slot.version.store(version + 2, std::memory_order_release);
+    latest.store(sequence, std::memory_order_release);
+    return sequence;
+}
+
+bool TranscriptionHistory::readSlot(uint64_t sequence, Entry& entry) const {
+    const Slot& slot = slots[sequence % slot_count];
+    const char* storage = &text_storage[(sequence % slot_count) * max_text];
+
+    for (int attempt = 0; attempt < kMaxReadRetries; attempt++) {
+        uint32_t before = slot.version.load(std::memory_order_acquire);
+        if (before & 1) {
+            continue;
+        }
+
+        // Copies may see a torn slot; the version check below discards them
+        uint64_t slot_sequence = slot.sequence;
+        int64_t time_us = slot.timeUs;
+        uint32_t length = std::min<uint32_t>(slot.length, static_cast<uint32_t>(max_text));
+        bool truncated = slot.truncated;
+        entry.text.assign(storage, length);
+
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (slot.version.load(std::memory_order_relaxed) != before) {
+            continue;
+        }
+
+        if (slot_sequence != sequence) {
+            // Already overwritten by a newer entry
+            return false;
+        }
+        entry.sequence = slot_sequence;
+        entry.timeUs = time_us;
+        entry.truncated = truncated;
+        return true;
+    }
+    return false;
+}
+
+size_t TranscriptionHistory::readSince(uint64_t after, std::vector<Entry>& out,
+                                       size_t max_entries) const {
+    uint64_t newest = latest.load(std::memory_order_acquire);
+    uint64_t first = std::max(after + 1, newest > slot_count ? newest - slot_count + 1 : 1);
+
+    size_t added = 0;
+    Entry entry;
+    for (uint64_t sequence = first; sequence <= newest && added < max_entries; sequence++) {
+        if (readSlot(sequence, entry)) {
+            out.push_back(std::move(entry));
+            added++;
+        }
+    }
+    return added;
+}
+
+uint64_t TranscriptionHistory::latestSequence() const {
+    return latest.load(std::memory_order_acquire);
+}
+
+uint64_t TranscriptionHistory::oldestSequence() const {
+    uint64_t newest = latest.load(std::memory_order_acquire);
+    if (newest == 0) {
+        return 0;
+    }
+    return newest > slot_count ? newest - slot_count + 1 : 1;
+}
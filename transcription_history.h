@@ -0,0 +1,59 @@
+#ifndef TRANSCRIPTION_HISTORY_H
+#define TRANSCRIPTION_HISTORY_H
+
+#include <string>
+#include <vector>
+#include <atomic>
+#include <cstdint>
+
+// Fixed-capacity ring of recent transcriptions. Every entry gets the next
+// sequence number (starting at 1), so consumers ask for "everything after
+// seq N" rather than diffing sizes. There is a single writer; readers never
+// block it. Each slot is guarded by a sequence lock: a reader that races
+// with the writer simply retries that slot, and entries overwritten before
+// a reader gets to them show up as a gap in the sequence numbers.
+class TranscriptionHistory {
+public:
+    struct Entry {
+        uint64_t sequence = 0;
+        int64_t timeUs = 0;        // Wall-clock time the speech was captured, us since epoch
+        std::string text;
+        bool truncated = false;    // Text was longer than the slot
+    };
+
+    TranscriptionHistory(size_t capacity = 128, size_t max_text_bytes = 2048);
+
+    // Writer only. Returns the sequence number of the new entry.
+    uint64_t append(const std::string& text, int64_t time_us);
+
+    // Appends entries with sequence > `after` that are still in the ring to
+    // `out`, oldest first, at most `max_entries`. Returns how many were added.
+    size_t readSince(uint64_t after, std::vector<Entry>& out,
+                     size_t max_entries = SIZE_MAX) const;
+
+    // Sequence of the newest entry, 0 if empty
+    uint64_t latestSequence() const;
+    // Oldest sequence still held, 0 if empty
+    uint64_t oldestSequence() const;
+
+    size_t capacity() const { return slot_count; }
+
+private:
+    struct Slot {
+        std::atomic<uint32_t> version;   // Odd while the writer is inside
+        uint64_t sequence;
+        int64_t timeUs;
+        uint32_t length;
+        bool truncated;
+    };
+
+    size_t slot_count;
+    size_t max_text;
+    std::vector<Slot> slots;
+    std::vector<char> text_storage;      // slot_count * max_text bytes
+    std::atomic<uint64_t> latest;
+
+    bool readSlot(uint64_t sequence, Entry& entry) const;
+};
+
+#endif // TRANSCRIPTION_HISTORY_H
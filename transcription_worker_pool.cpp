@@ -0,0 +1,369 @@
+#include "transcription_worker_pool.h"
+#include <iostream>
+#include <stdexcept>
+#include <algorithm>
+#include "tracer.h"
+
+static double millisecondsBetween(std::chrono::steady_clock::time_point from,
+                                  std::chrono::steady_clock::time_point to) {
+    return std::chrono::duration<double, std::milli>(to - from).count();
+}
+
+TranscriptionWorkerPool::TranscriptionWorkerPool(SpeechToText& stt, AudioBlockPool& pool,
+                                                 int workers, size_t queue_depth,
+                                                 BackpressurePolicy policy)
+    : stt(stt), pool(pool), queue_depth(queue_depth), policy(policy), threads_per_job(0),
+      running(0), stopping(false) {
+    if (workers < 1 || queue_depth < 1) {
+        throw std::invalid_argument("Transcription pool needs at least one worker and queue slot");
+    }
+
+    unsigned cores = std::max(1u, std::thread::hardware_concurrency());
+    threads_per_job = std::max(1, static_cast<int>(cores) / workers);
+
+    for (int i = 0; i < workers; i++) {
+        this->workers.emplace_back(&TranscriptionWorkerPool::workerLoop, this, static_cast<size_t>(i));
+    }
+}
+
+TranscriptionWorkerPool::~TranscriptionWorkerPool() {
+    std::deque<Job> abandoned;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+        abandoned.swap(queue);
+    }
+    job_ready.notify_all();
+    space_available.notify_all();
+
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+
+    // Nobody waits forever on a future for a job that never ran
+    for (Job& job : abandoned) {
+        Result result;
+        result.dropped = true;
+        result.merged_jobs = job.merged_jobs;
+        finish(job, result);
+    }
+}
+
+void TranscriptionWorkerPool::setThreadsPerJob(int n_threads) {
+    threads_per_job = std::max(0, n_threads);
+}
+
+void TranscriptionWorkerPool::setPolicy(BackpressurePolicy new_policy) {
+    std::lock_guard<std::mutex> lock(mutex);
+    policy = new_policy;
+}
+
+size_t TranscriptionWorkerPool::queuedJobs() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return queue.size();
+}
+
+TranscriptionWorkerPool::Stats TranscriptionWorkerPool::getStats() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return stats;
+}
+
+std::future<TranscriptionWorkerPool::Result> TranscriptionWorkerPool::submit(AudioBuffer&& audio) {
+    std::shared_ptr<std::promise<Result>> promise = std::make_shared<std::promise<Result>>();
+    std::future<Result> future = promise->get_future();
+    if (!submit(std::move(audio), [promise](const Result& result) { promise->set_value(result); })) {
+        Result result;
+        result.dropped = true;
+        promise->set_value(result);
+    }
+    return future;
+}
+
+bool TranscriptionWorkerPool::submit(AudioBuffer&& audio, Callback callback) {
+    if (!audio.valid() || audio.empty()) {
+        return false;
+    }
+
+    Job job;
+    job.audio = std::move(audio);
+    job.stream = nullptr;
+    job.end_of_segment = false;
+    job.merged_jobs = 1;
+    job.callbacks.push_back(std::move(callback));
+    job.submitted = std::chrono::steady_clock::now();
+
+    return enqueue(std::move(job));
+}
+
+bool TranscriptionWorkerPool::submitStream(StreamingTranscriber& stream, AudioBuffer&& audio,
+                                           bool end_of_segment, Callback callback) {
+    if ((!audio.valid() || audio.empty()) && !end_of_segment) {
+        return false;
+    }
+
+    Job job;
+    job.audio = std::move(audio);
+    job.stream = &stream;
+    job.end_of_segment = end_of_segment;
+    job.merged_jobs = 1;
+    job.callbacks.push_back(std::move(callback));
+    job.submitted = std::chrono::steady_clock::now();
+
+    return enqueue(std::move(job));
+}
+
+bool TranscriptionWorkerPool::coalesce(Job& into, Job& job) {
+    // Audio after a gap must reach the stream as its own job so the
+    // transcriber sees where the gap is
+    if (into.stream != job.stream || into.end_of_segment || job.audio.discontinuity) {
+        return false;
+    }
+
+    size_t needed = into.audio.size() + job.audio.size();
+    if (job.audio.valid() && !job.audio.empty()) {
+        if (!into.audio.valid()) {
+            into.audio = std::move(job.audio);
+        } else {
+            if (needed > into.audio.capacity() || into.audio.isShared()) {
+                AudioBuffer larger = pool.acquire(needed);
+                if (!larger.valid()) {
+                    return false;
+                }
+                larger.resize(0);
+                larger.copyFormatFrom(into.audio);
+                larger.append(into.audio.data(), into.audio.size());
+                into.audio = std::move(larger);
+            }
+            into.audio.append(job.audio.data(), job.audio.size());
+        }
+    }
+
+    into.end_of_segment = job.end_of_segment;
+    into.merged_jobs += job.merged_jobs;
+    for (Callback& callback : job.callbacks) {
+        into.callbacks.push_back(std::move(callback));
+    }
+    return true;
+}
+
+void TranscriptionWorkerPool::markGap(Job& job) {
+    // A flush with no audio already ends the utterance before the gap
+    if (job.audio.valid()) {
+        job.audio.discontinuity = true;
+    }
+}
+
+bool TranscriptionWorkerPool::enqueue(Job&& job) {
+    // Dropped jobs complete outside the lock, their callbacks may take time
+    std::vector<Job> dropped;
+    std::unique_lock<std::mutex> lock(mutex);
+    if (stopping) {
+        return false;
+    }
+    stats.submitted++;
+
+    // One of this stream's jobs was dropped since its last submission
+    std::vector<StreamingTranscriber*>::iterator gap =
+        std::find(gapped_streams.begin(), gapped_streams.end(), job.stream);
+    if (job.stream != nullptr && gap != gapped_streams.end()) {
+        markGap(job);
+        gapped_streams.erase(gap);
+    }
+
+    if (queue.size() >= queue_depth) {
+        switch (policy) {
+            case BLOCK:
+                stats.blocked++;
+                space_available.wait(lock, [this] { return stopping || queue.size() < queue_depth; });
+                if (stopping) {
+                    return false;
+                }
+                break;
+            case COALESCE:
+                if (coalesce(queue.back(), job)) {
+                    stats.coalesced++;
+                    return true;
+                }
+                // Nothing compatible to merge with; make room instead
+                [[fallthrough]];
+            case DROP_OLDEST: {
+                // The stream's next job starts after a hole; a dropped flush
+                // is not carried over, the gap ends that utterance instead
+                Job& oldest = queue.front();
+                if (oldest.stream != nullptr) {
+                    bool marked = false;
+                    for (size_t i = 1; i < queue.size() && !marked; i++) {
+                        if (queue[i].stream == oldest.stream) {
+                            markGap(queue[i]);
+                            marked = true;
+                        }
+                    }
+                    if (!marked && job.stream == oldest.stream) {
+                        markGap(job);
+                    } else if (!marked && std::find(gapped_streams.begin(), gapped_streams.end(),
+                                                    oldest.stream) == gapped_streams.end()) {
+                        gapped_streams.push_back(oldest.stream);
+                    }
+                }
+                dropped.push_back(std::move(oldest));
+                queue.pop_front();
+                stats.dropped++;
+                break;
+            }
+        }
+    }
+
+    queue.push_back(std::move(job));
+    lock.unlock();
+    job_ready.notify_one();
+
+    for (Job& old : dropped) {
+        Result result;
+        result.dropped = true;
+        result.merged_jobs = old.merged_jobs;
+        if (old.audio.valid()) {
+            result.startFrame = old.audio.startFrame;
+            result.timestampUs = old.audio.timestampUs;
+            result.samples = old.audio.size();
+        }
+        finish(old, result);
+    }
+    return true;
+}
+
+std::deque<TranscriptionWorkerPool::Job>::iterator TranscriptionWorkerPool::nextRunnable() {
+    // A stream job waits while its stream is running or has an earlier job
+    // queued; streams seen here are treated as blocked for later jobs
+    std::vector<StreamingTranscriber*> blocked(busy_streams);
+    for (std::deque<Job>::iterator it = queue.begin(); it != queue.end(); ++it) {
+        if (it->stream == nullptr) {
+            return it;
+        }
+        if (std::find(blocked.begin(), blocked.end(), it->stream) == blocked.end()) {
+            return it;
+        }
+        blocked.push_back(it->stream);
+    }
+    return queue.end();
+}
+
+void TranscriptionWorkerPool::workerLoop(size_t index) {
+    // Stream jobs decode on their transcriber's session, so a worker only
+    // pays for Whisper state once it is handed a one-shot job
+    std::unique_ptr<SpeechToText::Session> session;
+    Tracer::setThreadName("transcribe-" + std::to_string(index));
+
+    while (true) {
+        Job job;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            std::deque<Job>::iterator it;
+            job_ready.wait(lock, [this, &it] {
+                if (stopping) {
+                    return true;
+                }
+                it = nextRunnable();
+                return it != queue.end();
+            });
+            if (stopping) {
+                break;
+            }
+
+            job = std::move(*it);
+            queue.erase(it);
+            if (job.stream != nullptr) {
+                busy_streams.push_back(job.stream);
+            }
+            running++;
+        }
+        space_available.notify_one();
+
+        Result result;
+        result.merged_jobs = job.merged_jobs;
+        result.queue_ms = millisecondsBetween(job.submitted, std::chrono::steady_clock::now());
+        if (job.stream == nullptr && !session) {
+            session = stt.createSession();
+        }
+        runJob(job, session.get(), result);
+        finish(job, result);
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (job.stream != nullptr) {
+                busy_streams.erase(std::find(busy_streams.begin(), busy_streams.end(), job.stream));
+            }
+            running--;
+            stats.completed++;
+        }
+        // A finished stream job may unblock the next one for that stream
+        job_ready.notify_all();
+        idle.notify_all();
+    }
+}
+
+void TranscriptionWorkerPool::runJob(Job& job, SpeechToText::Session* session, Result& result) {
+    if (job.audio.valid()) {
+        result.startFrame = job.audio.startFrame;
+        result.timestampUs = job.audio.timestampUs;
+        result.samples = job.audio.size();
+    }
+
+    TRACE_SCOPE("transcribe.job");
+    int n_threads = threads_per_job;
+    auto start = std::chrono::steady_clock::now();
+
+    if (job.stream == nullptr) {
+        if (session == nullptr) {
+            result.text = "Failed to create transcription session";
+        } else {
+            session->setThreads(n_threads);
+            result.text = session->transcribe(job.audio);
+        }
+    } else {
+        job.stream->setThreads(n_threads);
+
+        StreamingTranscriber::Update update;
+        if (job.audio.valid() && job.audio.discontinuity) {
+            // Finish the words heard before the gap on their own, so they
+            // never reach the caller mixed with the audio after it
+            result.segment_cut = true;
+            if (job.stream->flush(update)) {
+                result.cut_text = update.committed;
+            }
+        }
+        if (job.audio.valid() && job.stream->push(job.audio, update)) {
+            result.text = update.committed;
+            result.partial = update.partial;
+            result.final = update.final;
+        }
+        if (job.end_of_segment) {
+            if (job.stream->flush(update)) {
+                if (!update.committed.empty()) {
+                    result.text += result.text.empty() ? "" : " ";
+                    result.text += update.committed;
+                }
+                result.partial.clear();
+                result.final = true;
+            }
+            result.segment_end = true;
+        }
+    }
+
+    result.inference_ms = millisecondsBetween(start, std::chrono::steady_clock::now());
+}
+
+void TranscriptionWorkerPool::finish(Job& job, const Result& result) {
+    TRACE_SCOPE("transcribe.publish");
+    for (Callback& callback : job.callbacks) {
+        if (callback) {
+            callback(result);
+        }
+    }
+    // Return the audio block to the pool before the job object is reused
+    job.audio.reset();
+}
+
+void TranscriptionWorkerPool::waitIdle() {
+    std::unique_lock<std::mutex> lock(mutex);
+    idle.wait(lock, [this] { return stopping || (queue.empty() && running == 0); });
+}
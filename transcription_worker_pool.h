@@ -0,0 +1,133 @@
+#ifndef TRANSCRIPTION_WORKER_POOL_H
+#define TRANSCRIPTION_WORKER_POOL_H
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <memory>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include "audio_buffer.h"
+#include "speech_to_text.h"
+#include "streaming_transcriber.h"
+
+// Runs transcription off the capture thread. Jobs go into a bounded queue
+// serviced by a fixed set of worker threads. Stream jobs decode on their
+// transcriber's session; a worker creates a Whisper session of its own the
+// first time it runs a one-shot job. When inference falls behind real time
+// the queue fills up and the backpressure policy decides what gives: the
+// oldest job, the job boundaries, or the submitter.
+class TranscriptionWorkerPool {
+public:
+    enum BackpressurePolicy {
+        DROP_OLDEST,   // Discard the oldest queued job to make room
+        COALESCE,      // Merge into the newest queued job, one decode for both
+        BLOCK          // Wait in submit until a worker frees a slot
+    };
+
+    struct Result {
+        std::string text;          // One-shot text, or newly committed stream text
+        std::string partial;       // Stream jobs only: tentative text
+        bool final = false;        // Stream jobs only: a window closed
+        bool segment_end = false;  // Stream jobs only: the stream was flushed
+        // Stream jobs only: the audio follows lost frames, so the segment
+        // before it was cut there. `cut_text` holds its last committed
+        // words; `text` belongs to what follows the gap.
+        bool segment_cut = false;
+        std::string cut_text;
+        bool dropped = false;      // Discarded under backpressure, nothing decoded
+        int merged_jobs = 1;       // Submissions served by this result
+        uint64_t startFrame = 0;   // Position of the job's first sample
+        int64_t timestampUs = 0;
+        size_t samples = 0;
+        double queue_ms = 0.0;     // Time spent waiting for a worker
+        double inference_ms = 0.0;
+    };
+
+    typedef std::function<void(const Result&)> Callback;
+
+    struct Stats {
+        uint64_t submitted = 0;
+        uint64_t completed = 0;
+        uint64_t dropped = 0;
+        uint64_t coalesced = 0;
+        uint64_t blocked = 0;      // Submissions that had to wait
+    };
+
+    // Coalesced audio that no longer fits a job's buffer is copied into
+    // blocks from `pool`. `stt` and `pool` must outlive this object.
+    TranscriptionWorkerPool(SpeechToText& stt, AudioBlockPool& pool, int workers = 1,
+                            size_t queue_depth = 4,
+                            BackpressurePolicy policy = DROP_OLDEST);
+    ~TranscriptionWorkerPool();
+
+    // One-shot transcription of a complete utterance
+    std::future<Result> submit(AudioBuffer&& audio);
+    bool submit(AudioBuffer&& audio, Callback callback);
+
+    // Feeds speech to a streaming transcriber on a worker. Jobs for the same
+    // transcriber run in submission order, never concurrently. With
+    // `end_of_segment` the transcriber is flushed after the audio, which may
+    // be empty. When one of a stream's jobs is dropped, its next job is
+    // treated as following a gap (see Result::segment_cut).
+    bool submitStream(StreamingTranscriber& stream, AudioBuffer&& audio, bool end_of_segment,
+                      Callback callback);
+
+    // Blocks until the queue is empty and no job is running
+    void waitIdle();
+
+    // Inference threads used by each job; 0 uses the engine default. By
+    // default the cores are split evenly between the workers.
+    void setThreadsPerJob(int n_threads);
+    void setPolicy(BackpressurePolicy policy);
+
+    size_t queuedJobs() const;
+    Stats getStats() const;
+
+private:
+    struct Job {
+        AudioBuffer audio;
+        StreamingTranscriber* stream;   // nullptr for one-shot jobs
+        bool end_of_segment;
+        int merged_jobs;
+        std::vector<Callback> callbacks;
+        std::chrono::steady_clock::time_point submitted;
+    };
+
+    SpeechToText& stt;
+    AudioBlockPool& pool;
+    size_t queue_depth;
+    BackpressurePolicy policy;
+    std::atomic<int> threads_per_job;
+
+    std::vector<std::thread> workers;
+
+    mutable std::mutex mutex;
+    std::condition_variable job_ready;
+    std::condition_variable space_available;
+    std::condition_variable idle;
+    std::deque<Job> queue;
+    std::vector<StreamingTranscriber*> busy_streams;
+    // Streams that lost a job with none of theirs queued behind it; their
+    // next submission is marked as following a gap
+    std::vector<StreamingTranscriber*> gapped_streams;
+    size_t running;
+    bool stopping;
+    Stats stats;
+
+    bool enqueue(Job&& job);
+    static void markGap(Job& job);
+    bool coalesce(Job& into, Job& job);
+    std::deque<Job>::iterator nextRunnable();
+    void workerLoop(size_t index);
+    void runJob(Job& job, SpeechToText::Session* session, Result& result);
+    static void finish(Job& job, const Result& result);
+};
+
+#endif // TRANSCRIPTION_WORKER_POOL_H
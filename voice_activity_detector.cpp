@@ -0,0 +1,233 @@
+#include "voice_activity_detector.h"
+#include <iostream>
+#include <stdexcept>
+#include <algorithm>
+#include <cmath>
+
+// Below this the input is digital silence and never counts as speech
+static const float kSilenceFloorDb = -75.0f;
+
+VoiceActivityDetector::VoiceActivityDetector(AudioBlockPool& pool, const FeatureExtractor& features,
+                                             int pre_roll_ms, int hangover_ms, int max_chunk_ms)
+    : pool(pool), features(features), sample_rate(features.getSampleRate()),
+      frame_length(features.getFrameLength()), hop_length(features.getHopLength()),
+      pre_roll_samples(sample_rate * pre_roll_ms / 1000),
+      hangover_frames(0), max_chunk(static_cast<size_t>(sample_rate) * max_chunk_ms / 1000),
+      energy_threshold_db(9.0f), flatness_threshold(0.35f), onset_frames(3),
+      band_low(0), band_high(0),
+      history_mask(0), history_pos(0), emitted_pos(0),
+      noise_floor_db(0.0f), floor_initialized(false), speech_run(0), hangover_left(0),
+      active(false) {
+    if (pre_roll_ms < 0 || hangover_ms < 0 || max_chunk_ms <= 0) {
+        throw std::invalid_argument("Invalid voice activity detector configuration");
+    }
+
+    // Frames arrive once per hop
+    int hop_ms_x1000 = hop_length * 1000000 / sample_rate;
+    hangover_frames = std::max(1, (hangover_ms * 1000 + hop_ms_x1000 - 1) / hop_ms_x1000);
+
+    // Flatness is measured over the band where speech has its harmonics
+    int fft_size = features.getFftSize();
+    band_low = std::max(1, 300 * fft_size / sample_rate);
+    band_high = std::min(features.getBins() - 1, 4000 * fft_size / sample_rate);
+
+    // Room for the pre-roll, the onset frames and a whole chunk, so gaps
+    // bridged within one call are still available
+    size_t needed = pre_roll_samples + frame_length + onset_frames * hop_length + max_chunk;
+    size_t capacity = 1;
+    while (capacity < needed) {
+        capacity <<= 1;
+    }
+    history.assign(capacity, 0);
+    history_mask = capacity - 1;
+}
+
+void VoiceActivityDetector::setEnergyThreshold(float db_above_floor) {
+    energy_threshold_db = db_above_floor;
+}
+
+void VoiceActivityDetector::setFlatnessThreshold(float flatness) {
+    flatness_threshold = flatness;
+}
+
+void VoiceActivityDetector::reset() {
+    history_pos = 0;
+    emitted_pos = 0;
+    floor_initialized = false;
+    speech_run = 0;
+    hangover_left = 0;
+    active = false;
+}
+
+bool VoiceActivityDetector::classifyFrame(const FeatureExtractor::Frame& frame) {
+    float energy_db = 10.0f * std::log10(frame.energy + 1e-12f);
+
+    float log_sum = 0.0f;
+    float linear_sum = 0.0f;
+    for (int k = band_low; k <= band_high; k++) {
+        float power = frame.power[k] + 1e-12f;
+        log_sum += std::log(power);
+        linear_sum += power;
+    }
+    int band_bins = band_high - band_low + 1;
+    float flatness = std::exp(log_sum / band_bins) / (linear_sum / band_bins);
+
+    if (!floor_initialized) {
+        noise_floor_db = energy_db;
+        floor_initialized = true;
+    }
+
+    bool loud = energy_db > noise_floor_db + energy_threshold_db && energy_db > kSilenceFloorDb;
+    bool peaky = flatness < flatness_threshold;
+    bool speech = loud && (peaky || energy_db > noise_floor_db + 2.0f * energy_threshold_db);
+
+    // The floor drops quickly, rises quickly through flat (noise-like)
+    // frames and only creeps up under peaky ones, so steady tonal noise is
+    // eventually absorbed too
+    if (energy_db < noise_floor_db) {
+        noise_floor_db += 0.2f * (energy_db - noise_floor_db);
+    } else {
+        float rate = peaky ? 0.002f : 0.05f;
+        noise_floor_db += rate * (energy_db - noise_floor_db);
+    }
+
+    return speech;
+}
+
+void VoiceActivityDetector::emitRange(AudioBuffer& out, uint64_t from, uint64_t to) {
+    for (uint64_t pos = from; pos < to; ) {
+        size_t offset = static_cast<size_t>(pos & history_mask);
+        size_t count = std::min<uint64_t>(to - pos, history.size() - offset);
+        out.append(&history[offset], count);
+        pos += count;
+    }
+    stats.forwarded_samples += to - from;
+    emitted_pos = to;
+}
+
+VoiceActivityDetector::Result VoiceActivityDetector::process(AudioBuffer&& chunk) {
+    Result result;
+    if (!chunk.valid() || chunk.empty()) {
+        return result;
+    }
+    if (chunk.channels != 1 || chunk.sampleRate != static_cast<size_t>(sample_rate)) {
+        std::cerr << "Voice activity detector expects " << sample_rate << " Hz mono audio" << std::endl;
+        return result;
+    }
+    if (chunk.size() > max_chunk) {
+        std::cerr << "Voice activity detector chunk of " << chunk.size()
+                  << " samples exceeds the configured maximum of " << max_chunk << std::endl;
+        return result;
+    }
+
+    const std::vector<FeatureExtractor::Frame>& frames = features.frames();
+    if (!frames.empty() && frames.back().chunkEnd > chunk.size()) {
+        std::cerr << "Voice activity detector was given features of a different chunk" << std::endl;
+        return result;
+    }
+
+    // Nothing is stitched across lost audio: an open segment ends at the
+    // gap and pre-roll can't reach back past it
+    bool cut_by_gap = false;
+    if (chunk.discontinuity) {
+        cut_by_gap = active;
+        active = false;
+        speech_run = 0;
+        hangover_left = 0;
+        emitted_pos = history_pos;
+    }
+
+    const uint64_t chunk_start = history_pos;
+    bool ended = false;
+    uint64_t output_start = 0;
+    size_t next_frame = 0;
+
+    const int16_t* samples = chunk.data();
+    for (size_t i = 0; i < chunk.size(); i++) {
+        history[history_pos & history_mask] = samples[i];
+        history_pos++;
+        if (next_frame == frames.size() || frames[next_frame].chunkEnd != i + 1) {
+            continue;
+        }
+
+        bool speech = classifyFrame(frames[next_frame++]);
+        speech_run = speech ? speech_run + 1 : 0;
+
+        if (!active) {
+            if (speech_run < onset_frames) {
+                continue;
+            }
+            active = true;
+            hangover_left = hangover_frames;
+
+            if (!result.speech.valid()) {
+                result.speech = pool.acquire(pre_roll_samples + frame_length +
+                                             onset_frames * hop_length + chunk.size());
+                if (!result.speech.valid()) {
+                    std::cerr << "No free audio buffer for voice activity output" << std::endl;
+                    active = false;
+                    continue;
+                }
+                result.speech.resize(0);
+            }
+
+            if (ended) {
+                // Speech resumed within this chunk: bridge the short gap so
+                // the output stays contiguous and the segment carries on
+                emitRange(result.speech, emitted_pos, history_pos);
+                ended = false;
+            } else {
+                uint64_t oldest = history_pos > history.size() ? history_pos - history.size() : 0;
+                // Start of the first of the onset frames
+                uint64_t onset = history_pos - std::min<uint64_t>(
+                    history_pos, frame_length + static_cast<uint64_t>(onset_frames - 1) * hop_length);
+                uint64_t from = onset > static_cast<uint64_t>(pre_roll_samples)
+                    ? onset - pre_roll_samples : 0;
+                from = std::max(from, std::max(oldest, emitted_pos));
+                if (result.speech.empty()) {
+                    output_start = from;
+                }
+                result.segment_start = true;
+                stats.segments++;
+                emitRange(result.speech, from, history_pos);
+            }
+        } else if (!speech && --hangover_left <= 0) {
+            active = false;
+            ended = true;
+        } else {
+            if (speech) {
+                hangover_left = hangover_frames;
+            }
+            if (!result.speech.valid()) {
+                result.speech = pool.acquire(chunk.size() + frame_length);
+                if (!result.speech.valid()) {
+                    std::cerr << "No free audio buffer for voice activity output" << std::endl;
+                    continue;
+                }
+                result.speech.resize(0);
+                output_start = emitted_pos;
+            }
+            emitRange(result.speech, emitted_pos, history_pos);
+        }
+    }
+
+    // If speech picked up again after the gap, the new segment's audio is
+    // marked as a discontinuity, which ends the old one downstream
+    result.segment_end = ended || (cut_by_gap && !result.speech.valid());
+
+    if (result.speech.valid()) {
+        result.speech.discontinuity = chunk.discontinuity;
+        // Map VAD-local positions back onto the chunk's stream position
+        int64_t offset_frames = static_cast<int64_t>(output_start) - static_cast<int64_t>(chunk_start);
+        result.speech.sampleRate = sample_rate;
+        result.speech.channels = 1;
+        result.speech.startFrame = static_cast<uint64_t>(
+            std::max<int64_t>(0, static_cast<int64_t>(chunk.startFrame) + offset_frames));
+        result.speech.timestampUs = chunk.timestampUs + offset_frames * 1000000 / sample_rate;
+    }
+
+    stats.processed_samples += chunk.size();
+    stats.skipped_samples = stats.processed_samples - std::min(stats.processed_samples,
+                                                               stats.forwarded_samples);
+    return result;
+}
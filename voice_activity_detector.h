@@ -0,0 +1,84 @@
+#ifndef VOICE_ACTIVITY_DETECTOR_H
+#define VOICE_ACTIVITY_DETECTOR_H
+
+#include <vector>
+#include <cstdint>
+#include "audio_buffer.h"
+#include "feature_extractor.h"
+
+// Low-cost speech gate for the capture stream. Each 10 ms analysis frame of
+// the shared FeatureExtractor is classed by its energy above a tracked noise
+// floor and its spectral flatness (speech is peaky, steady noise is flat),
+// so the gate costs no FFTs of its own. Only speech is forwarded, with
+// configurable pre-roll before the onset and hang-over after the last speech
+// frame, so word edges are not clipped. A chunk marked as a discontinuity
+// ends any open segment.
+class VoiceActivityDetector {
+public:
+    struct Result {
+        AudioBuffer speech;           // Contiguous speech audio from this chunk, may be empty
+        bool segment_start = false;   // `speech` opens a new segment (includes pre-roll)
+        bool segment_end = false;     // The current segment ended in this chunk
+    };
+
+    // Counters for measuring the duty cycle over a recording
+    struct Stats {
+        uint64_t processed_samples = 0;
+        uint64_t forwarded_samples = 0;
+        uint64_t skipped_samples = 0;
+        uint64_t segments = 0;
+    };
+
+    // Output buffers are drawn from `pool`; both it and `features` must
+    // outlive this object. Chunks passed to process() may be up to
+    // `max_chunk_ms` long.
+    VoiceActivityDetector(AudioBlockPool& pool, const FeatureExtractor& features,
+                          int pre_roll_ms = 300, int hangover_ms = 400,
+                          int max_chunk_ms = 1000);
+
+    // `features` must have just processed this same chunk
+    Result process(AudioBuffer&& chunk);
+    void reset();
+
+    void setEnergyThreshold(float db_above_floor);
+    void setFlatnessThreshold(float flatness);
+
+    bool inSpeech() const { return active; }
+    const Stats& getStats() const { return stats; }
+
+private:
+    AudioBlockPool& pool;
+    const FeatureExtractor& features;
+    int sample_rate;
+    int frame_length;
+    int hop_length;
+    int pre_roll_samples;
+    int hangover_frames;
+    size_t max_chunk;
+
+    float energy_threshold_db;
+    float flatness_threshold;
+    int onset_frames;             // Consecutive speech frames needed to open a segment
+
+    int band_low;                 // Bins considered for flatness
+    int band_high;
+
+    // Recent input, so pre-roll and short gaps can be emitted after the fact
+    std::vector<int16_t> history;
+    size_t history_mask;
+    uint64_t history_pos;         // Stream position of the next sample written
+    uint64_t emitted_pos;         // Stream position just past the last forwarded sample
+
+    float noise_floor_db;
+    bool floor_initialized;
+    int speech_run;
+    int hangover_left;
+    bool active;
+
+    Stats stats;
+
+    bool classifyFrame(const FeatureExtractor::Frame& frame);
+    void emitRange(AudioBuffer& out, uint64_t from, uint64_t to);
+};
+
+#endif // VOICE_ACTIVITY_DETECTOR_H